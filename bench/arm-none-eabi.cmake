@@ -0,0 +1,12 @@
+# Toolchain for the kernel benchmark: bare-metal Cortex-M0+ code from the
+# Arm GNU toolchain, the same compiler the pico-sdk uses for the firmware.
+
+set(CMAKE_SYSTEM_NAME Generic)
+set(CMAKE_SYSTEM_PROCESSOR cortex-m0plus)
+
+set(CMAKE_C_COMPILER arm-none-eabi-gcc)
+set(CMAKE_ASM_COMPILER arm-none-eabi-gcc)
+set(CMAKE_TRY_COMPILE_TARGET_TYPE STATIC_LIBRARY)
+
+set(CMAKE_C_FLAGS_INIT "-mcpu=cortex-m0plus -mthumb -ffunction-sections -fdata-sections")
+set(CMAKE_EXE_LINKER_FLAGS_INIT "-mcpu=cortex-m0plus -mthumb --specs=nano.specs --specs=nosys.specs -nostartfiles -Wl,--gc-sections")
@@ -0,0 +1,21 @@
+#ifndef BENCH_PORT_H
+#define BENCH_PORT_H
+
+#include <stdint.h>
+
+/* What the kernel benchmark needs from the machine it runs on: a console
+ * and an instruction counter. port_mps2.c implements it for the emulated
+ * MPS2 board, port_host.c with host time for a native smoke build.
+ */
+
+void bench_port_init(void);
+void bench_port_write(const char* s);
+
+/* Instructions retired since start, which must come from
+ * bench_port_count(). A span must stay well under the counter's wrap,
+ * hundreds of millions of instructions on the MPS2.
+ */
+uint32_t bench_port_count(void);
+uint32_t bench_port_elapsed(uint32_t start);
+
+#endif /* BENCH_PORT_H */
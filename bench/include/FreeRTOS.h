@@ -0,0 +1,7 @@
+/* Stand-in for FreeRTOS.h in the kernel benchmark. app_config.h only uses
+ * it in macros the benchmarked sources never expand.
+ */
+#ifndef BENCH_FREERTOS_H
+#define BENCH_FREERTOS_H
+
+#endif /* BENCH_FREERTOS_H */
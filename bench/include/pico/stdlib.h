@@ -0,0 +1,9 @@
+/* Stand-in for the pico-sdk's pico/stdlib.h in the kernel benchmark.
+ * app_config.h includes it but the benchmarked sources use nothing from it.
+ */
+#ifndef BENCH_PICO_STDLIB_H
+#define BENCH_PICO_STDLIB_H
+
+#include "pico.h"
+
+#endif /* BENCH_PICO_STDLIB_H */
@@ -0,0 +1,14 @@
+/* Stand-in for the pico-sdk's pico/time.h in the kernel benchmark. The
+ * engine's render timing statistics read zero; the harness counts
+ * instructions itself.
+ */
+#ifndef BENCH_PICO_TIME_H
+#define BENCH_PICO_TIME_H
+
+#include "pico.h"
+
+static inline uint32_t time_us_32(void) {
+    return 0;
+}
+
+#endif /* BENCH_PICO_TIME_H */
@@ -0,0 +1,5 @@
+/* Stand-in for FreeRTOS' task.h in the kernel benchmark, see FreeRTOS.h */
+#ifndef BENCH_TASK_H
+#define BENCH_TASK_H
+
+#endif /* BENCH_TASK_H */
@@ -0,0 +1,244 @@
+/* Instruction-count benchmark of the DSP and MIDI kernels.
+ *
+ * Built for the Cortex-M0+ and run under qemu-system-arm, see
+ * bench/CMakeLists.txt. Every case runs a fixed, deterministic workload
+ * and prints one line
+ *
+ *   BENCH <case> <unit> <instructions per unit, two decimals>
+ *
+ * which run_bench.py compares against baseline.json. The engine cases
+ * render whole AUDIO_BUFFER_FRAMES blocks through synth_engine_process,
+ * so their figure includes the part mix and stereo interleave; engine_idle
+ * is that overhead alone.
+ *
+ * The counts are of the portable C paths (PICO_ON_DEVICE is 0): the sine
+ * kernel without the interpolator, the sample stream refilled by memcpy
+ * instead of DMA, and division through libgcc rather than the SIO divider.
+ * They track changes to the code, not the device's cycle count.
+ */
+
+#include <string.h>
+#include "bench_port.h"
+#include "app_config.h"
+#include "synth_engine.h"
+#include "synth_presets.h"
+#include "sample_stream.h"
+#include "synth_unison.h"
+#include "midi_parser.h"
+#include "midi_merge.h"
+#include "usb_midi_parser.h"
+
+#define BENCH_RATE              48000
+#define BENCH_WARMUP_BLOCKS     4
+#define BENCH_BLOCKS            32
+#define BENCH_MIDI_REPEATS      16
+
+static int32_t output_buffer[SYNTH_OUTPUT_BUSES][AUDIO_BUFFER_FRAMES * 2];
+static int32_t* const outputs[SYNTH_OUTPUT_BUSES] = {
+    output_buffer[0],
+#if AUDIO_I2S_BUS2
+    output_buffer[1],
+#endif
+};
+
+/* Prints the instruction count per unit with two decimals. printf would
+ * pull in far more of the C library than the rest of the harness.
+ */
+static void report(const char* name, const char* unit, uint64_t insns, uint32_t units) {
+    char line[96];
+    char digits[24];
+    uint64_t hundredths = units ? (insns * 100u + units / 2) / units : 0;
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + hundredths % 10);
+        hundredths /= 10;
+    } while (hundredths != 0 || n < 3);
+
+    char* p = line;
+    const char* parts[] = { "BENCH ", name, " ", unit, " " };
+    for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]); i++) {
+        size_t len = strlen(parts[i]);
+        memcpy(p, parts[i], len);
+        p += len;
+    }
+    while (n > 2) *p++ = digits[--n];
+    *p++ = '.';
+    while (n > 0) *p++ = digits[--n];
+    *p++ = '\n';
+    *p = '\0';
+    bench_port_write(line);
+}
+
+static int find_preset(const char* name) {
+    for (uint8_t i = 0; i < synth_preset_count; i++) {
+        if (strcmp(synth_presets[i].name, name) == 0) return i;
+    }
+    return -1;
+}
+
+/* Plays a chord of voices on one preset and counts the instructions of
+ * BENCH_BLOCKS process calls once the attacks have settled. Returns false
+ * when the preset is missing.
+ */
+static bool bench_engine(const char* name, const char* preset, uint8_t voices) {
+    synth_engine_init();
+    sample_stream_init();
+    synth_engine_set_sample_rate(BENCH_RATE);
+
+    if (preset != NULL) {
+        int program = find_preset(preset);
+        if (program < 0) return false;
+        synth_engine_program_change(0, (uint8_t)program);
+    }
+    for (uint8_t v = 0; v < voices; v++) {
+        // Spread over four octaves so pitch-dependent paths are all taken
+        synth_engine_note_on(0, (uint8_t)(36 + v * 3), 100);
+    }
+
+    for (int b = 0; b < BENCH_WARMUP_BLOCKS; b++) {
+        synth_engine_process(outputs, AUDIO_BUFFER_FRAMES);
+    }
+
+    uint64_t insns = 0;
+    for (int b = 0; b < BENCH_BLOCKS; b++) {
+        uint32_t start = bench_port_count();
+        synth_engine_process(outputs, AUDIO_BUFFER_FRAMES);
+        insns += bench_port_elapsed(start);
+    }
+    report(name, "frame", insns, BENCH_BLOCKS * AUDIO_BUFFER_FRAMES);
+    return true;
+}
+
+/* The unison kernel alone for every oscillator count, per frame of one
+ * note, the figures to multiply by polyphony.
+ */
+static void bench_unison(void) {
+    static int32_t mid[AUDIO_BUFFER_FRAMES];
+    static int32_t side[AUDIO_BUFFER_FRAMES];
+    synth_unison_voice_t unison;
+
+    for (uint8_t count = 1; count <= SYNTH_UNISON_MAX; count++) {
+        synth_unison_patch_t patch = { count, 3300, 26000 };
+        synth_unison_note_on(&unison, &patch, false);
+
+        uint64_t insns = 0;
+        for (int b = 0; b < BENCH_BLOCKS; b++) {
+            uint32_t start = bench_port_count();
+            synth_unison_accumulate(mid, side, AUDIO_BUFFER_FRAMES, &unison, 1u << 24, 32767, 0);
+            insns += bench_port_elapsed(start);
+        }
+        char name[] = "unison_0";
+        name[7] = (char)('0' + count);
+        report(name, "frame", insns, BENCH_BLOCKS * AUDIO_BUFFER_FRAMES);
+    }
+}
+
+/* A DIN stream as a keyboard player with a clock source sends it: notes
+ * under running status, controller sweeps and clock bytes landing inside
+ * other messages.
+ */
+static size_t build_midi_stream(uint8_t* stream, size_t max) {
+    size_t n = 0;
+    for (uint8_t i = 0; n + 12 <= max; i++) {
+        uint8_t note = (uint8_t)(48 + (i % 24));
+        stream[n++] = 0x90;
+        stream[n++] = note;
+        if (i % 4 == 0) stream[n++] = 0xF8;
+        stream[n++] = 100;
+        stream[n++] = note;         // Running status note off
+        stream[n++] = 0;
+        stream[n++] = 0xB0;
+        stream[n++] = 1;
+        stream[n++] = (uint8_t)(i & 0x7F);
+        stream[n++] = (uint8_t)((i + 1) & 0x7F);    // Running status
+        if (i % 8 == 0) stream[n++] = 0xF8;
+        stream[n++] = 0xE0;
+        stream[n++] = (uint8_t)(i & 0x7F);
+    }
+    return n;
+}
+
+static void bench_midi(void) {
+    static uint8_t stream[1024];
+    static midi_message_t messages[512];
+    static const midi_parser_callbacks_t callbacks = { 0 };
+    size_t bytes = build_midi_stream(stream, sizeof(stream));
+    size_t count = 0;
+    midi_message_t msg;
+
+    midi_parser_init(&callbacks);
+    uint64_t insns = 0;
+    for (int r = 0; r < BENCH_MIDI_REPEATS; r++) {
+        count = 0;
+        uint32_t start = bench_port_count();
+        for (size_t i = 0; i < bytes; i++) {
+            if (midi_parser_process_byte(stream[i], i, &msg) && count < 512) {
+                messages[count++] = msg;
+            }
+        }
+        insns += bench_port_elapsed(start);
+    }
+    report("midi_parser", "byte", insns, BENCH_MIDI_REPEATS * (uint32_t)bytes);
+
+    // The same messages as USB-MIDI event packets
+    static uint8_t packets[512][4];
+    for (size_t i = 0; i < count; i++) {
+        uint8_t status = messages[i].status;
+        packets[i][0] = (status >= 0xF0) ? 0x0F : (uint8_t)(status >> 4);
+        packets[i][1] = status;
+        packets[i][2] = messages[i].data1;
+        packets[i][3] = messages[i].data2;
+    }
+    insns = 0;
+    for (int r = 0; r < BENCH_MIDI_REPEATS; r++) {
+        uint32_t start = bench_port_count();
+        for (size_t i = 0; i < count; i++) {
+            usb_midi_parse_packet(packets[i], i, &msg);
+        }
+        insns += bench_port_elapsed(start);
+    }
+    report("usb_midi_parser", "byte", insns, BENCH_MIDI_REPEATS * (uint32_t)count * 4);
+
+    // Through the merge queue from both sources, pushed in bursts and drained
+    for (size_t i = 0; i < count; i++) {
+        messages[i].source = (uint8_t)(i & 1);
+    }
+    midi_merge_init();
+    insns = 0;
+    for (int r = 0; r < BENCH_MIDI_REPEATS; r++) {
+        uint32_t start = bench_port_count();
+        for (size_t i = 0; i < count; i++) {
+            midi_merge_push(&messages[i]);
+            if ((i & 7) == 7) {
+                while (midi_merge_pop(&msg)) {
+                }
+            }
+        }
+        while (midi_merge_pop(&msg)) {
+        }
+        insns += bench_port_elapsed(start);
+    }
+    report("midi_merge", "message", insns, BENCH_MIDI_REPEATS * (uint32_t)count);
+}
+
+int main(void) {
+    bench_port_init();
+
+    bool ok = true;
+    ok &= bench_engine("engine_idle", NULL, 0);
+    ok &= bench_engine("engine_sine_16", "Sine", 16);
+    ok &= bench_engine("engine_vibrato_16", "Sine Vibrato", 16);
+    ok &= bench_engine("engine_drive_8", "Drive", 8);
+    ok &= bench_engine("engine_sample_8", "Keys", 8);
+    ok &= bench_engine("engine_fm_8", "FM Brass", 8);
+    ok &= bench_engine("engine_string_8", "Guitar", 8);
+    ok &= bench_engine("engine_unison_8", "Supersaw", 8);
+    bench_unison();
+    bench_midi();
+
+    if (!ok) {
+        bench_port_write("bench: preset missing\n");
+        return 1;
+    }
+    return 0;
+}
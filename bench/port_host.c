@@ -0,0 +1,28 @@
+/* Bench port for a native host build, a smoke test of the harness.
+ *
+ * The console is stdout and the counter is the monotonic clock in
+ * nanoseconds, so the figures are host time, not instructions, and vary
+ * from run to run. They show the harness builds, links and reports every
+ * case; only the qemu run is compared with the baseline.
+ */
+
+#include "bench_port.h"
+#include <stdio.h>
+#include <time.h>
+
+void bench_port_init(void) {
+}
+
+void bench_port_write(const char* s) {
+    fputs(s, stdout);
+}
+
+uint32_t bench_port_count(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+}
+
+uint32_t bench_port_elapsed(uint32_t start) {
+    return bench_port_count() - start;
+}
@@ -0,0 +1,88 @@
+/* Bench port for the MPS2 AN385 board as emulated by qemu-system-arm.
+ *
+ * The console is ARM semihosting. Instructions are counted with SysTick:
+ * qemu runs with -icount shift=0, so every instruction advances the
+ * virtual clock by exactly 1 ns and a SysTick on the processor clock moves
+ * one count per 10^9 / BENCH_SYSTICK_HZ instructions.
+ *
+ * The harness is built for the Cortex-M0+ (ARMv6-M) and the AN385's
+ * Cortex-M3 runs that subset unchanged.
+ */
+
+#include "bench_port.h"
+#include <string.h>
+
+#ifndef BENCH_SYSTICK_HZ
+#define BENCH_SYSTICK_HZ        25000000u   // The AN385's system clock in qemu
+#endif
+
+#define INSNS_PER_TICK          (1000000000u / BENCH_SYSTICK_HZ)
+
+#define SYST_CSR                (*(volatile uint32_t*)0xE000E010)
+#define SYST_RVR                (*(volatile uint32_t*)0xE000E014)
+#define SYST_CVR                (*(volatile uint32_t*)0xE000E018)
+#define SYST_MAX                0x00FFFFFFu
+
+#define SYS_WRITE0              0x04
+#define SYS_EXIT                0x18
+#define ADP_APPLICATION_EXIT    0x20026
+#define ADP_RUNTIME_ERROR       0x20023
+
+int main(void);
+
+extern uint32_t _sidata, _sdata, _edata, _sbss, _ebss, _estack;
+
+static int semihost(int op, const void* arg) {
+    register int r0 __asm__("r0") = op;
+    register const void* r1 __asm__("r1") = arg;
+    __asm__ volatile ("bkpt 0xab" : "+r"(r0) : "r"(r1) : "memory");
+    return r0;
+}
+
+void bench_port_init(void) {
+    SYST_CSR = 0;
+    SYST_RVR = SYST_MAX;
+    SYST_CVR = 0;
+    SYST_CSR = 0x5;     // Enabled on the processor clock, no interrupt
+}
+
+void bench_port_write(const char* s) {
+    semihost(SYS_WRITE0, s);
+}
+
+uint32_t bench_port_count(void) {
+    return SYST_CVR;
+}
+
+uint32_t bench_port_elapsed(uint32_t start) {
+    // SysTick counts down
+    return ((start - SYST_CVR) & SYST_MAX) * INSNS_PER_TICK;
+}
+
+static void exit_with(uint32_t reason) {
+    semihost(SYS_EXIT, (const void*)(uintptr_t)reason);
+    for (;;) {
+    }
+}
+
+void Reset_Handler(void) {
+    memcpy(&_sdata, &_sidata, (size_t)((char*)&_edata - (char*)&_sdata));
+    memset(&_sbss, 0, (size_t)((char*)&_ebss - (char*)&_sbss));
+    exit_with(main() == 0 ? ADP_APPLICATION_EXIT : ADP_RUNTIME_ERROR);
+}
+
+static void Fault_Handler(void) {
+    bench_port_write("bench: fault\n");
+    exit_with(ADP_RUNTIME_ERROR);
+}
+
+__attribute__((section(".vectors"), used))
+static const void* const vectors[16] = {
+    &_estack,
+    Reset_Handler,
+    Fault_Handler,      // NMI
+    Fault_Handler,      // HardFault
+    Fault_Handler,      // MemManage, the M3 only
+    Fault_Handler,      // BusFault
+    Fault_Handler,      // UsageFault
+};
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""Run the kernel benchmark under qemu and check it against the baseline.
+
+Boots kernel_bench on the emulated MPS2 AN385 with -icount shift=0, so the
+instruction counts it prints are exact and repeat from run to run. Each
+"BENCH <case> <unit> <count>" line is compared with baseline.json: a case
+more than --tolerance percent above its baseline fails the run, as do a
+baseline case that no longer reports and a case the baseline does not
+have, which would otherwise go unchecked. Cases that got cheaper are
+listed so the baseline can be refreshed with --update. A baseline with no
+cases at all exits with SKIP_STATUS, which ctest reports as skipped
+rather than passed.
+
+With --native the ELF is a host build (port_host.c) run directly. Its
+figures are host time, so only the set of cases is checked: it must run,
+report, and match the baseline's cases once there are any.
+"""
+
+import argparse
+import json
+import re
+import subprocess
+import sys
+
+BENCH_RE = re.compile(r"^BENCH (\S+) (\S+) ([0-9.]+)$")
+
+# Matches SKIP_RETURN_CODE of the kernel_bench test
+SKIP_STATUS = 77
+
+
+def run(qemu, elf, timeout, native=False):
+    cmd = [elf] if native else [
+        qemu,
+        "-machine", "mps2-an385",
+        "-cpu", "cortex-m3",
+        "-nographic",
+        "-monitor", "none",
+        "-serial", "none",
+        "-semihosting-config", "enable=on,target=native",
+        "-icount", "shift=0",
+        "-kernel", elf,
+    ]
+    proc = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                          universal_newlines=True, timeout=timeout)
+    results = {}
+    for line in proc.stdout.splitlines():
+        m = BENCH_RE.match(line.strip())
+        if m:
+            results[m.group(1)] = {"unit": m.group(2), "insns": float(m.group(3))}
+        elif line.strip():
+            print(line, file=sys.stderr)
+    if proc.returncode != 0:
+        sys.exit("kernel_bench exited with status %d" % proc.returncode)
+    return results
+
+
+def compare(results, baseline, tolerance):
+    failed = False
+    cases = baseline.get("cases", {})
+    for name, base in sorted(cases.items()):
+        if name not in results:
+            print("FAIL  %-20s missing from the run" % name)
+            failed = True
+            continue
+        now = results[name]["insns"]
+        change = 100.0 * (now - base["insns"]) / base["insns"] if base["insns"] else 0.0
+        if change > tolerance:
+            status = "FAIL"
+            failed = True
+        elif change < -tolerance:
+            status = "better"
+        else:
+            status = "ok"
+        print("%-5s %-20s %10.2f insns/%-7s baseline %10.2f  %+6.2f%%"
+              % (status, name, now, results[name]["unit"], base["insns"], change))
+    for name in sorted(set(results) - set(cases)):
+        print("FAIL  %-20s %10.2f insns/%-7s not in the baseline"
+              % (name, results[name]["insns"], results[name]["unit"]))
+        failed = True
+    return failed
+
+
+def check_cases(results, baseline):
+    cases = set(baseline.get("cases", {}))
+    failed = False
+    for name in sorted(results):
+        status = "ok" if not cases or name in cases else "FAIL"
+        failed |= status == "FAIL"
+        print("%-5s %-20s %10.2f ns/%s (host time)" % (status, name, results[name]["insns"], results[name]["unit"]))
+    for name in sorted(cases - set(results)):
+        print("FAIL  %-20s missing from the run" % name)
+        failed = True
+    return failed
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--qemu", default="qemu-system-arm")
+    ap.add_argument("--elf", required=True)
+    ap.add_argument("--baseline", required=True)
+    ap.add_argument("--compiler", default="", help="recorded with the baseline, counts depend on it")
+    ap.add_argument("--tolerance", type=float, default=0.5, help="percent over baseline that fails")
+    ap.add_argument("--timeout", type=float, default=300.0)
+    ap.add_argument("--update", action="store_true", help="write this run as the new baseline")
+    ap.add_argument("--native", action="store_true", help="run a host build and only check its cases")
+    args = ap.parse_args()
+
+    results = run(args.qemu, args.elf, args.timeout, args.native)
+    if not results:
+        sys.exit("kernel_bench reported no cases")
+
+    if args.native:
+        if args.update:
+            sys.exit("a host build has no instruction counts to record")
+        with open(args.baseline) as f:
+            if check_cases(results, json.load(f)):
+                sys.exit(1)
+        return
+
+    if args.update:
+        baseline = {"compiler": args.compiler or None, "cases": results}
+        with open(args.baseline, "w") as f:
+            json.dump(baseline, f, indent=2, sort_keys=True)
+            f.write("\n")
+        print("Recorded %d cases to %s" % (len(results), args.baseline))
+        return
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    if not baseline.get("cases"):
+        print("SKIP  %s has no cases, record one with the bench_baseline target" % args.baseline)
+        sys.exit(SKIP_STATUS)
+
+    recorded = baseline.get("compiler")
+    if recorded and args.compiler and recorded != args.compiler:
+        print("note: baseline was recorded with %s, this build uses %s" % (recorded, args.compiler),
+              file=sys.stderr)
+
+    if compare(results, baseline, args.tolerance):
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
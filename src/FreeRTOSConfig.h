@@ -58,7 +58,7 @@
 #define configUSE_APPLICATION_TASK_TAG          1   // To assist with debugging
 #define configUSE_COUNTING_SEMAPHORES           1
 #define configQUEUE_REGISTRY_SIZE               8   // Allow up to 8 queues to be registered with the trace facility.
-#define configUSE_QUEUE_SETS                    1
+#define configUSE_QUEUE_SETS                    0   // ISRs wake tasks with direct notifications
 #define configUSE_TIME_SLICING                  1
 #define configUSE_NEWLIB_REENTRANT              1   // RP2040 sdk uses newlib and requires this option to be set
 #define configENABLE_BACKWARD_COMPATIBILITY     0
@@ -69,9 +69,11 @@
 #define configMESSAGE_BUFFER_LENGTH_TYPE        size_t
 
 /* Memory allocation related definitions. */
-#define configSUPPORT_STATIC_ALLOCATION         0
+/* Tasks and queues are allocated statically. A small heap is kept for
+ * library code that may still allocate. */
+#define configSUPPORT_STATIC_ALLOCATION         1
 #define configSUPPORT_DYNAMIC_ALLOCATION        1
-#define configTOTAL_HEAP_SIZE                   (128*1024)
+#define configTOTAL_HEAP_SIZE                   (2*1024)
 #define configAPPLICATION_ALLOCATED_HEAP        0
 
 /* Hook function related definitions. */
@@ -110,6 +112,7 @@ extern uint32_t ulGetRunTimeCounterValue( void );
 #define configNUM_CORES                         2
 #define configTICK_CORE                         0
 #define configRUN_MULTIPLE_PRIORITIES           0
+#define configUSE_CORE_AFFINITY                 1   // Audio task is pinned, its interpolator state is per core
 
 /* RP2040 specific */
 #define configSUPPORT_PICO_SYNC_INTEROP         1
@@ -139,6 +142,11 @@ to exclude the API function. */
 #define INCLUDE_xQueueGetMutexHolder            1
 
 /* A header file that defines trace macro can be included here. */
+#include "trace.h"
+#if TRACE_ENABLE
+/* Tasks are identified by the number set with vTaskSetTaskNumber */
+#define traceTASK_SWITCHED_IN()     trace_record( TRACE_EV_TASK_IN, ( uint16_t ) pxCurrentTCB->uxTaskNumber )
+#endif
 
 #endif /* FREERTOS_CONFIG_H */
 
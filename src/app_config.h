@@ -8,7 +8,11 @@
 /* -----------------------------------------------------------
  * System Configuration
  * ----------------------------------------------------------- */
-#define SYS_CLOCK_KHZ           132000
+/* Window for the system clock. The clock plan search picks the PLL setting
+ * inside it that divides best into the I2S clocks of the sample rate, e.g.
+ * 132 MHz for 48 kHz */
+#define SYS_CLOCK_MIN_KHZ       100000
+#define SYS_CLOCK_MAX_KHZ       133000
 
 /* -----------------------------------------------------------
  * Task Configuration
@@ -16,14 +20,24 @@
 /* Priorities (Higher number = Higher Priority) */
 #define PRIORITY_AUDIO_TASK     ( tskIDLE_PRIORITY + 4 )
 #define PRIORITY_MIDI_TASK      ( tskIDLE_PRIORITY + 3 )
+#define PRIORITY_USB_TASK       ( tskIDLE_PRIORITY + 3 )
 #define PRIORITY_LOGGING_TASK   ( tskIDLE_PRIORITY + 2 )
 #define PRIORITY_ALIVE_TASK     ( tskIDLE_PRIORITY + 1 )
 
+/* The oscillators use the core-local interpolators, so the audio task must
+ * not migrate between cores */
+#define CORE_AFFINITY_AUDIO     ( 1u << 0 )
+
+/* Heartbeat LED period, and how often the diagnostics report is logged */
+#define ALIVE_PERIOD_MS         500
+#define DIAG_REPORT_INTERVAL_MS 10000
+
 /* Stack Sizes (in words, not bytes) */
 #define STACK_SIZE_AUDIO        ( configMINIMAL_STACK_SIZE + 256 )
 #define STACK_SIZE_MIDI         ( configMINIMAL_STACK_SIZE + 128 )
+#define STACK_SIZE_USB          ( configMINIMAL_STACK_SIZE + 128 )
 #define STACK_SIZE_LOGGING      ( configMINIMAL_STACK_SIZE + 128 )
-#define STACK_SIZE_ALIVE        ( configMINIMAL_STACK_SIZE )
+#define STACK_SIZE_ALIVE        ( configMINIMAL_STACK_SIZE + 128 )  /* Formats the diagnostics report */
 
 /* -----------------------------------------------------------
  * Pin Definitions
@@ -44,6 +58,18 @@
 #define UART_ID_LOG             uart0
 #define BAUD_RATE_LOG           115200
 
+/* Binary control frames arrive on PIN_LOG_RX (see control_proto.h). DMA
+ * fills a ring that the audio task drains between blocks, 1 KB holds
+ * about 90 ms at the log baud rate. */
+#define CONTROL_RX_RING_BITS    10
+
+/* Audio tap (see audio_tap.h): the rendered output as 8N1 serial on a
+ * spare pin, for a USB serial adapter. 44.1 and 48 kHz stereo fit in
+ * 3 Mbaud, 96 kHz needs 4 Mbaud or drops blocks. */
+#define PIN_AUDIO_TAP           3
+#define AUDIO_TAP_PIO           pio1
+#define AUDIO_TAP_BAUD          3000000
+
 /* I2S Audio */
 #define PIN_I2S_DOUT            6
 #define PIN_I2S_DIN             7
@@ -51,12 +77,60 @@
 #define PIN_I2S_LRCK            9
 #define PIN_I2S_SCK             10  /* System Clock / Master Clock if needed */
 
+/* 1 boots following an external I2S master on PIN_I2S_BCLK and
+ * PIN_I2S_LRCK instead of driving them, the control port's
+ * CONTROL_PARAM_CLOCK_SLAVE switches at runtime. The
+ * master's drift from AUDIO_SAMPLE_RATE is measured and tuned out (see
+ * clock_drift.h). With AUDIO_I2S_PACKED the master must run BCK at
+ * 32 fs, 16 clocks per channel: the packed programs move one word per
+ * LRCK frame, so at 64 fs they play and record the wrong halves. The
+ * audio task measures the ratio and logs any other as a lock failure;
+ * build with AUDIO_I2S_PACKED 0 for a 64 fs master. */
+#define AUDIO_I2S_SLAVE         0
+
+/* 1 adds a second stereo output on PIN_I2S_DOUT2 for a second DAC on the
+ * same BCK and LRCK, fed by its own state machine on AUDIO_I2S_BUS2_PIO.
+ * Parts pick their output with the output control parameter. Claims two
+ * free DMA channels and doubles the output ring's RAM. Packed, it follows
+ * the 32 fs clocks the master programs drive (see AUDIO_I2S_SLAVE). */
+#define AUDIO_I2S_BUS2          0
+#define PIN_I2S_DOUT2           11
+#define AUDIO_I2S_BUS2_PIO      pio1
+
 /* -----------------------------------------------------------
  * Audio Settings
  * ----------------------------------------------------------- */
-#define AUDIO_SAMPLE_RATE       48000
+#define AUDIO_SAMPLE_RATE       48000   /* At boot, the control port selects 44.1, 48 or 96 kHz at runtime */
 #define AUDIO_BUFFER_FRAMES     256
 #define AUDIO_BIT_DEPTH         16
 #define AUDIO_CHANNELS          2
 
+/* 1 packs each 16-bit stereo frame into one 32-bit word of the I2S
+ * buffers, halving their RAM and the DMA transfers per frame. 0 keeps a
+ * left-justified word per channel, which is what other bit depths and
+ * 64 fs external masters need. */
+#define AUDIO_I2S_PACKED        1
+
+/* Output buffers in the DMA ring: 2, 4 or 8. With 2 the audio task renders
+ * each block while the other plays (classic double buffering). More buffers
+ * let it render ahead, so a long block spends slack instead of underrunning,
+ * at a latency of (AUDIO_BUFFER_COUNT - 1) blocks. */
+#define AUDIO_BUFFER_COUNT      2
+
+/* -----------------------------------------------------------
+ * Synth Engine Settings
+ * ----------------------------------------------------------- */
+#define SYNTH_MAX_VOICES        16
+
+/* Controllers and gains are updated once per sub-block and ramped linearly
+ * across it */
+#define SYNTH_SUBBLOCK_BITS     5
+#define SYNTH_SUBBLOCK_FRAMES   (1 << SYNTH_SUBBLOCK_BITS)
+
+/* Plucked strings take their delay lines from a fixed pool of
+ * SYNTH_STRING_SLOTS lines, 2^SYNTH_STRING_SLOT_BITS frames each (16 KB).
+ * 1024 frames tune down to 47 Hz at 48 kHz, lower notes sound an octave up */
+#define SYNTH_STRING_SLOTS      8
+#define SYNTH_STRING_SLOT_BITS  10
+
 #endif /* APP_CONFIG_H */
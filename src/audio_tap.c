@@ -0,0 +1,138 @@
+#include "audio_tap.h"
+#include "app_config.h"
+#include "i2s.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "audio_tap.pio.h"
+
+/* Bytes each word puts on the line: a whole packed frame, or one
+ * left-justified sample
+ */
+#if AUDIO_I2S_PACKED
+#define TAP_WORD_BYTES      4
+#else
+#define TAP_WORD_BYTES      2
+#endif
+#define TAP_HEADER_WORDS    (16 / TAP_WORD_BYTES)
+#define TAP_TRAILER_WORDS   (4 / TAP_WORD_BYTES)
+#define TAP_BLOCK_WORDS     (AUDIO_BUFFER_FRAMES * AUDIO_CHANNELS * 2 / TAP_WORD_BYTES)
+
+// Word of a header field at a byte offset
+#define TAP_FIELD(byte)     (&header[(byte) / TAP_WORD_BYTES])
+
+_Static_assert(TAP_BLOCK_WORDS == STEREO_BUFFER_SIZE, "the tap sends whole I2S blocks");
+
+static uint sm;
+static int dma_ch_header;
+static int dma_ch_data;
+static int dma_ch_trailer;
+static uint32_t dma_mask;
+
+// Laid out like the samples, so the same program sends them
+static uint32_t header[TAP_HEADER_WORDS];
+static uint32_t trailer[TAP_TRAILER_WORDS];
+
+static bool enabled = false;
+static uint32_t seq = 0;
+static const int32_t* in_flight = NULL;    // Block the data channel was last armed with
+static uint32_t drops = 0;
+
+// Low half first on the line
+static void put32(uint32_t* words, uint32_t value) {
+#if AUDIO_I2S_PACKED
+    words[0] = (value << 16) | (value >> 16);
+#else
+    words[0] = value << 16;
+    words[1] = value & 0xFFFF0000u;
+#endif
+}
+
+static void configure_channel(int ch, int chain_to, const uint32_t* read, uint32_t count) {
+    dma_channel_config c = dma_channel_get_default_config(ch);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(AUDIO_TAP_PIO, sm, true));
+    channel_config_set_chain_to(&c, chain_to);
+    dma_channel_configure(ch, &c, &AUDIO_TAP_PIO->txf[sm], read, count, false);
+}
+
+static bool busy(void) {
+    return dma_channel_is_busy(dma_ch_header) || dma_channel_is_busy(dma_ch_data) ||
+           dma_channel_is_busy(dma_ch_trailer);
+}
+
+void audio_tap_init(void) {
+    sm = pio_claim_unused_sm(AUDIO_TAP_PIO, true);
+    uint offset = pio_add_program(AUDIO_TAP_PIO, AUDIO_I2S_PACKED ? &audio_tap_tx_packed_program : &audio_tap_tx_program);
+    audio_tap_tx_program_init(AUDIO_TAP_PIO, sm, offset, PIN_AUDIO_TAP, AUDIO_I2S_PACKED);
+
+    dma_ch_header  = dma_claim_unused_channel(true);
+    dma_ch_data    = dma_claim_unused_channel(true);
+    dma_ch_trailer = dma_claim_unused_channel(true);
+    dma_mask = (1u << dma_ch_header) | (1u << dma_ch_data) | (1u << dma_ch_trailer);
+
+    // Header, then the block, then the trailer. Chaining to itself ends the chain
+    configure_channel(dma_ch_header, dma_ch_data, header, TAP_HEADER_WORDS);
+    configure_channel(dma_ch_data, dma_ch_trailer, NULL, TAP_BLOCK_WORDS);
+    configure_channel(dma_ch_trailer, dma_ch_trailer, trailer, TAP_TRAILER_WORDS);
+
+    put32(TAP_FIELD(0), AUDIO_TAP_MAGIC);
+    put32(TAP_FIELD(12), AUDIO_BUFFER_FRAMES | ((uint32_t)AUDIO_CHANNELS << 16));
+    audio_tap_set_clock(clock_get_hz(clk_sys), AUDIO_SAMPLE_RATE);
+
+    pio_sm_set_enabled(AUDIO_TAP_PIO, sm, true);
+}
+
+void audio_tap_set_clock(uint32_t sys_hz, uint32_t sample_rate) {
+    // In 1/256ths of a PIO cycle, the jitter of the fraction is well inside a bit
+    uint32_t div = (uint32_t)(((uint64_t)sys_hz << 8) /
+                              ((uint32_t)audio_tap_tx_program_pio_mult * AUDIO_TAP_BAUD));
+    pio_sm_set_clkdiv_int_frac(AUDIO_TAP_PIO, sm, (uint16_t)(div >> 8), (uint8_t)div);
+    put32(TAP_FIELD(8), sample_rate);
+}
+
+void audio_tap_enable(bool enable) {
+    enabled = enable;
+}
+
+bool audio_tap_is_enabled(void) {
+    return enabled;
+}
+
+void audio_tap_send(const int32_t* block) {
+    if (!enabled) return;
+
+    uint32_t n = seq++;
+    if (busy()) {
+        drops++;
+        return;
+    }
+
+    put32(TAP_FIELD(4), n);
+    put32(trailer, n);
+    in_flight = block;
+    dma_channel_set_read_addr(dma_ch_data, block, false);
+    dma_channel_set_read_addr(dma_ch_trailer, trailer, false);
+    __compiler_memory_barrier();    // The header and trailer are in place before the trigger
+    dma_channel_set_read_addr(dma_ch_header, header, true);
+}
+
+void audio_tap_release(const int32_t* block) {
+    if (block != in_flight || !busy()) return;
+
+    // Aborting the whole chain at once, so no channel can trigger the next
+    dma_hw->abort = dma_mask;
+    while (dma_hw->abort & dma_mask) {
+        tight_loop_contents();
+    }
+    in_flight = NULL;
+    drops++;
+}
+
+uint32_t audio_tap_take_drops(void) {
+    uint32_t n = drops;
+    drops = 0;
+    return n;
+}
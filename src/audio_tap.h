@@ -0,0 +1,57 @@
+#ifndef AUDIO_TAP_H
+#define AUDIO_TAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Streams the rendered output to a host for analysis, straight out of the
+ * I2S output buffer.
+ *
+ * A PIO state machine on PIN_AUDIO_TAP is an 8N1 transmitter at
+ * AUDIO_TAP_BAUD that sends the 16-bit samples of the buffer words, both
+ * halves of a packed frame or the top half of a left-justified sample
+ * (AUDIO_I2S_PACKED). Three chained DMA channels feed it a block as
+ *
+ *   "TAP1" | seq (4) | sample rate (4) | frames (2) | channels (2)
+ *   | frames * channels samples (2 each) | seq (4)
+ *
+ * with every field little-endian. seq counts the blocks offered to the tap,
+ * so a gap is a block that was dropped because the previous one was still
+ * on the line, and a trailer that does not match its header is a block cut
+ * short. tools/tap_to_wav.py rebuilds a WAV file from the stream.
+ *
+ * The tap has its own line rather than USB CDC or the log UART: CDC would
+ * copy every byte through the USB task, and the log UART carries the log
+ * and control frames at BAUD_RATE_LOG, far below the 2 Mbaud of 48 kHz
+ * stereo. The cost is a second USB serial adapter, on PIN_AUDIO_TAP.
+ * CONTROL_PARAM_AUDIO_TAP turns the tap on and off.
+ *
+ * The samples are never copied: the DMA reads the block the audio task
+ * just rendered while the I2S plays it. The audio task only arms the DMA,
+ * and before it renders into a buffer it releases it, which stops the tap
+ * if it is still reading that buffer.
+ */
+
+#define AUDIO_TAP_MAGIC     0x31504154u     // "TAP1"
+
+// Claims a state machine and three DMA channels, the tap starts disabled
+void audio_tap_init(void);
+
+// Follows a change of system clock or output sample rate
+void audio_tap_set_clock(uint32_t sys_hz, uint32_t sample_rate);
+
+void audio_tap_enable(bool enable);
+bool audio_tap_is_enabled(void);
+
+/* Sends a rendered block of AUDIO_BUFFER_FRAMES stereo frames, or drops it
+ * if the previous block has not gone out yet.
+ */
+void audio_tap_send(const int32_t* block);
+
+// Stops the tap if it is reading block, which is about to be rendered
+void audio_tap_release(const int32_t* block);
+
+// Blocks dropped or cut short since the last call
+uint32_t audio_tap_take_drops(void);
+
+#endif /* AUDIO_TAP_H */
@@ -1,37 +1,477 @@
 #include "FreeRTOS.h"
 #include "task.h"
-#include "semphr.h"
 #include "queue.h"
 #include "audio_task.h"
 #include "i2s.h"
 #include "synth_engine.h"
+#include "synth_osc.h"
+#include "synth_arp.h"
+#include "synth_governor.h"
+#include "synth_fm.h"
+#include "synth_string.h"
+#include "synth_unison.h"
+#include "sample_stream.h"
+#include "control_port.h"
+#include "audio_tap.h"
+#include "clock_drift.h"
 #include "hardware/dma.h"
+#include "hardware/structs/systick.h"
 #include "log_task.h"
 #include "app_config.h"
+#include "trace.h"
+#include "diagnostics.h"
+#include <string.h>
 
 static __attribute__((aligned(8))) pio_i2s i2s;
+#if AUDIO_I2S_BUS2
+static __attribute__((aligned(8))) pio_i2s_follower i2s_bus2;
+#endif
 
 typedef struct {
-    uint8_t note_on;
-    float frequency;
+    uint8_t type;
+    uint8_t channel;
+    uint8_t data1;
+    uint8_t data2;
+    uint32_t value;
 } AudioMessage_t;
 
-#define AUDIO_QUEUE_LENGTH 10
+#define AUDIO_QUEUE_LENGTH 32
 static QueueHandle_t xAudioQueue;
-static SemaphoreHandle_t xAudioISRSemaphore;
-static QueueSetHandle_t xAudioQueueSet;
+static StaticQueue_t xAudioQueueBuffer;
+static uint8_t ucAudioQueueStorage[AUDIO_QUEUE_LENGTH * sizeof(AudioMessage_t)];
 
-void vAudioTaskSetFrequency(uint8_t note_on, float frequency) {
+// The DMA ISR and event posters wake the task with notification bits
+#define AUDIO_NOTIFY_BLOCK          (1u << 0)   // The DMA finished a block
+#define AUDIO_NOTIFY_EVENT          (1u << 1)   // An event was queued
+
+// A slave whose master has stopped gets no block wakes, so the control
+// port is also polled after this long without one
+#define AUDIO_SLAVE_POLL_MS         100
+static TaskHandle_t xAudioTaskHandle = NULL;
+
+/* Block n of the output stream lives in ring buffer n % AUDIO_BUFFER_COUNT.
+ * The ISR counts the blocks the DMA has finished, so the DMA is playing
+ * block ulBlocksPlayed and the task may render up to
+ * ulBlocksPlayed + AUDIO_BUFFER_COUNT - 1. */
+static volatile uint32_t ulBlocksPlayed = 0;
+static uint32_t ulBlocksRendered = AUDIO_BUFFER_COUNT;  // The ring starts out as rendered silence
+
+// Changed at runtime with CONTROL_PARAM_SAMPLE_RATE
+static uint32_t ulSampleRate = AUDIO_SAMPLE_RATE;
+
+// SysTick value when the DMA IRQ fired, for the wake latency in cycles
+static volatile uint32_t ulDmaIrqSysTick;
+
+// Microsecond time of the last block edge, for the drift of an external master
+static volatile uint32_t ulDmaIrqUs;
+
+// Arpeggiator controllers, on the channel the arpeggiator should play
+#define CC_ARP_ENABLE   80  // >= 64 binds the arpeggiator to the channel
+#define CC_ARP_MODE     81  // Up, down, up-down
+#define CC_ARP_RATE     82  // 1/4, 1/8, 1/16, 1/32 notes
+
+#define AUDIO_MAX_ARP_EVENTS 16
+
+// Render statistics are logged about once a second
+#define AUDIO_STATS_INTERVAL_BLOCKS (ulSampleRate / AUDIO_BUFFER_FRAMES)
+
+// Blocks rendered ahead at a wake: the DMA has just taken one of the
+// AUDIO_BUFFER_COUNT, so at most AUDIO_BUFFER_COUNT - 2
+#define AUDIO_SLACK_BINS (AUDIO_BUFFER_COUNT - 1)
+
+void vAudioTaskPostEvent(AudioEventType_t type, uint8_t channel, uint8_t data1, uint8_t data2) {
     AudioMessage_t msg;
-    msg.frequency = frequency;
-    msg.note_on = note_on;
-    xQueueSendToBack(xAudioQueue, &msg, 0);
+    msg.type = (uint8_t)type;
+    msg.channel = channel;
+    msg.data1 = data1;
+    msg.data2 = data2;
+    msg.value = 0;
+    if (xQueueSendToBack(xAudioQueue, &msg, 0) == pdTRUE && xAudioTaskHandle != NULL) {
+        xTaskNotify(xAudioTaskHandle, AUDIO_NOTIFY_EVENT, eSetBits);
+    }
+}
+
+void vAudioTaskPostClock(AudioEventType_t type, uint32_t value) {
+    AudioMessage_t msg;
+    msg.type = (uint8_t)type;
+    msg.channel = 0;
+    msg.data1 = 0;
+    msg.data2 = 0;
+    msg.value = value;
+    if (xQueueSendToBack(xAudioQueue, &msg, 0) == pdTRUE && xAudioTaskHandle != NULL) {
+        xTaskNotify(xAudioTaskHandle, AUDIO_NOTIFY_EVENT, eSetBits);
+    }
+}
+
+static void prvSetSampleRate(uint32_t fs);
+static void prvSetClockSlave(bool slave);
+
+static void prvControlChange(uint8_t channel, uint8_t controller, uint8_t value) {
+    static const uint8_t ticks_per_step[4] = { 24, 12, 6, 3 };
+
+    switch (controller) {
+    case CC_ARP_ENABLE:
+        if (value >= 64) {
+            uint8_t old = synth_arp_get_part();
+            if (old != SYNTH_ARP_NONE && old != channel) {
+                synth_engine_control_change(old, 123, 0);
+            }
+            synth_arp_set_part(channel);
+        } else if (synth_arp_get_part() == channel) {
+            synth_arp_set_part(SYNTH_ARP_NONE);
+            synth_engine_control_change(channel, 123, 0);   // All notes off
+        }
+        break;
+    case CC_ARP_MODE:
+        synth_arp_set_mode((synth_arp_mode_t)((value * SYNTH_ARP_MODE_COUNT) >> 7));
+        break;
+    case CC_ARP_RATE:
+        synth_arp_set_ticks_per_step(ticks_per_step[value >> 5]);
+        break;
+    default:
+        synth_engine_control_change(channel, controller, value);
+        break;
+    }
+}
+
+/* Device parameters of a control frame. They restart the output, so they
+ * come from the control port only, never from a MIDI controller.
+ */
+static void prvDeviceSetting(control_param_t param, uint16_t value) {
+    switch (param) {
+    case CONTROL_PARAM_SAMPLE_RATE:
+        prvSetSampleRate((uint32_t)value * 100);
+        break;
+    case CONTROL_PARAM_CLOCK_SLAVE:
+        prvSetClockSlave(value != 0);
+        break;
+    case CONTROL_PARAM_AUDIO_TAP:
+        if ((value != 0) != audio_tap_is_enabled()) {
+            char msg_buf[48];
+            audio_tap_enable(value != 0);
+            snprintf(msg_buf, sizeof(msg_buf), "Audio tap %s, GPIO %d at %lu baud",
+                     value ? "on" : "off", PIN_AUDIO_TAP, (uint32_t)AUDIO_TAP_BAUD);
+            log_msg(msg_buf);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Points pBuffers at ring buffer ulBlock % AUDIO_BUFFER_COUNT of every bus
+static void prvBlockBuffers(uint32_t ulBlock, int32_t* pBuffers[SYNTH_OUTPUT_BUSES]) {
+    size_t offset = (ulBlock % AUDIO_BUFFER_COUNT) * STEREO_BUFFER_SIZE;
+    pBuffers[0] = &i2s.output_buffer[offset];
+#if AUDIO_I2S_BUS2
+    pBuffers[1] = &i2s_bus2.output_buffer[offset];
+#endif
+}
+
+static void prvRenderFrames(int32_t* const pBuffers[], size_t pos, size_t frames) {
+    int32_t* pOutputs[SYNTH_OUTPUT_BUSES];
+    for (int bus = 0; bus < SYNTH_OUTPUT_BUSES; bus++) {
+        pOutputs[bus] = &pBuffers[bus][I2S_WORDS_PER_FRAME * pos];
+    }
+    synth_engine_process(pOutputs, frames);
+}
+
+/* Renders one block into every bus, splitting it at the arpeggiator's note
+ * events so each one starts on its exact frame.
+ */
+static void prvRenderBlock(int32_t* const pBuffers[]) {
+    synth_arp_event_t events[AUDIO_MAX_ARP_EVENTS];
+    size_t count = synth_arp_render(AUDIO_BUFFER_FRAMES, events, AUDIO_MAX_ARP_EVENTS);
+    uint8_t part = synth_arp_get_part();
+    size_t pos = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (events[i].offset > pos) {
+            prvRenderFrames(pBuffers, pos, events[i].offset - pos);
+            pos = events[i].offset;
+        }
+        if (events[i].note_on) {
+            synth_engine_note_on(part, events[i].note, events[i].velocity);
+        } else {
+            synth_engine_note_off(part, events[i].note);
+        }
+    }
+    if (pos < AUDIO_BUFFER_FRAMES) {
+        prvRenderFrames(pBuffers, pos, AUDIO_BUFFER_FRAMES - pos);
+    }
+}
+
+/* Accumulates the engine's per-block render statistics and the DMA IRQ to
+ * render wake latency, and logs the render load, frames/s per voice, the
+ * most expensive part and the wake latency spread about once a second.
+ */
+static void prvUpdateRenderStats(uint32_t wake_cycles, uint32_t slack) {
+    static uint32_t blocks = 0;
+    static uint32_t slack_hist[AUDIO_SLACK_BINS];
+    static uint32_t wake_min = UINT32_MAX;
+    static uint32_t wake_max = 0;
+    static uint32_t wake_sum = 0;
+    static uint32_t render_us = 0;
+    static uint32_t voice_frames = 0;
+    static uint32_t part_us[SYNTH_MAX_PARTS];
+    static uint32_t stream_misses = 0;
+
+    synth_engine_stats_t stats;
+    synth_engine_take_stats(&stats);
+    render_us += stats.render_us;
+    voice_frames += stats.voice_frames;
+    stream_misses += stats.stream_misses;
+    for (int p = 0; p < SYNTH_MAX_PARTS; p++) {
+        part_us[p] += stats.part_render_us[p];
+    }
+    if (wake_cycles < wake_min) wake_min = wake_cycles;
+    if (wake_cycles > wake_max) wake_max = wake_cycles;
+    wake_sum += wake_cycles;
+    slack_hist[(slack < AUDIO_SLACK_BINS) ? slack : AUDIO_SLACK_BINS - 1]++;
+
+    if (++blocks < AUDIO_STATS_INTERVAL_BLOCKS) {
+        return;
+    }
+
+    if (voice_frames > 0 && render_us > 0) {
+        int top = 0;
+        for (int p = 1; p < SYNTH_MAX_PARTS; p++) {
+            if (part_us[p] > part_us[top]) top = p;
+        }
+
+        char msg_buf[64];
+        snprintf(msg_buf, sizeof(msg_buf), "Render %lu us/s, %lu frames/s/voice",
+                 render_us, (uint32_t)(((uint64_t)voice_frames * 1000000u) / render_us));
+        log_msg(msg_buf);
+        snprintf(msg_buf, sizeof(msg_buf), "Top part %d: %lu us/s", top + 1, part_us[top]);
+        log_msg(msg_buf);
+    }
+
+    char msg_buf[64];
+    snprintf(msg_buf, sizeof(msg_buf), "Wake %lu/%lu/%lu cycles min/avg/max",
+             wake_min, wake_sum / blocks, wake_max);
+    log_msg(msg_buf);
+
+    if (stream_misses > 0) {
+        snprintf(msg_buf, sizeof(msg_buf), "Sample prefetch misses %lu", stream_misses);
+        log_msg(msg_buf);
+    }
+
+    uint32_t control_errors = control_port_take_errors();
+    if (control_errors > 0) {
+        snprintf(msg_buf, sizeof(msg_buf), "Control frames dropped %lu", control_errors);
+        log_msg(msg_buf);
+    }
+
+    uint32_t slips = clock_drift_take_slips();
+    if (slips > 0) {
+        snprintf(msg_buf, sizeof(msg_buf), "I2S slave lost lock, %lu slips", slips);
+        log_msg(msg_buf);
+    }
+
+    uint32_t tap_drops = audio_tap_take_drops();
+    if (tap_drops > 0) {
+        snprintf(msg_buf, sizeof(msg_buf), "Audio tap blocks dropped %lu", tap_drops);
+        log_msg(msg_buf);
+    }
+
+    // Blocks already rendered ahead when the DMA woke the task
+    int len = snprintf(msg_buf, sizeof(msg_buf), "Slack");
+    for (int i = 0; i < AUDIO_SLACK_BINS && len < (int)sizeof(msg_buf); i++) {
+        len += snprintf(&msg_buf[len], sizeof(msg_buf) - len, " %d:%lu", i, slack_hist[i]);
+        slack_hist[i] = 0;
+    }
+    log_msg(msg_buf);
+
+    blocks = 0;
+    wake_min = UINT32_MAX;
+    wake_max = 0;
+    wake_sum = 0;
+    render_us = 0;
+    voice_frames = 0;
+    stream_misses = 0;
+    for (int p = 0; p < SYNTH_MAX_PARTS; p++) {
+        part_us[p] = 0;
+    }
+}
+
+static uint32_t prvBlockMicros(void) {
+    return (uint32_t)(((uint64_t)AUDIO_BUFFER_FRAMES * 1000000u) / ulSampleRate);
+}
+
+/* Flash streaming is the sample voices' hard limit: each one reads two
+ * bytes per frame at its playback step, up to 2.0.
+ */
+static void prvLogStreamBandwidth(void) {
+    uint32_t bw = sample_stream_get_bandwidth();
+    char msg_buf[64];
+    snprintf(msg_buf, sizeof(msg_buf), "Sample stream %lu kB/s: %lu voices at 1x, %lu at 2x",
+             bw / 1000, bw / (2 * ulSampleRate), bw / (4 * ulSampleRate));
+    log_msg(msg_buf);
+}
+
+static void prvLogLatency(void) {
+    char msg_buf[48];
+    snprintf(msg_buf, sizeof(msg_buf), "Output latency %lu us, %d buffers",
+             prvBlockMicros() * (AUDIO_BUFFER_COUNT - 1), AUDIO_BUFFER_COUNT);
+    log_msg(msg_buf);
+}
+
+/* With the I2S stopped, silences the ring of every bus and counts blocks
+ * again from its first buffer, where the DMA restarts.
+ */
+static void prvResetRing(void) {
+    for (int b = 0; b < AUDIO_BUFFER_COUNT; b++) {
+        audio_tap_release(&i2s.output_buffer[b * STEREO_BUFFER_SIZE]);
+    }
+    memset(i2s.output_buffer, 0, sizeof(i2s.output_buffer));
+#if AUDIO_I2S_BUS2
+    memset(i2s_bus2.output_buffer, 0, sizeof(i2s_bus2.output_buffer));
+#endif
+    ulBlocksPlayed = 0;
+    ulBlocksRendered = AUDIO_BUFFER_COUNT;
+}
+
+/* Moves the whole chain to a new sample rate: system clock, I2S dividers
+ * and everything in the engine that counts in frames. The output restarts
+ * from silence, which costs one ring of audio.
+ */
+static void prvSetSampleRate(uint32_t fs) {
+    if (fs == ulSampleRate) return;
+
+    clock_plan_request_t req;
+    clock_plan_t plan;
+    char msg_buf[64];
+    i2s_get_clock_request(&i2s.config, fs, &req);
+    if (!clock_plan_search(&req, &plan)) {
+        snprintf(msg_buf, sizeof(msg_buf), "No clock plan for %lu Hz", fs);
+        log_msg(msg_buf);
+        return;
+    }
+
+    // This task is pinned to the tick core, so SysTick is reloaded on the right core
+    taskENTER_CRITICAL();
+    clock_plan_apply(&plan);
+    taskEXIT_CRITICAL();
+
+    // Stops the ring and restarts it from its first buffer. The first DMA
+    // interrupt is a block away, so the ring starts over here.
+    i2s_set_sample_rate(&i2s, fs);
+    prvResetRing();
+    audio_tap_set_clock(plan.sys_hz, fs);
+
+    ulSampleRate = fs;
+    synth_engine_set_sample_rate(fs);
+    synth_arp_set_sample_rate(fs);
+    clock_drift_init(fs, AUDIO_BUFFER_FRAMES);
+    synth_governor_init(prvBlockMicros(), SYNTH_MAX_VOICES);
+
+    snprintf(msg_buf, sizeof(msg_buf), "Sample rate %lu Hz: sys %lu kHz, %ld ppb, jitter %lu ps",
+             fs, plan.sys_hz / 1000, plan.error_ppb, plan.jitter_ps);
+    log_msg(msg_buf);
+    prvLogLatency();
+}
+
+/* Hands BCK and LRCK to an external master or takes them back. Like a rate
+ * change, the output restarts from silence. The engine plays at the
+ * nominal rate until the first drift estimate.
+ */
+static void prvSetClockSlave(bool slave) {
+    if (slave == i2s.slaved) return;
+
+    i2s_stop(&i2s);
+    prvResetRing();
+    i2s_set_slaved(&i2s, slave);
+
+    synth_engine_set_rate_drift(0);
+    synth_arp_set_sample_rate(ulSampleRate);
+    clock_drift_init(ulSampleRate, AUDIO_BUFFER_FRAMES);
+
+    char msg_buf[64];
+    snprintf(msg_buf, sizeof(msg_buf), "I2S clock %s at %lu Hz", slave ? "slave" : "master", ulSampleRate);
+    log_msg(msg_buf);
+}
+
+/* Measures an external master's frame rate at each block edge and, once a
+ * window completes, moves the engine and arpeggiator to the rate it really
+ * plays at.
+ */
+static void prvTrackClockDrift(void) {
+    // The ISR updates both, read again if it ran in between
+    uint32_t ulPlayed, ulEdgeUs;
+    do {
+        ulPlayed = ulBlocksPlayed;
+        ulEdgeUs = ulDmaIrqUs;
+    } while (ulPlayed != ulBlocksPlayed);
+    if (ulPlayed == 0) {
+        return;     // No block edge since the ring restarted
+    }
+
+    clock_drift_state_t state;
+    if (!clock_drift_update(ulPlayed, ulEdgeUs, &state)) {
+        return;
+    }
+
+    char msg_buf[64];
+#if AUDIO_I2S_PACKED
+    // A master at any other ratio keeps the frame rate but scrambles the packed words
+    uint32_t bck_per_frame = i2s_measure_bck_per_frame(&i2s);
+    if (bck_per_frame != I2S_PACKED_BCK_PER_FRAME) {
+        synth_engine_set_rate_drift(0);
+        synth_arp_set_sample_rate(ulSampleRate);
+        snprintf(msg_buf, sizeof(msg_buf), "I2S slave not locked: BCK %lu fs, packed needs %d fs",
+                 bck_per_frame, I2S_PACKED_BCK_PER_FRAME);
+        log_msg(msg_buf);
+        return;
+    }
+#endif
+    synth_engine_set_rate_drift(state.drift_ppm);
+    synth_arp_set_sample_rate((uint32_t)((int64_t)ulSampleRate +
+                                         ((int64_t)ulSampleRate * state.drift_ppm) / 1000000));
+
+    snprintf(msg_buf, sizeof(msg_buf), "I2S slave %lu.%03lu Hz, drift %ld ppm, %lu slips",
+             state.rate_mhz / 1000, state.rate_mhz % 1000, state.drift_ppm, state.slips);
+    log_msg(msg_buf);
+}
+
+/* Feeds one block's render time to the overload governor and applies and
+ * logs any change of level.
+ */
+static void prvGovernBlock(uint32_t render_us) {
+    synth_governor_state_t state;
+    if (!synth_governor_update(render_us, synth_engine_get_active_voices(), &state)) {
+        return;
+    }
+    synth_engine_set_cost_tier((synth_cost_tier_t)state.tier);
+    synth_engine_set_voice_budget(state.voice_budget);
+
+    char msg_buf[64];
+    snprintf(msg_buf, sizeof(msg_buf), "Overload level %u: tier %u, %u voices (%lu%% load)",
+             state.level, state.tier, state.voice_budget, state.load_pct);
+    log_msg(msg_buf);
+}
+
+/* Cycles since a SysTick reading. SysTick is a 24-bit down counter that
+ * reloads every RTOS tick, so this handles one reload and the span must
+ * stay under one tick: clk_sys / configTICK_RATE_HZ cycles, 132000 at
+ * 132 MHz. A longer span silently comes out short by whole ticks. The
+ * startup measurements time one kernel over AUDIO_BUFFER_FRAMES, which
+ * holds up to about 500 cycles per frame; the wake latency is far shorter.
+ */
+static inline uint32_t prvSysTickElapsed(uint32_t since) {
+    uint32_t now = systick_hw->cvr;
+    return (since >= now) ? since - now : since + systick_hw->rvr + 1 - now;
 }
 
 static void dma_i2s_in_handler(void) {
+    TRACE_RECORD(TRACE_EV_ISR_ENTER, TRACE_ISR_DMA_I2S);
+    ulDmaIrqSysTick = systick_hw->cvr;
+    ulDmaIrqUs = time_us_32();
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    xSemaphoreGiveFromISR(xAudioISRSemaphore, &xHigherPriorityTaskWoken);
+    ulBlocksPlayed++;
+    xTaskNotifyFromISR(xAudioTaskHandle, AUDIO_NOTIFY_BLOCK, eSetBits, &xHigherPriorityTaskWoken);
     dma_hw->ints0 = 1u << i2s.dma_ch_in_data;  // clear the IRQ
+    TRACE_RECORD(TRACE_EV_ISR_EXIT, TRACE_ISR_DMA_I2S);
     portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
@@ -44,60 +484,294 @@ void vAudioTaskInit(void)
 
     // Initialize Synth Engine
     synth_engine_init();
+    synth_arp_init(AUDIO_SAMPLE_RATE);
+    synth_governor_init(prvBlockMicros(), SYNTH_MAX_VOICES);
+
+    // Set up event queue
+    xAudioQueue = xQueueCreateStatic(AUDIO_QUEUE_LENGTH, sizeof(AudioMessage_t),
+                                     ucAudioQueueStorage, &xAudioQueueBuffer);
+    diag_register_queue(xAudioQueue, "Audio");
 
-    // Set up ISR semaphore
-    xAudioISRSemaphore = xSemaphoreCreateBinary();
+    // Control frames on the log UART, their controllers take the MIDI route
+    control_port_init(prvControlChange, prvDeviceSetting);
 
-    // Set up Queue Set
-    xAudioQueue = xQueueCreate(AUDIO_QUEUE_LENGTH, sizeof(AudioMessage_t));
-    xAudioQueueSet = xQueueCreateSet(AUDIO_QUEUE_LENGTH + 1);
-    xQueueAddToSet(xAudioISRSemaphore, xAudioQueueSet);
-    xQueueAddToSet(xAudioQueue, xAudioQueueSet);
+    // Off until CONTROL_PARAM_AUDIO_TAP turns it on
+    audio_tap_init();
+}
+
+static void prvHandleMessage(const AudioMessage_t* msg) {
+    switch (msg->type) {
+    case AUDIO_EVENT_NOTE_ON:
+        // Notes on the arpeggiated part only feed the held-note list
+        if (msg->channel == synth_arp_get_part()) {
+            synth_arp_note_on(msg->data1, msg->data2);
+        } else {
+            synth_engine_note_on(msg->channel, msg->data1, msg->data2);
+        }
+        break;
+    case AUDIO_EVENT_NOTE_OFF:
+        if (msg->channel == synth_arp_get_part()) {
+            synth_arp_note_off(msg->data1);
+        } else {
+            synth_engine_note_off(msg->channel, msg->data1);
+        }
+        break;
+    case AUDIO_EVENT_CONTROL_CHANGE:
+        prvControlChange(msg->channel, msg->data1, msg->data2);
+        break;
+    case AUDIO_EVENT_PROGRAM_CHANGE:
+        synth_engine_program_change(msg->channel, msg->data1);
+        break;
+    case AUDIO_EVENT_CHANNEL_PRESSURE:
+        synth_engine_channel_pressure(msg->channel, msg->data1);
+        break;
+    case AUDIO_EVENT_POLY_PRESSURE:
+        synth_engine_poly_pressure(msg->channel, msg->data1, msg->data2);
+        break;
+    case AUDIO_EVENT_CLOCK:
+        synth_arp_clock_tick(msg->value);
+        break;
+    case AUDIO_EVENT_START:
+        synth_arp_clock_start();
+        break;
+    case AUDIO_EVENT_CONTINUE:
+        synth_arp_clock_continue();
+        break;
+    case AUDIO_EVENT_STOP:
+        synth_arp_clock_stop();
+        break;
+    default:
+        break;
+    }
+}
+
+/* Runs the interpolator and software sine kernels over the same phases,
+ * increments and gain ramps, checks they agree bit for bit and logs the
+ * SysTick cycles per frame of each. The frame counts step through every
+ * remainder of the unrolled loops, the increments cover slow, fast and
+ * backwards-wrapping phases.
+ */
+static void prvCheckSineKernels(void) {
+    static const uint32_t increments[] = { 1u, 0x00123457u, 1u << 24, 0x7FFFFFFFu, 0x80000001u, 0xFFFFF001u };
+    static int32_t mix_interp[AUDIO_BUFFER_FRAMES];
+    static int32_t mix_sw[AUDIO_BUFFER_FRAMES];
+    uint32_t interp_cycles = 0;
+    uint32_t sw_cycles = 0;
+    uint32_t frames = 0;
+    uint32_t mismatches = 0;
+    char msg_buf[64];
+
+    for (size_t i = 0; i < sizeof(increments) / sizeof(increments[0]); i++) {
+        size_t n = AUDIO_BUFFER_FRAMES - i;
+        uint32_t phase = 0x89ABCDEFu * (uint32_t)(i + 1);
+        memset(mix_interp, 0, sizeof(mix_interp));
+        memset(mix_sw, 0, sizeof(mix_sw));
+
+        taskENTER_CRITICAL();
+        uint32_t start = systick_hw->cvr;
+        uint32_t end_interp = synth_osc_sine_accumulate_interp(mix_interp, n, phase, increments[i], 32767, -64);
+        interp_cycles += prvSysTickElapsed(start);
+        start = systick_hw->cvr;
+        uint32_t end_sw = synth_osc_sine_accumulate_sw(mix_sw, n, phase, increments[i], 32767, -64);
+        sw_cycles += prvSysTickElapsed(start);
+        taskEXIT_CRITICAL();
+
+        frames += (uint32_t)n;
+        for (size_t k = 0; k < n; k++) {
+            mismatches += (mix_interp[k] != mix_sw[k]);
+        }
+        mismatches += (end_interp != end_sw);
+    }
+
+    if (mismatches != 0) {
+        panic("Sine kernels differ at %lu of %lu frames", mismatches, frames);
+    }
+    snprintf(msg_buf, sizeof(msg_buf), "Sine kernel: interp %lu, software %lu cycles/frame",
+             interp_cycles / frames, sw_cycles / frames);
+    log_msg(msg_buf);
+}
+
+/* Times each FM algorithm's kernel over one block in SysTick cycles, with
+ * every operator at full level, and logs the best of a few runs per frame.
+ */
+static void prvLogFmCycles(void) {
+    static int32_t mix[AUDIO_BUFFER_FRAMES];
+    synth_fm_patch_t patch;
+    synth_fm_voice_t fm;
+    char msg_buf[48];
+
+    memset(&patch, 0, sizeof(patch));
+    patch.feedback = 128;
+    for (int k = 0; k < SYNTH_FM_OPS; k++) {
+        patch.op[k].ratio = (uint16_t)(256 * (k + 1));
+        patch.op[k].level = 32767;
+    }
+
+    for (uint8_t alg = 0; alg < SYNTH_FM_ALG_COUNT; alg++) {
+        patch.algorithm = alg;
+        synth_fm_note_on(&fm, &patch, false);
+        synth_fm_set_pitch(&fm, &patch, 1u << 24);
+        for (int k = 0; k < SYNTH_FM_OPS; k++) {
+            fm.level[k] = 32767;
+        }
+
+        uint32_t best = UINT32_MAX;
+        for (int run = 0; run < 3; run++) {
+            taskENTER_CRITICAL();
+            uint32_t start = systick_hw->cvr;
+            synth_fm_accumulate(mix, AUDIO_BUFFER_FRAMES, &fm, alg, 32767, 0);
+            uint32_t cycles = prvSysTickElapsed(start);
+            taskEXIT_CRITICAL();
+            if (cycles < best) best = cycles;
+        }
+        snprintf(msg_buf, sizeof(msg_buf), "FM algorithm %u, %u ops: %lu cycles/frame",
+                 alg, synth_fm_op_count(alg), best / AUDIO_BUFFER_FRAMES);
+        log_msg(msg_buf);
+    }
+}
+
+/* Logs the string pool's SRAM and the cost of one string in SysTick cycles
+ * per frame, timed on a spare slot before any note can claim it.
+ */
+static void prvLogStringCost(void) {
+    static const synth_string_patch_t patch = { 32700, 32700, 32767 };
+    static int32_t mix[AUDIO_BUFFER_FRAMES];
+    char msg_buf[64];
+
+    uint32_t best = UINT32_MAX;
+    int slot = synth_string_alloc();
+    if (slot >= 0) {
+        synth_string_pluck(slot, &patch, 1u << 24);
+        for (int run = 0; run < 3; run++) {
+            taskENTER_CRITICAL();
+            uint32_t start = systick_hw->cvr;
+            synth_string_accumulate(slot, mix, AUDIO_BUFFER_FRAMES, 32767, 0);
+            uint32_t cycles = prvSysTickElapsed(start);
+            taskEXIT_CRITICAL();
+            if (cycles < best) best = cycles;
+        }
+        synth_string_free(slot);
+    }
+    snprintf(msg_buf, sizeof(msg_buf), "Strings: %u lines, %lu bytes, %lu cycles/frame",
+             synth_string_slot_count(), (uint32_t)synth_string_pool_bytes(), best / AUDIO_BUFFER_FRAMES);
+    log_msg(msg_buf);
+}
+
+/* Times the unison kernel for each oscillator count in SysTick cycles per
+ * frame, the figures to budget polyphony against.
+ */
+static void prvLogUnisonCycles(void) {
+    static int32_t mid[AUDIO_BUFFER_FRAMES];
+    static int32_t side[AUDIO_BUFFER_FRAMES];
+    synth_unison_voice_t unison;
+    char msg_buf[48];
+
+    for (uint8_t count = 1; count <= SYNTH_UNISON_MAX; count++) {
+        synth_unison_patch_t patch = { count, 3300, 26000 };
+        synth_unison_note_on(&unison, &patch, false);
+
+        uint32_t best = UINT32_MAX;
+        for (int run = 0; run < 3; run++) {
+            taskENTER_CRITICAL();
+            uint32_t start = systick_hw->cvr;
+            synth_unison_accumulate(mid, side, AUDIO_BUFFER_FRAMES, &unison, 1u << 24, 32767, 0);
+            uint32_t cycles = prvSysTickElapsed(start);
+            taskEXIT_CRITICAL();
+            if (cycles < best) best = cycles;
+        }
+        snprintf(msg_buf, sizeof(msg_buf), "Unison %u: %lu cycles/frame", count, best / AUDIO_BUFFER_FRAMES);
+        log_msg(msg_buf);
+    }
 }
 
 void vAudioTask(void *pvParameters)
 {
+    xAudioTaskHandle = xTaskGetCurrentTaskHandle();
     log_msg("Audio Task Initialized");
 
-    i2s_program_start_synched(pio0, &i2s_config_default, dma_i2s_in_handler, &i2s);
+    // Claim the interpolators on the core this task is pinned to, and take
+    // the sample stream's DMA interrupt on it too
+    synth_osc_init();
+    sample_stream_init();
+
+    prvLogLatency();
+    prvLogStreamBandwidth();
+    prvCheckSineKernels();
+    prvLogFmCycles();
+    prvLogStringCost();
+    prvLogUnisonCycles();
+
+    clock_drift_init(ulSampleRate, AUDIO_BUFFER_FRAMES);
+    if (AUDIO_I2S_SLAVE) {
+        i2s_program_start_slaved(pio0, &i2s_config_default, dma_i2s_in_handler, &i2s);
+    } else {
+        i2s_program_start_synched(pio0, &i2s_config_default, dma_i2s_in_handler, &i2s);
+    }
+#if AUDIO_I2S_BUS2
+    i2s_add_follower(&i2s, AUDIO_I2S_BUS2_PIO, PIN_I2S_DOUT2, &i2s_bus2);
+#endif
 	for( ;; )
     {
-        QueueSetMemberHandle_t xHandle = xQueueSelectFromSet(xAudioQueueSet, portMAX_DELAY);
-
-        if (xHandle == xAudioISRSemaphore) {
-            
-            xSemaphoreTake(xAudioISRSemaphore, 0);
-
-            gpio_put(PIN_DEBUG_TIMING, 1);
-
-            /* We're double buffering using chained TCBs. By checking which buffer the
-            * DMA is currently reading from, we can identify which buffer it has just
-            * finished reading (the completion of which has triggered this interrupt).
-            */
-            if (*(int32_t**)dma_hw->ch[i2s.dma_ch_in_ctrl].read_addr == i2s.input_buffer) {
-                // It is inputting to the second buffer so we can overwrite the first
-                synth_engine_process(i2s.output_buffer, AUDIO_BUFFER_FRAMES);
-            } else {
-                // It is currently inputting the first buffer, so we write to the second
-                synth_engine_process(&i2s.output_buffer[STEREO_BUFFER_SIZE], AUDIO_BUFFER_FRAMES);
-            }
-            gpio_put(PIN_DEBUG_TIMING, 0);
+        uint32_t ulNotified;
+        if (xTaskNotifyWait(0, UINT32_MAX, &ulNotified,
+                            i2s.slaved ? pdMS_TO_TICKS(AUDIO_SLAVE_POLL_MS) : portMAX_DELAY) == pdFALSE) {
+            // No clock from the master, a control frame can still take it back
+            control_port_poll();
+            continue;
         }
-        else
-        if (xHandle == xAudioQueue) {
-            char msg_buf[64];
-            AudioMessage_t msg;
-            xQueueReceive(xAudioQueue, &msg, 0);
+        uint32_t ulWakeCycles = prvSysTickElapsed(ulDmaIrqSysTick);
 
-            snprintf(msg_buf, sizeof(msg_buf), "Note on: %d, Freq: %.2f Hz", msg.note_on, msg.frequency);
-            log_msg(msg_buf);
-            
-            synth_engine_set_frequency(msg.frequency);
-            if (msg.note_on) {
-                synth_engine_note_on();
-            } else {
-                synth_engine_note_off();
+        // Apply pending events first so they land in the block about to be rendered
+        AudioMessage_t msg;
+        while (xQueueReceive(xAudioQueue, &msg, 0) == pdTRUE) {
+            prvHandleMessage(&msg);
+        }
+
+        if (ulNotified & AUDIO_NOTIFY_BLOCK) {
+            TRACE_RECORD(TRACE_EV_AUDIO_WAKE, 0);
+
+            // Control frames are polled here, so a whole frame lands on one block
+            control_port_poll();
+
+            if (i2s.slaved) {
+                prvTrackClockDrift();
+            }
+
+            // The DMA played into a block that was never rendered, start again after it
+            uint32_t ulPlayed = ulBlocksPlayed;
+            if ((int32_t)(ulBlocksRendered - ulPlayed) <= 0) {
+                TRACE_RECORD(TRACE_EV_XRUN, 0);
+                trace_freeze();
+                ulBlocksRendered = ulPlayed + 1;
             }
+            uint32_t ulSlack = ulBlocksRendered - ulPlayed - 1;
+
+            // Fill every buffer the DMA is not playing
+            while ((int32_t)(ulBlocksRendered - (ulBlocksPlayed + AUDIO_BUFFER_COUNT)) < 0) {
+                uint32_t ulBlock = ulBlocksRendered;
+                int32_t* pBuffers[SYNTH_OUTPUT_BUSES];
+                prvBlockBuffers(ulBlock, pBuffers);
+                audio_tap_release(pBuffers[0]);
+
+                gpio_put(PIN_DEBUG_TIMING, 1);
+                TRACE_RECORD(TRACE_EV_RENDER_BEGIN, 0);
+                uint32_t ulRenderStart = time_us_32();
+                prvRenderBlock(pBuffers);
+                uint32_t ulRenderUs = time_us_32() - ulRenderStart;
+                gpio_put(PIN_DEBUG_TIMING, 0);
+                TRACE_RECORD(TRACE_EV_RENDER_END, 0);
+                audio_tap_send(pBuffers[0]);
+                ulBlocksRendered++;
+                prvGovernBlock(ulRenderUs);
+
+                // If the DMA reached the block while we rendered, part of it played stale
+                if ((int32_t)(ulBlock - ulBlocksPlayed) <= 0) {
+                    TRACE_RECORD(TRACE_EV_XRUN, 0);
+                    trace_freeze();
+                }
+            }
+
+            prvUpdateRenderStats(ulWakeCycles, ulSlack);
         }
     }
-}
\ No newline at end of file
+}
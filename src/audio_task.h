@@ -6,6 +6,20 @@
 
 void vAudioTask(void *pvParameters);
 void vAudioTaskInit(void);
-void vAudioTaskSetFrequency(uint8_t note_on, float frequency);
+typedef enum {
+    AUDIO_EVENT_NOTE_ON,            // data1 = note, data2 = velocity
+    AUDIO_EVENT_NOTE_OFF,           // data1 = note
+    AUDIO_EVENT_CONTROL_CHANGE,     // data1 = controller, data2 = value
+    AUDIO_EVENT_PROGRAM_CHANGE,     // data1 = program
+    AUDIO_EVENT_CHANNEL_PRESSURE,   // data1 = pressure
+    AUDIO_EVENT_POLY_PRESSURE,      // data1 = note, data2 = pressure
+    AUDIO_EVENT_CLOCK,              // value = filtered tick period in us, Q8
+    AUDIO_EVENT_START,
+    AUDIO_EVENT_CONTINUE,
+    AUDIO_EVENT_STOP,
+} AudioEventType_t;
+
+void vAudioTaskPostEvent(AudioEventType_t type, uint8_t channel, uint8_t data1, uint8_t data2);
+void vAudioTaskPostClock(AudioEventType_t type, uint32_t value);
 
 #endif // AUDIO_TASK_H
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "clock_drift.h"
+
+static uint32_t nominal_rate = 1;
+static uint32_t block_frames = 1;
+static uint32_t block_us = 1;       // Nominal block period
+static bool started = false;
+static uint32_t last_block = 0;
+static uint32_t last_us = 0;
+static uint32_t window_block = 0;   // First block edge of the window
+static uint32_t window_us = 0;
+static int32_t drift_ppm = 0;
+static bool locked = false;
+static uint32_t slips = 0;
+static uint32_t slips_reported = 0;
+
+void clock_drift_init(uint32_t rate, uint32_t frames) {
+    nominal_rate = rate ? rate : 1;
+    block_frames = frames;
+    block_us = (uint32_t)(((uint64_t)frames * 1000000u) / nominal_rate);
+    started = false;
+    drift_ppm = 0;
+    locked = false;
+    slips = 0;
+    slips_reported = 0;
+}
+
+static void start_window(uint32_t blocks, uint32_t edge_us) {
+    window_block = blocks;
+    window_us = edge_us;
+}
+
+bool clock_drift_update(uint32_t blocks, uint32_t edge_us, clock_drift_state_t* state) {
+    if (started && blocks == last_block) {
+        return false;
+    }
+    if (!started) {
+        started = true;
+        last_block = blocks;
+        last_us = edge_us;
+        start_window(blocks, edge_us);
+        return false;
+    }
+
+    // Several blocks may have ended since the last call, edge_us is the last one
+    uint32_t expected = (blocks - last_block) * block_us;
+    uint32_t period = edge_us - last_us;
+    uint32_t error = (period > expected) ? period - expected : expected - period;
+    last_block = blocks;
+    last_us = edge_us;
+    if (error > (expected * CLOCK_DRIFT_SLIP_PCT) / 100u) {
+        slips++;
+        locked = false;
+        start_window(blocks, edge_us);
+        return false;
+    }
+
+    uint32_t elapsed = edge_us - window_us;
+    if (elapsed < CLOCK_DRIFT_WINDOW_US) {
+        return false;
+    }
+
+    uint64_t frames = (uint64_t)(blocks - window_block) * block_frames;
+    uint32_t rate_mhz = (uint32_t)((frames * 1000000000u + elapsed / 2) / elapsed);
+    int32_t ppm = (int32_t)((((int64_t)rate_mhz - (int64_t)nominal_rate * 1000) * 1000) / (int64_t)nominal_rate);
+
+    // The first window after a slip stands alone, later ones are smoothed
+    if (locked) {
+        drift_ppm += (ppm - drift_ppm) / (1 << CLOCK_DRIFT_SMOOTH_SHIFT);
+    } else {
+        drift_ppm = ppm;
+        locked = true;
+    }
+    start_window(blocks, edge_us);
+
+    state->rate_mhz = rate_mhz;
+    state->drift_ppm = drift_ppm;
+    state->slips = slips;
+    return true;
+}
+
+uint32_t clock_drift_take_slips(void) {
+    uint32_t n = slips - slips_reported;
+    slips_reported = slips;
+    return n;
+}
@@ -0,0 +1,49 @@
+#ifndef CLOCK_DRIFT_H
+#define CLOCK_DRIFT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Frame rate tracking for an I2S bus clocked by an external master.
+ *
+ * Fed the time each DMA block ended, from the crystal-locked microsecond
+ * timer, it measures the frame rate over windows of CLOCK_DRIFT_WINDOW_US
+ * and smooths the drift from the nominal rate over successive windows.
+ * The output is rendered as the DMA asks for it, so an external clock
+ * never slips buffers: it plays the synth fast or slow by its drift, which
+ * the engine takes out of its increments.
+ *
+ * A block period more than CLOCK_DRIFT_SLIP_PCT off the nominal one, the
+ * master stopping, restarting or glitching, counts as a slip. It drops the
+ * lock and the window restarts from that block.
+ *
+ * Only the frame rate is tracked. With AUDIO_I2S_PACKED the bus also
+ * needs a 32 fs master, which the audio task checks with
+ * i2s_measure_bck_per_frame on each window: a master at 64 fs keeps the
+ * frame rate right while the packed words land on the wrong channels.
+ *
+ * Plain C, so it can be run on a host.
+ */
+
+#define CLOCK_DRIFT_WINDOW_US   4000000u
+#define CLOCK_DRIFT_SLIP_PCT    25
+#define CLOCK_DRIFT_SMOOTH_SHIFT 2      // Each window moves the estimate by 1/4 of its error
+
+typedef struct {
+    uint32_t rate_mhz;      // Frame rate of the last window in milli-Hz
+    int32_t  drift_ppm;     // Smoothed, positive when the master runs fast
+    uint32_t slips;         // Since clock_drift_init
+} clock_drift_state_t;
+
+void clock_drift_init(uint32_t nominal_rate, uint32_t block_frames);
+
+/* Feeds the count of blocks played so far and the time in microseconds
+ * the last of them ended. Returns true when a window completed, with the
+ * new estimate in state.
+ */
+bool clock_drift_update(uint32_t blocks, uint32_t edge_us, clock_drift_state_t* state);
+
+// Slips since the last call
+uint32_t clock_drift_take_slips(void);
+
+#endif /* CLOCK_DRIFT_H */
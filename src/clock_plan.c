@@ -0,0 +1,90 @@
+#include "clock_plan.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+#include "FreeRTOS.h"
+#endif
+
+#define PIO_DIV_Q8_MIN      (1u << 8)
+#define PIO_DIV_Q8_MAX      (65535u << 8)
+
+bool clock_plan_dividers(const clock_plan_request_t* req, uint32_t sys_hz, clock_plan_t* plan) {
+    uint64_t sck_pio_hz = (uint64_t)req->fs * req->sck_mult * req->sck_pio_mult;
+    uint64_t bck_pio_hz = (uint64_t)req->fs * req->bit_depth * 2u * req->bck_pio_mult;
+    if (sck_pio_hz == 0 || bck_pio_hz == 0 || sck_pio_hz % bck_pio_hz != 0) {
+        return false;   // BCK must be a whole number of SCK periods
+    }
+
+    // Round to the nearest 1/256, then derive BCK from the divider actually used
+    uint64_t sck_div = (((uint64_t)sys_hz << 8) + sck_pio_hz / 2) / sck_pio_hz;
+    uint64_t bck_div = sck_div * (sck_pio_hz / bck_pio_hz);
+    if (sck_div < PIO_DIV_Q8_MIN || bck_div > PIO_DIV_Q8_MAX) {
+        return false;
+    }
+
+    // fs = sys * 256 / (sck_div * sck_mult * sck_pio_mult), kept in milli-Hz
+    uint64_t denom = sck_div * req->sck_mult * req->sck_pio_mult;
+    uint64_t fs_mhz = (((uint64_t)sys_hz << 8) * 1000u + denom / 2) / denom;
+    int64_t error = (int64_t)fs_mhz - (int64_t)req->fs * 1000;
+
+    plan->sys_hz     = sys_hz;
+    plan->sck_div_q8 = (uint32_t)sck_div;
+    plan->bck_div_q8 = (uint32_t)bck_div;
+    plan->fs_mhz     = (uint32_t)fs_mhz;
+    plan->error_ppb  = (int32_t)((error * 1000000) / (int64_t)req->fs);
+    plan->jitter_ps  = ((sck_div | bck_div) & 0xFF) ? (uint32_t)(1000000000000ull / sys_hz) : 0;
+    return true;
+}
+
+static bool plan_is_better(const clock_plan_t* a, const clock_plan_t* b) {
+    uint32_t err_a = (uint32_t)((a->error_ppb < 0) ? -a->error_ppb : a->error_ppb);
+    uint32_t err_b = (uint32_t)((b->error_ppb < 0) ? -b->error_ppb : b->error_ppb);
+    if (err_a != err_b) return err_a < err_b;
+    if (a->jitter_ps != b->jitter_ps) return a->jitter_ps < b->jitter_ps;
+    if (a->sys_hz != b->sys_hz) return a->sys_hz > b->sys_hz;  // More CPU
+    return a->vco_hz < b->vco_hz;                               // Less PLL power
+}
+
+bool clock_plan_search(const clock_plan_request_t* req, clock_plan_t* plan) {
+    bool found = false;
+    clock_plan_t candidate;
+
+    for (uint32_t fbdiv = 16; fbdiv <= 320; fbdiv++) {
+        uint32_t vco = CLOCK_PLAN_XOSC_HZ * fbdiv;
+        if (vco < CLOCK_PLAN_VCO_MIN_HZ || vco > CLOCK_PLAN_VCO_MAX_HZ) continue;
+
+        for (uint32_t pd1 = 1; pd1 <= 7; pd1++) {
+            for (uint32_t pd2 = 1; pd2 <= pd1; pd2++) {
+                if (vco % (pd1 * pd2) != 0) continue;
+                uint32_t sys = vco / (pd1 * pd2);
+                if (sys < req->sys_min_hz || sys > req->sys_max_hz) continue;
+                if (!clock_plan_dividers(req, sys, &candidate)) continue;
+
+                candidate.vco_hz   = vco;
+                candidate.fbdiv    = (uint16_t)fbdiv;
+                candidate.postdiv1 = (uint8_t)pd1;
+                candidate.postdiv2 = (uint8_t)pd2;
+                if (!found || plan_is_better(&candidate, plan)) {
+                    *plan = candidate;
+                    found = true;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+#if PICO_ON_DEVICE
+void clock_plan_apply(const clock_plan_t* plan) {
+    set_sys_clock_pll(plan->vco_hz, plan->postdiv1, plan->postdiv2);
+
+    // set_sys_clock_pll runs clk_peri from clk_sys, the UARTs expect 48 MHz
+    clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB,
+                    48 * MHZ, 48 * MHZ);
+
+    // The RTOS tick counts processor clocks
+    systick_hw->rvr = (plan->sys_hz / configTICK_RATE_HZ) - 1;
+    systick_hw->cvr = 0;
+}
+#endif
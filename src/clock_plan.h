@@ -0,0 +1,66 @@
+#ifndef CLOCK_PLAN_H
+#define CLOCK_PLAN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico.h"
+
+/* System clock and PIO divider planning for the I2S output.
+ *
+ * The PIO clocks are clk_sys divided by a 16.8 fixed-point divider, so a
+ * sample rate is exact only when clk_sys * 256 is a multiple of the PIO
+ * clock, and jitter-free only when the divider has no fraction. The search
+ * walks every PLL setting (12 MHz crystal, VCO 750-1600 MHz, two post
+ * dividers) inside a system clock window and keeps the best plan: smallest
+ * sample rate error, then no fractional divider, then the lowest divider
+ * jitter, which is one clk_sys period when the divider is fractional.
+ *
+ * The search is plain C so it can be run on a host. Applying a plan is
+ * device only.
+ */
+
+#define CLOCK_PLAN_XOSC_HZ      12000000u
+#define CLOCK_PLAN_VCO_MIN_HZ   750000000u
+#define CLOCK_PLAN_VCO_MAX_HZ   1600000000u
+
+typedef struct {
+    uint32_t fs;            // Requested sample rate
+    uint32_t sck_mult;      // SCK = fs * sck_mult
+    uint8_t  bit_depth;     // BCK = fs * bit_depth * 2
+    uint8_t  sck_pio_mult;  // PIO clocks per SCK period
+    uint8_t  bck_pio_mult;  // PIO clocks per BCK period
+    uint32_t sys_min_hz;    // Window for clk_sys
+    uint32_t sys_max_hz;
+} clock_plan_request_t;
+
+typedef struct {
+    uint32_t sys_hz;
+    uint32_t vco_hz;
+    uint16_t fbdiv;
+    uint8_t  postdiv1;
+    uint8_t  postdiv2;
+    uint32_t sck_div_q8;    // PIO dividers, integer part << 8 | fraction
+    uint32_t bck_div_q8;
+    uint32_t fs_mhz;        // Attained sample rate in milli-Hz
+    int32_t  error_ppb;     // Attained against requested, parts per billion
+    uint32_t jitter_ps;     // Divider jitter, 0 when both dividers are integer
+} clock_plan_t;
+
+/* Computes the PIO dividers for one system clock. Returns false when the
+ * dividers are out of range or BCK is not a whole number of SCK periods.
+ */
+bool clock_plan_dividers(const clock_plan_request_t* req, uint32_t sys_hz, clock_plan_t* plan);
+
+// Returns false when no PLL setting in the window gives valid dividers
+bool clock_plan_search(const clock_plan_request_t* req, clock_plan_t* plan);
+
+#if PICO_ON_DEVICE
+/* Switches clk_sys to the plan's PLL setting. clk_peri is moved to the
+ * fixed 48 MHz USB PLL so the UART baud rates survive, and the calling
+ * core's SysTick is reloaded for the new clock, so call it from the core
+ * that drives the RTOS tick.
+ */
+void clock_plan_apply(const clock_plan_t* plan);
+#endif
+
+#endif /* CLOCK_PLAN_H */
@@ -0,0 +1,209 @@
+#include "control_port.h"
+#include "control_proto.h"
+#include "synth_engine.h"
+#include "synth_presets.h"
+#include "log_task.h"
+#include "app_config.h"
+#include "hardware/dma.h"
+#include "hardware/uart.h"
+#include <string.h>
+
+#define RX_RING_SIZE        (1u << CONTROL_RX_RING_BITS)
+
+// Bytes of the CONTROL_CMD_STATE reply
+#define STATE_PART_BYTES    9
+#define STATE_BYTES         (2 + SYNTH_MAX_PARTS * STATE_PART_BYTES)
+
+_Static_assert(CONTROL_FRAME_BYTES(STATE_BYTES) <= LOG_MAX_FRAME_LEN, "state reply too long for a log frame");
+
+static uint8_t __attribute__((aligned(RX_RING_SIZE))) rx_ring[RX_RING_SIZE];
+static uint32_t rx_read = 0;
+
+static int dma_ch_rx;
+static int dma_ch_reload;
+
+// The RX channel counts down from here, and is reloaded when it gets to 0
+static const uint32_t rx_reload_count = 0xFFFFFFFFu;
+
+static control_decoder_t decoder;
+static uint32_t errors_reported = 0;
+static control_port_cc_callback_t cc_callback = NULL;
+static control_port_device_callback_t device_callback = NULL;
+
+void control_port_init(control_port_cc_callback_t control_change, control_port_device_callback_t device_setting) {
+    cc_callback = control_change;
+    device_callback = device_setting;
+    control_decoder_init(&decoder);
+
+    dma_ch_rx = dma_claim_unused_channel(true);
+    dma_ch_reload = dma_claim_unused_channel(true);
+
+    // Bytes from the UART into the ring, wrapping on the write address
+    dma_channel_config c = dma_channel_get_default_config(dma_ch_rx);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_ring(&c, true, CONTROL_RX_RING_BITS);
+    channel_config_set_dreq(&c, uart_get_dreq(UART_ID_LOG, false));
+    channel_config_set_chain_to(&c, dma_ch_reload);
+    dma_channel_configure(dma_ch_rx, &c, rx_ring, &uart_get_hw(UART_ID_LOG)->dr, rx_reload_count, false);
+
+    // After 2^32 bytes, restarts the RX channel where it left off
+    c = dma_channel_get_default_config(dma_ch_reload);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, false);
+    dma_channel_configure(dma_ch_reload, &c, &dma_hw->ch[dma_ch_rx].al1_transfer_count_trig,
+                          &rx_reload_count, 1, false);
+
+    dma_channel_start(dma_ch_rx);
+}
+
+static void reply(uint8_t seq, uint8_t cmd, const uint8_t* payload, uint16_t len) {
+    static uint8_t frame[LOG_MAX_FRAME_LEN];    // Only the audio task polls
+    if ((size_t)CONTROL_FRAME_BYTES(len) > sizeof(frame)) return;
+    size_t n = control_encode(frame, seq, (uint8_t)(cmd | CONTROL_REPLY), payload, len);
+    log_write_frame(frame, n);
+}
+
+static void reply_status(uint8_t seq, uint8_t cmd, control_status_t status, uint16_t index) {
+    uint8_t payload[3] = { (uint8_t)status, (uint8_t)index, (uint8_t)(index >> 8) };
+    reply(seq, cmd, payload, sizeof(payload));
+}
+
+static control_status_t check_record(const uint8_t* r) {
+    uint8_t part = r[0];
+    uint8_t param = r[1];
+    uint16_t value = (uint16_t)(r[2] | (r[3] << 8));
+
+    if (param & CONTROL_PARAM_CC) {
+        if (part >= SYNTH_MAX_PARTS) return CONTROL_ERR_PART;
+        return (value <= 127) ? CONTROL_OK : CONTROL_ERR_VALUE;
+    }
+    if (param >= CONTROL_PARAM_DEVICE) {
+        switch (param) {
+        case CONTROL_PARAM_SAMPLE_RATE: return (value == 441 || value == 480 || value == 960) ? CONTROL_OK : CONTROL_ERR_VALUE;
+        case CONTROL_PARAM_CLOCK_SLAVE: return (value <= 1) ? CONTROL_OK : CONTROL_ERR_VALUE;
+        case CONTROL_PARAM_AUDIO_TAP:   return (value <= 1) ? CONTROL_OK : CONTROL_ERR_VALUE;
+        default:                        return CONTROL_ERR_PARAM;
+        }
+    }
+
+    if (part >= SYNTH_MAX_PARTS) return CONTROL_ERR_PART;
+    switch (param) {
+    case CONTROL_PARAM_PRESET:      return (value < synth_preset_count) ? CONTROL_OK : CONTROL_ERR_VALUE;
+    case CONTROL_PARAM_VOICE_LIMIT: return (value <= SYNTH_MAX_VOICES) ? CONTROL_OK : CONTROL_ERR_VALUE;
+    case CONTROL_PARAM_PRIORITY:    return (value <= UINT8_MAX) ? CONTROL_OK : CONTROL_ERR_VALUE;
+    case CONTROL_PARAM_PAN:         return (value <= 127) ? CONTROL_OK : CONTROL_ERR_VALUE;
+    case CONTROL_PARAM_GAIN:        return (value <= 32768) ? CONTROL_OK : CONTROL_ERR_VALUE;
+    case CONTROL_PARAM_OUTPUT:      return (value < SYNTH_OUTPUT_BUSES) ? CONTROL_OK : CONTROL_ERR_VALUE;
+    default:                        return CONTROL_ERR_PARAM;
+    }
+}
+
+/* Checks every record before applying any, so a frame either lands whole
+ * or not at all. Part settings are gathered and written once per part.
+ */
+static void cmd_set(const control_frame_t* f) {
+    if (f->length % CONTROL_SET_RECORD != 0) {
+        reply_status(f->seq, f->cmd, CONTROL_ERR_LENGTH, 0);
+        return;
+    }
+    uint16_t count = f->length / CONTROL_SET_RECORD;
+    for (uint16_t i = 0; i < count; i++) {
+        control_status_t status = check_record(&f->payload[i * CONTROL_SET_RECORD]);
+        if (status != CONTROL_OK) {
+            reply_status(f->seq, f->cmd, status, i);
+            return;
+        }
+    }
+
+    synth_part_config_t config[SYNTH_MAX_PARTS];
+    uint16_t touched = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        const uint8_t* r = &f->payload[i * CONTROL_SET_RECORD];
+        uint8_t part = r[0];
+        uint8_t param = r[1];
+        uint16_t value = (uint16_t)(r[2] | (r[3] << 8));
+
+        if (param & CONTROL_PARAM_CC) {
+            if (cc_callback) cc_callback(part, param & 0x7F, (uint8_t)value);
+            continue;
+        }
+        if (param >= CONTROL_PARAM_DEVICE) {
+            if (device_callback) device_callback((control_param_t)param, value);
+            continue;
+        }
+        if (!(touched & (1u << part))) {
+            synth_engine_get_part_config(part, &config[part]);
+            touched |= (uint16_t)(1u << part);
+        }
+        switch (param) {
+        case CONTROL_PARAM_PRESET:      config[part].preset = (uint8_t)value; break;
+        case CONTROL_PARAM_VOICE_LIMIT: config[part].voice_limit = (uint8_t)value; break;
+        case CONTROL_PARAM_PRIORITY:    config[part].priority = (uint8_t)value; break;
+        case CONTROL_PARAM_PAN:         config[part].pan = (uint8_t)value; break;
+        case CONTROL_PARAM_OUTPUT:      config[part].output = (uint8_t)value; break;
+        default:                        config[part].gain = value; break;
+        }
+    }
+    for (uint8_t part = 0; part < SYNTH_MAX_PARTS; part++) {
+        if (touched & (1u << part)) synth_engine_set_part_config(part, &config[part]);
+    }
+    reply_status(f->seq, f->cmd, CONTROL_OK, count);
+}
+
+static void cmd_state(const control_frame_t* f) {
+    uint8_t payload[STATE_BYTES];
+    payload[0] = CONTROL_OK;
+    payload[1] = synth_engine_get_active_voices();
+    for (uint8_t part = 0; part < SYNTH_MAX_PARTS; part++) {
+        synth_part_config_t config;
+        synth_engine_get_part_config(part, &config);
+        uint8_t* p = &payload[2 + part * STATE_PART_BYTES];
+        p[0] = config.preset;
+        p[1] = config.voice_limit;
+        p[2] = config.priority;
+        p[3] = config.pan;
+        memcpy(&p[4], &config.gain, 4);     // Little-endian, as on the wire
+        p[8] = config.output;
+    }
+    reply(f->seq, f->cmd, payload, sizeof(payload));
+}
+
+static void execute(const control_frame_t* f) {
+    switch (f->cmd) {
+    case CONTROL_CMD_HELLO: {
+        uint8_t payload[5] = { CONTROL_OK, CONTROL_PROTO_VERSION, SYNTH_MAX_PARTS, synth_preset_count, SYNTH_MAX_VOICES };
+        reply(f->seq, f->cmd, payload, sizeof(payload));
+        break;
+    }
+    case CONTROL_CMD_SET:
+        cmd_set(f);
+        break;
+    case CONTROL_CMD_STATE:
+        cmd_state(f);
+        break;
+    default:
+        reply_status(f->seq, f->cmd, CONTROL_ERR_CMD, 0);
+        break;
+    }
+}
+
+void control_port_poll(void) {
+    // The write address is the next byte the DMA fills
+    uint32_t write = ((uint32_t)dma_hw->ch[dma_ch_rx].write_addr - (uint32_t)rx_ring) & (RX_RING_SIZE - 1);
+    while (rx_read != write) {
+        if (control_decoder_feed(&decoder, rx_ring[rx_read])) {
+            execute(&decoder.frame);
+        }
+        rx_read = (rx_read + 1) & (RX_RING_SIZE - 1);
+    }
+}
+
+uint32_t control_port_take_errors(void) {
+    uint32_t total = decoder.crc_errors + decoder.length_errors;
+    uint32_t n = total - errors_reported;
+    errors_reported = total;
+    return n;
+}
@@ -0,0 +1,34 @@
+#ifndef CONTROL_PORT_H
+#define CONTROL_PORT_H
+
+#include <stdint.h>
+#include "control_proto.h"
+
+/* Binary control channel on the log UART's RX pin, framed as described in
+ * control_proto.h.
+ *
+ * DMA copies every received byte into a ring with no interrupt. The audio
+ * task drains it with control_port_poll on the wakes it already has, so a
+ * frame is applied between two blocks: all the parameters of one frame
+ * take effect on the same block, and the audio task is never woken for
+ * it. A slave whose master has stopped polls on a timeout instead, so a
+ * frame can still hand the clocks back. Replies go out through the log
+ * task.
+ */
+
+// Controllers of a CONTROL_CMD_SET frame, routed like MIDI CCs
+typedef void (*control_port_cc_callback_t)(uint8_t part, uint8_t controller, uint8_t value);
+
+// Device parameters of a CONTROL_CMD_SET frame, with checked values
+typedef void (*control_port_device_callback_t)(control_param_t param, uint16_t value);
+
+// The log UART must be initialised first
+void control_port_init(control_port_cc_callback_t control_change, control_port_device_callback_t device_setting);
+
+// Decodes the bytes received since the last call and executes the frames
+void control_port_poll(void);
+
+// Frames dropped for a bad CRC or length since the last call
+uint32_t control_port_take_errors(void);
+
+#endif /* CONTROL_PORT_H */
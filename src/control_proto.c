@@ -0,0 +1,83 @@
+#include "control_proto.h"
+#include <string.h>
+
+uint16_t control_crc16(uint16_t crc, const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/* pos counts the bytes after the sync byte: 0-1 length, 2 seq, 3 cmd, then
+ * the payload and the two CRC bytes.
+ */
+#define HUNTING     0xFFFF  // Waiting for a sync byte
+
+void control_decoder_init(control_decoder_t* d) {
+    d->pos = HUNTING;
+    d->crc_errors = 0;
+    d->length_errors = 0;
+}
+
+bool control_decoder_feed(control_decoder_t* d, uint8_t byte) {
+    control_frame_t* f = &d->frame;
+    uint16_t pos = d->pos;
+
+    if (pos == HUNTING) {
+        if (byte == CONTROL_SYNC) {
+            d->pos = 0;
+            d->crc = 0xFFFF;
+        }
+        return false;
+    }
+
+    d->pos++;
+    if (pos < 4 || pos < 4 + f->length) {
+        d->crc = control_crc16(d->crc, &byte, 1);
+        if (pos == 0) {
+            f->length = byte;
+        } else if (pos == 1) {
+            f->length |= (uint16_t)byte << 8;
+            if (f->length > CONTROL_MAX_PAYLOAD) {
+                // A corrupt length, hunt for the next frame from here
+                d->length_errors++;
+                d->pos = HUNTING;
+            }
+        } else if (pos == 2) {
+            f->seq = byte;
+        } else if (pos == 3) {
+            f->cmd = byte;
+        } else {
+            f->payload[pos - 4] = byte;
+        }
+        return false;
+    }
+
+    // The CRC, low byte first
+    if (pos == 4 + f->length) {
+        d->crc_low = byte;
+        return false;
+    }
+    d->pos = HUNTING;
+    if (d->crc != (uint16_t)(d->crc_low | (byte << 8))) {
+        d->crc_errors++;
+        return false;
+    }
+    return true;
+}
+
+size_t control_encode(uint8_t* out, uint8_t seq, uint8_t cmd, const uint8_t* payload, uint16_t len) {
+    out[0] = CONTROL_SYNC;
+    out[1] = (uint8_t)len;
+    out[2] = (uint8_t)(len >> 8);
+    out[3] = seq;
+    out[4] = cmd;
+    memcpy(&out[CONTROL_HEADER_BYTES], payload, len);
+    uint16_t crc = control_crc16(0xFFFF, &out[1], CONTROL_HEADER_BYTES - 1 + len);
+    out[CONTROL_HEADER_BYTES + len]     = (uint8_t)crc;
+    out[CONTROL_HEADER_BYTES + len + 1] = (uint8_t)(crc >> 8);
+    return CONTROL_FRAME_BYTES(len);
+}
@@ -0,0 +1,103 @@
+#ifndef CONTROL_PROTO_H
+#define CONTROL_PROTO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Framing of the binary control protocol on the log UART.
+ *
+ * A frame is
+ *
+ *   0xA5 | length (2) | seq | cmd | payload (length) | crc (2)
+ *
+ * with multi-byte fields little-endian and the CRC-16/CCITT-FALSE of
+ * everything between the sync byte and the CRC. Replies use the same
+ * framing with the command's top bit set and the request's seq, so a
+ * host can match them up. The sync byte is not ASCII, so a host reading
+ * the log can pick replies out of the text.
+ */
+
+#define CONTROL_SYNC            0xA5
+#define CONTROL_HEADER_BYTES    5       // Sync, length, seq, cmd
+#define CONTROL_FRAME_BYTES(n)  (CONTROL_HEADER_BYTES + (n) + 2)
+#define CONTROL_MAX_PAYLOAD     512
+#define CONTROL_REPLY           0x80    // Set in the cmd of a reply
+
+/* Every reply payload starts with a control_status_t.
+ *
+ * HELLO  reply: version, parts, presets, voices
+ * SET    payload: records of part, control_param_t, value (2)
+ *        reply: the index (2) of the first bad record, or the count applied
+ *        Device parameters, from CONTROL_PARAM_DEVICE, ignore the part.
+ * STATE  reply: active voices, then per part preset, voice limit,
+ *        priority, pan, gain (4), output
+ */
+typedef enum {
+    CONTROL_CMD_HELLO = 0x00,
+    CONTROL_CMD_SET   = 0x01,
+    CONTROL_CMD_STATE = 0x02,
+} control_cmd_t;
+
+// Parameters of a CONTROL_CMD_SET record
+typedef enum {
+    CONTROL_PARAM_PRESET      = 0x00,
+    CONTROL_PARAM_VOICE_LIMIT = 0x01,
+    CONTROL_PARAM_PRIORITY    = 0x02,
+    CONTROL_PARAM_PAN         = 0x03,
+    CONTROL_PARAM_GAIN        = 0x04,   // Q15, 32768 is unity
+    CONTROL_PARAM_OUTPUT      = 0x05,   // Output bus, below SYNTH_OUTPUT_BUSES
+    CONTROL_PARAM_SAMPLE_RATE = 0x40,   // Output rate / 100: 441, 480 or 960
+    CONTROL_PARAM_CLOCK_SLAVE = 0x41,   // 1 follows an external I2S master, 0 drives the clocks
+    CONTROL_PARAM_AUDIO_TAP   = 0x42,   // 1 streams the output on PIN_AUDIO_TAP
+    CONTROL_PARAM_CC          = 0x80,   // | controller, value 0-127
+} control_param_t;
+
+// Parameters from here below CONTROL_PARAM_CC set the device, not a part
+#define CONTROL_PARAM_DEVICE    CONTROL_PARAM_SAMPLE_RATE
+
+// First payload byte of every reply
+typedef enum {
+    CONTROL_OK = 0,
+    CONTROL_ERR_LENGTH,
+    CONTROL_ERR_PART,
+    CONTROL_ERR_PARAM,
+    CONTROL_ERR_VALUE,
+    CONTROL_ERR_CMD,
+} control_status_t;
+
+#define CONTROL_PROTO_VERSION   1
+#define CONTROL_SET_RECORD      4
+
+typedef struct {
+    uint8_t  seq;
+    uint8_t  cmd;
+    uint16_t length;
+    uint8_t  payload[CONTROL_MAX_PAYLOAD];
+} control_frame_t;
+
+typedef struct {
+    control_frame_t frame;
+    uint16_t pos;           // Bytes of the current frame seen after the sync byte
+    uint16_t crc;           // Of the bytes so far
+    uint8_t  crc_low;       // First byte of the received CRC
+    uint32_t crc_errors;
+    uint32_t length_errors;
+} control_decoder_t;
+
+uint16_t control_crc16(uint16_t crc, const uint8_t* data, size_t len);
+
+void control_decoder_init(control_decoder_t* d);
+
+/* Feeds one received byte. Returns true when it completes a frame with a
+ * good CRC, which stays in d->frame until the next byte. Bytes outside a
+ * frame are skipped until the next sync byte.
+ */
+bool control_decoder_feed(control_decoder_t* d, uint8_t byte);
+
+/* Frames a payload into out, which must hold CONTROL_FRAME_BYTES(len).
+ * Returns the frame length.
+ */
+size_t control_encode(uint8_t* out, uint8_t seq, uint8_t cmd, const uint8_t* payload, uint16_t len);
+
+#endif /* CONTROL_PROTO_H */
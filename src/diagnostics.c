@@ -0,0 +1,77 @@
+#include "diagnostics.h"
+#include "log_task.h"
+#include <stdio.h>
+
+extern uint32_t ulGetRunTimeCounterValue(void);
+
+typedef struct {
+    TaskHandle_t handle;
+    configSTACK_DEPTH_TYPE stack_words;
+    uint32_t last_runtime;
+} diag_task_t;
+
+typedef struct {
+    QueueHandle_t handle;
+    const char* name;
+} diag_queue_t;
+
+static diag_task_t tasks[DIAG_MAX_TASKS];
+static size_t task_count = 0;
+static diag_queue_t queues[DIAG_MAX_QUEUES];
+static size_t queue_count = 0;
+static uint32_t last_report_time = 0;
+
+void diag_register_task(TaskHandle_t task, configSTACK_DEPTH_TYPE stack_words) {
+    if (task == NULL || task_count >= DIAG_MAX_TASKS) return;
+    tasks[task_count].handle = task;
+    tasks[task_count].stack_words = stack_words;
+    tasks[task_count].last_runtime = 0;
+    task_count++;
+}
+
+void diag_register_queue(QueueHandle_t queue, const char* name) {
+    if (queue == NULL || queue_count >= DIAG_MAX_QUEUES) return;
+    queues[queue_count].handle = queue;
+    queues[queue_count].name = name;
+    queue_count++;
+
+    // Also makes the queue visible by name in a kernel-aware debugger
+    vQueueAddToRegistry(queue, name);
+}
+
+void diag_report(void) {
+    char msg_buf[64];
+    uint32_t now = ulGetRunTimeCounterValue();
+    uint32_t elapsed = now - last_report_time;
+    last_report_time = now;
+
+    for (size_t i = 0; i < task_count; i++) {
+        TaskStatus_t status;
+
+        // Only this task's TCB is read, the scheduler keeps running
+        vTaskGetInfo(tasks[i].handle, &status, pdTRUE, eInvalid);
+
+        uint32_t runtime = status.ulRunTimeCounter - tasks[i].last_runtime;
+        tasks[i].last_runtime = status.ulRunTimeCounter;
+
+        // CPU share of one core in tenths of a percent
+        uint32_t share = elapsed ? (uint32_t)(((uint64_t)runtime * 1000u) / elapsed) : 0;
+        snprintf(msg_buf, sizeof(msg_buf), "%-6s cpu %2lu.%lu%% stack %lu/%lu words used",
+                 status.pcTaskName, share / 10, share % 10,
+                 (uint32_t)(tasks[i].stack_words - status.usStackHighWaterMark),
+                 (uint32_t)tasks[i].stack_words);
+        log_msg(msg_buf);
+    }
+
+    snprintf(msg_buf, sizeof(msg_buf), "Heap free %u, min ever %u bytes",
+             (unsigned)xPortGetFreeHeapSize(), (unsigned)xPortGetMinimumEverFreeHeapSize());
+    log_msg(msg_buf);
+
+    for (size_t i = 0; i < queue_count; i++) {
+        UBaseType_t waiting = uxQueueMessagesWaiting(queues[i].handle);
+        UBaseType_t space = uxQueueSpacesAvailable(queues[i].handle);
+        snprintf(msg_buf, sizeof(msg_buf), "Queue %s %u/%u",
+                 queues[i].name, (unsigned)waiting, (unsigned)(waiting + space));
+        log_msg(msg_buf);
+    }
+}
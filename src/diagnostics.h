@@ -0,0 +1,27 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+/* Run-time diagnostics report.
+ *
+ * Tasks and queues register themselves once at start up. diag_report()
+ * then logs each task's CPU share since the previous report, its stack
+ * high-water mark against the configured size, the heap_4 low-water mark
+ * and the depth of every registered queue.
+ *
+ * The report is built from vTaskGetInfo() on one task at a time rather
+ * than uxTaskGetSystemState(), which keeps the scheduler suspended while
+ * it walks every task list and would delay the audio task.
+ */
+
+#define DIAG_MAX_TASKS      8
+#define DIAG_MAX_QUEUES     8
+
+void diag_register_task(TaskHandle_t task, configSTACK_DEPTH_TYPE stack_words);
+void diag_register_queue(QueueHandle_t queue, const char* name);
+void diag_report(void);
+
+#endif /* DIAGNOSTICS_H */
@@ -21,12 +21,26 @@
  */
 
 #include "i2s.h"
-#include <math.h>
 #include "hardware/clocks.h"
 #include "hardware/dma.h"
 #include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/structs/sio.h"
 #include "i2s.pio.h"
 
+// The programs moving the AUDIO_I2S_PACKED buffer layout
+#if AUDIO_I2S_PACKED
+#define I2S_OUT_PROGRAM     i2s_out_master_packed_program
+#define I2S_IN_PROGRAM      i2s_in_slave_packed_program
+#define I2S_BIDI_PROGRAM    i2s_bidi_slave_packed_program
+#define I2S_FOLLOW_PROGRAM  i2s_out_follower_packed_program
+#else
+#define I2S_OUT_PROGRAM     i2s_out_master_program
+#define I2S_IN_PROGRAM      i2s_in_slave_program
+#define I2S_BIDI_PROGRAM    i2s_bidi_slave_program
+#define I2S_FOLLOW_PROGRAM  i2s_out_follower_program
+#endif
+
 const i2s_config i2s_config_default = {
     AUDIO_SAMPLE_RATE, 
     256, 
@@ -38,66 +52,80 @@ const i2s_config i2s_config_default = {
     false
 };
 
-static float pio_div(float freq, uint16_t* div, uint8_t* frac) {
-    float clk   = (float)clock_get_hz(clk_sys);
-    float ratio = clk / freq;
-    float d;
-    float f = modff(ratio, &d);
-    *div    = (uint16_t)d;
-    *frac   = (uint8_t)(f * 256.0f);
+void i2s_get_clock_request(const i2s_config* config, uint32_t fs, clock_plan_request_t* req) {
+    req->fs           = fs;
+    req->sck_mult     = config->sck_mult;
+    req->bit_depth    = config->bit_depth;
+    req->sck_pio_mult = (uint8_t)i2s_sck_program_pio_mult;
+    req->bck_pio_mult = (uint8_t)i2s_out_master_program_pio_mult;
+    req->sys_min_hz   = SYS_CLOCK_MIN_KHZ * 1000u;
+    req->sys_max_hz   = SYS_CLOCK_MAX_KHZ * 1000u;
+}
 
-    // Use post-converted values to get actual freq after any rounding
-    float result = clk / ((float)*div + ((float)*frac / 256.0f));
+static bool calc_clocks(const i2s_config* config, pio_i2s_clocks* clocks) {
+    // Dividers for the system clock we actually run at, BCK an exact multiple of SCK
+    clock_plan_request_t req;
+    clock_plan_t plan;
+    i2s_get_clock_request(config, config->fs, &req);
+    if (!clock_plan_dividers(&req, clock_get_hz(clk_sys), &plan)) {
+        return false;
+    }
 
-    return result;
+    clocks->sck_d       = (uint16_t)(plan.sck_div_q8 >> 8);
+    clocks->sck_f       = (uint8_t)(plan.sck_div_q8 & 0xFF);
+    clocks->bck_d       = (uint16_t)(plan.bck_div_q8 >> 8);
+    clocks->bck_f       = (uint8_t)(plan.bck_div_q8 & 0xFF);
+    clocks->fs_attained = (float)plan.fs_mhz / 1000.0f;
+    clocks->sck_pio_hz  = (float)plan.sys_hz * 256.0f / (float)plan.sck_div_q8;
+    clocks->bck_pio_hz  = (float)plan.sys_hz * 256.0f / (float)plan.bck_div_q8;
+    return true;
 }
 
-static void calc_clocks(const i2s_config* config, pio_i2s_clocks* clocks) {
-    // Try to get a precise ratio between SCK and BCK regardless of how
-    // perfect the system_clock divides. First, see what sck we can actually get:
-    float sck_desired   = (float)config->fs * (float)config->sck_mult * (float)i2s_sck_program_pio_mult;
-    float sck_attained  = pio_div(sck_desired, &clocks->sck_d, &clocks->sck_f);
-    clocks->fs_attained = sck_attained / (float)config->sck_mult / (float)i2s_sck_program_pio_mult;
-
-    // Now that we have the closest fs our dividers will give us, we can
-    // re-calculate SCK and BCK as correct ratios of this adjusted fs:
-    float sck_hz       = clocks->fs_attained * (float)config->sck_mult;
-    clocks->sck_pio_hz = pio_div(sck_hz * (float)i2s_sck_program_pio_mult, &clocks->sck_d, &clocks->sck_f);
-    float bck_hz       = clocks->fs_attained * (float)config->bit_depth * 2.0f;
-    clocks->bck_pio_hz = pio_div(bck_hz * (float)i2s_out_master_program_pio_mult, &clocks->bck_d, &clocks->bck_f);
+/* Runs on every rate change, from the audio task, so it only compares the
+ * dividers. The audio task logs the rate the plan attains.
+ */
+static bool validate_sck_bck_sync(const pio_i2s_clocks* clocks) {
+    uint32_t sck_div_q8 = ((uint32_t)clocks->sck_d << 8) | clocks->sck_f;
+    uint32_t bck_div_q8 = ((uint32_t)clocks->bck_d << 8) | clocks->bck_f;
+    // Compare the dividers, the float rates may not divide exactly
+    return (bck_div_q8 % sck_div_q8) == 0;
 }
 
-static bool validate_sck_bck_sync(pio_i2s_clocks* clocks) {
-    float ratio      = clocks->sck_pio_hz / clocks->bck_pio_hz;
-    float actual_sck = clocks->sck_pio_hz / (float)i2s_sck_program_pio_mult;
-    float actual_bck = clocks->bck_pio_hz / (float)i2s_out_master_program_pio_mult;
-    printf("Clock speed for SCK: %f (PIO %f Hz with divider %d.%d)\n", actual_sck, clocks->sck_pio_hz, clocks->sck_d, clocks->sck_f);
-    printf("Clock speed for BCK: %f (PIO %f Hz with divider %d.%d)\n", actual_bck, clocks->bck_pio_hz, clocks->bck_d, clocks->bck_f);
-    printf("Clock Ratio: %f\n", ratio);
-    float whole_ratio;
-    float fractional_ratio = modff(ratio, &whole_ratio);
-    return (fractional_ratio == 0.0f);
+static void dma_ring_start(pio_i2s* i2s) {
+    dma_channel_set_read_addr(i2s->dma_ch_out_ctrl, i2s->out_ctrl_blocks, false);
+    dma_channel_set_read_addr(i2s->dma_ch_in_ctrl, i2s->in_ctrl_blocks, false);
+    dma_channel_start(i2s->dma_ch_out_ctrl);  // This will trigger-start the out chan
+    dma_channel_start(i2s->dma_ch_in_ctrl);   // This will trigger-start the in chan
+
+    pio_i2s_follower* f = i2s->follower;
+    if (f != NULL) {
+        dma_channel_set_read_addr(f->dma_ch_ctrl, f->ctrl_blocks, false);
+        dma_channel_start(f->dma_ch_ctrl);
+    }
 }
 
-static void dma_double_buffer_init(pio_i2s* i2s, void (*dma_handler)(void)) {
-    // Set up DMA for PIO I2s - two channels, in and out
-    i2s->dma_ch_in_ctrl  = dma_claim_unused_channel(true);
-    i2s->dma_ch_out_ctrl = dma_claim_unused_channel(true);
-    i2s->dma_ch_out_data = dma_claim_unused_channel(true);
-    i2s->dma_ch_in_data  = dma_claim_unused_channel(true);
+static void i2s_enable(pio_i2s* i2s) {
+    // The follower waits for the clocks, so it takes the same first frame
+    if (i2s->follower != NULL) {
+        pio_sm_set_enabled(i2s->follower->pio, i2s->follower->sm, true);
+    }
+    pio_enable_sm_mask_in_sync(i2s->pio, i2s->sm_mask);
+}
 
-    // Control blocks support double-buffering with interrupts on buffer change
-    i2s->in_ctrl_blocks[0]  = i2s->input_buffer;
-    i2s->in_ctrl_blocks[1]  = &i2s->input_buffer[STEREO_BUFFER_SIZE];
-    i2s->out_ctrl_blocks[0] = i2s->output_buffer;
-    i2s->out_ctrl_blocks[1] = &i2s->output_buffer[STEREO_BUFFER_SIZE];
+// Points the data channels at the FIFOs of the current state machines
+static void dma_ring_configure(pio_i2s* i2s) {
+    // Control blocks cycle through the buffer ring with interrupts on buffer change
+    for (int i = 0; i < I2S_BUFFER_COUNT; i++) {
+        i2s->in_ctrl_blocks[i]  = &i2s->input_buffer[i * STEREO_BUFFER_SIZE];
+        i2s->out_ctrl_blocks[i] = &i2s->output_buffer[i * STEREO_BUFFER_SIZE];
+    }
 
-    // DMA I2S OUT control channel - wrap read address every 8 bytes (2 words)
+    // DMA I2S OUT control channel - wrap read address around the ring of control blocks
     // Transfer 1 word at a time, to the out channel read address and trigger.
     dma_channel_config c = dma_channel_get_default_config(i2s->dma_ch_out_ctrl);
     channel_config_set_read_increment(&c, true);
     channel_config_set_write_increment(&c, false);
-    channel_config_set_ring(&c, false, 3);
+    channel_config_set_ring(&c, false, I2S_CTRL_RING_BITS);
     channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
     dma_channel_configure(i2s->dma_ch_out_ctrl, &c, &dma_hw->ch[i2s->dma_ch_out_data].al3_read_addr_trig, i2s->out_ctrl_blocks, 1, false);
 
@@ -118,7 +146,7 @@ static void dma_double_buffer_init(pio_i2s* i2s, void (*dma_handler)(void)) {
     c = dma_channel_get_default_config(i2s->dma_ch_in_ctrl);
     channel_config_set_read_increment(&c, true);
     channel_config_set_write_increment(&c, false);
-    channel_config_set_ring(&c, false, 3);
+    channel_config_set_ring(&c, false, I2S_CTRL_RING_BITS);
     channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
     dma_channel_configure(i2s->dma_ch_in_ctrl, &c, &dma_hw->ch[i2s->dma_ch_in_data].al2_write_addr_trig, i2s->in_ctrl_blocks, 1, false);
 
@@ -135,6 +163,15 @@ static void dma_double_buffer_init(pio_i2s* i2s, void (*dma_handler)(void)) {
                           STEREO_BUFFER_SIZE,           // Number of transfers
                           false                         // Don't start yet
     );
+}
+
+static void dma_double_buffer_init(pio_i2s* i2s, void (*dma_handler)(void)) {
+    // Set up DMA for PIO I2s - two channels, in and out
+    i2s->dma_ch_in_ctrl  = dma_claim_unused_channel(true);
+    i2s->dma_ch_out_ctrl = dma_claim_unused_channel(true);
+    i2s->dma_ch_out_data = dma_claim_unused_channel(true);
+    i2s->dma_ch_in_data  = dma_claim_unused_channel(true);
+    dma_ring_configure(i2s);
 
     // Input channel triggers the DMA interrupt handler, hopefully these stay
     // in perfect sync with the output.
@@ -143,8 +180,7 @@ static void dma_double_buffer_init(pio_i2s* i2s, void (*dma_handler)(void)) {
     irq_set_enabled(DMA_IRQ_0, true);
 
     // Enable all the dma channels
-    dma_channel_start(i2s->dma_ch_out_ctrl);  // This will trigger-start the out chan
-    dma_channel_start(i2s->dma_ch_in_ctrl);   // This will trigger-start the in chan
+    dma_ring_start(i2s);
 }
 
 /* Initializes an I2S block (of 3 state machines) on the designated PIO.
@@ -156,14 +192,19 @@ static void i2s_slave_program_init(PIO pio, const i2s_config* config, pio_i2s* i
     i2s->pio     = pio;
     i2s->sm_mask = 0;
 
+    i2s->config  = *config;
+
     pio_i2s_clocks clocks;
-    calc_clocks(config, &clocks);
+    if (!calc_clocks(config, &clocks)) {
+        panic("No PIO dividers for the I2S clocks.");
+    }
 
     if (config->sck_enable) {
         // SCK block
         i2s->sm_sck = pio_claim_unused_sm(pio, true);
         i2s->sm_mask |= (1u << i2s->sm_sck);
         offset = pio_add_program(pio, &i2s_sck_program);
+        i2s->sm_offset[i2s->sm_sck] = offset;
         i2s_sck_program_init(pio, i2s->sm_sck, offset, config->sck_pin);
         pio_sm_set_clkdiv_int_frac(pio, i2s->sm_sck, clocks.sck_d, clocks.sck_f);
     }
@@ -172,8 +213,10 @@ static void i2s_slave_program_init(PIO pio, const i2s_config* config, pio_i2s* i
     i2s->sm_din  = pio_claim_unused_sm(pio, true);
     i2s->sm_dout = i2s->sm_din;
     i2s->sm_mask |= (1u << i2s->sm_din);
-    offset = pio_add_program(pio, &i2s_bidi_slave_program);
-    i2s_bidi_slave_program_init(pio, i2s->sm_din, offset, config->dout_pin, config->din_pin);
+    offset = pio_add_program(pio, &I2S_BIDI_PROGRAM);
+    i2s->sm_offset[i2s->sm_din] = offset;
+    i2s->slaved = true;
+    i2s_bidi_slave_program_init(pio, i2s->sm_din, offset, config->dout_pin, config->din_pin, AUDIO_I2S_PACKED);
     pio_sm_set_clkdiv_int_frac(pio, i2s->sm_din, clocks.sck_d, clocks.sck_f);
 }
 
@@ -186,8 +229,12 @@ static void i2s_sync_program_init(PIO pio, const i2s_config* config, pio_i2s* i2
     i2s->pio     = pio;
     i2s->sm_mask = 0;
 
+    i2s->config  = *config;
+
     pio_i2s_clocks clocks;
-    calc_clocks(config, &clocks);
+    if (!calc_clocks(config, &clocks)) {
+        panic("No PIO dividers for the I2S clocks.");
+    }
 
     if (config->sck_enable) {
         // Check that SCK and BCK are in perfect whole ratio
@@ -204,6 +251,7 @@ static void i2s_sync_program_init(PIO pio, const i2s_config* config, pio_i2s* i2
         i2s->sm_sck = pio_claim_unused_sm(pio, true);
         i2s->sm_mask |= (1u << i2s->sm_sck);
         offset = pio_add_program(pio, &i2s_sck_program);
+        i2s->sm_offset[i2s->sm_sck] = offset;
         i2s_sck_program_init(pio, i2s->sm_sck, offset, config->sck_pin);
         pio_sm_set_clkdiv_int_frac(pio, i2s->sm_sck, clocks.sck_d, clocks.sck_f);
     }
@@ -211,32 +259,199 @@ static void i2s_sync_program_init(PIO pio, const i2s_config* config, pio_i2s* i2
     // In block, clocked with SCK
     i2s->sm_din = pio_claim_unused_sm(pio, true);
     i2s->sm_mask |= (1u << i2s->sm_din);
-    offset = pio_add_program(pio, &i2s_in_slave_program);
-    i2s_in_slave_program_init(pio, i2s->sm_din, offset, config->din_pin);
+    offset = pio_add_program(pio, &I2S_IN_PROGRAM);
+    i2s->sm_offset[i2s->sm_din] = offset;
+    i2s_in_slave_program_init(pio, i2s->sm_din, offset, config->din_pin, AUDIO_I2S_PACKED);
     pio_sm_set_clkdiv_int_frac(pio, i2s->sm_din, clocks.sck_d, clocks.sck_f);
 
     // Out block, clocked with BCK
     i2s->sm_dout = pio_claim_unused_sm(pio, true);
     i2s->sm_mask |= (1u << i2s->sm_dout);
-    offset = pio_add_program(pio, &i2s_out_master_program);
-    i2s_out_master_program_init(pio, i2s->sm_dout, offset, config->bit_depth, config->dout_pin, config->clock_pin_base);
+    offset = pio_add_program(pio, &I2S_OUT_PROGRAM);
+    i2s->sm_offset[i2s->sm_dout] = offset;
+    i2s->slaved = false;
+    i2s_out_master_program_init(pio, i2s->sm_dout, offset, config->bit_depth, config->dout_pin, config->clock_pin_base,
+                                AUDIO_I2S_PACKED);
     pio_sm_set_clkdiv_int_frac(pio, i2s->sm_dout, clocks.bck_d, clocks.bck_f);
 }
 
 void i2s_program_start_slaved(PIO pio, const i2s_config* config, void (*dma_handler)(void), pio_i2s* i2s) {
-    if (((uint32_t)i2s & 0x7) != 0) {
-        panic("pio_i2s argument must be 8-byte aligned!");
+    if (((uint32_t)i2s->out_ctrl_blocks & (I2S_CTRL_BLOCK_SIZE - 1)) != 0) {
+        panic("pio_i2s control blocks are not aligned for the DMA ring!");
     }
     i2s_slave_program_init(pio, config, i2s);
     dma_double_buffer_init(i2s, dma_handler);
-    pio_enable_sm_mask_in_sync(i2s->pio, i2s->sm_mask);
+    i2s_enable(i2s);
 }
 
 void i2s_program_start_synched(PIO pio, const i2s_config* config, void (*dma_handler)(void), pio_i2s* i2s) {
-    if (((uint32_t)i2s & 0x7) != 0) {
-        panic("pio_i2s argument must be 8-byte aligned!");
+    if (((uint32_t)i2s->out_ctrl_blocks & (I2S_CTRL_BLOCK_SIZE - 1)) != 0) {
+        panic("pio_i2s control blocks are not aligned for the DMA ring!");
     }
     i2s_sync_program_init(pio, config, i2s);
     dma_double_buffer_init(i2s, dma_handler);
-    pio_enable_sm_mask_in_sync(i2s->pio, i2s->sm_mask);
+    i2s_enable(i2s);
+}
+
+void i2s_stop(pio_i2s* i2s) {
+    pio_set_sm_mask_enabled(i2s->pio, i2s->sm_mask, false);
+    dma_channel_set_irq0_enabled(i2s->dma_ch_in_data, false);
+    uint32_t channels = (1u << i2s->dma_ch_in_ctrl) | (1u << i2s->dma_ch_in_data) |
+                        (1u << i2s->dma_ch_out_ctrl) | (1u << i2s->dma_ch_out_data);
+    if (i2s->follower != NULL) {
+        pio_sm_set_enabled(i2s->follower->pio, i2s->follower->sm, false);
+        channels |= (1u << i2s->follower->dma_ch_ctrl) | (1u << i2s->follower->dma_ch_data);
+    }
+    dma_hw->abort = channels;
+    while (dma_hw->abort & channels) {
+        tight_loop_contents();
+    }
+    dma_hw->ints0 = 1u << i2s->dma_ch_in_data;
+}
+
+/* Starts a stopped block again from the first buffer of the ring, every
+ * state machine back to the top of its program with empty FIFOs.
+ */
+static void i2s_restart(pio_i2s* i2s) {
+    for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+        if (!(i2s->sm_mask & (1u << sm))) continue;
+        pio_sm_clear_fifos(i2s->pio, sm);
+        pio_sm_restart(i2s->pio, sm);
+        pio_sm_exec(i2s->pio, sm, pio_encode_jmp(i2s->sm_offset[sm]));
+    }
+    pio_clkdiv_restart_sm_mask(i2s->pio, i2s->sm_mask);
+
+    pio_i2s_follower* f = i2s->follower;
+    if (f != NULL) {
+        pio_sm_clear_fifos(f->pio, f->sm);
+        pio_sm_restart(f->pio, f->sm);
+        pio_sm_exec(f->pio, f->sm, pio_encode_jmp(f->offset));
+    }
+
+    dma_channel_set_irq0_enabled(i2s->dma_ch_in_data, true);
+    dma_ring_start(i2s);
+    i2s_enable(i2s);
+}
+
+void i2s_set_sample_rate(pio_i2s* i2s, uint32_t fs) {
+    i2s_config config = i2s->config;
+    config.fs = fs;
+
+    pio_i2s_clocks clocks;
+    if (!calc_clocks(&config, &clocks) || (config.sck_enable && !validate_sck_bck_sync(&clocks))) {
+        panic("No PIO dividers for the I2S clocks.");
+    }
+    i2s->config = config;
+
+    // The ring restarts from its first buffer
+    i2s_stop(i2s);
+
+    for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+        if (!(i2s->sm_mask & (1u << sm))) continue;
+        pio_sm_set_clkdiv_int_frac(i2s->pio, sm, clocks.sck_d, clocks.sck_f);
+    }
+    if (i2s->sm_dout != i2s->sm_din) {
+        // The master output runs at BCK, everything else at SCK
+        pio_sm_set_clkdiv_int_frac(i2s->pio, i2s->sm_dout, clocks.bck_d, clocks.bck_f);
+    }
+    i2s_restart(i2s);
+}
+
+// Frees the state machines and program space of the current mode
+static void i2s_release_programs(pio_i2s* i2s) {
+    if (i2s->config.sck_enable) {
+        pio_remove_program(i2s->pio, &i2s_sck_program, i2s->sm_offset[i2s->sm_sck]);
+    }
+    if (i2s->slaved) {
+        pio_remove_program(i2s->pio, &I2S_BIDI_PROGRAM, i2s->sm_offset[i2s->sm_din]);
+    } else {
+        pio_remove_program(i2s->pio, &I2S_IN_PROGRAM, i2s->sm_offset[i2s->sm_din]);
+        pio_remove_program(i2s->pio, &I2S_OUT_PROGRAM, i2s->sm_offset[i2s->sm_dout]);
+    }
+    for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+        if (i2s->sm_mask & (1u << sm)) {
+            pio_sm_unclaim(i2s->pio, sm);
+        }
+    }
+}
+
+void i2s_set_slaved(pio_i2s* i2s, bool slaved) {
+    if (slaved == i2s->slaved) return;
+
+    i2s_config config = i2s->config;
+    i2s_stop(i2s);
+    i2s_release_programs(i2s);
+    if (slaved) {
+        i2s_slave_program_init(i2s->pio, &config, i2s);
+    } else {
+        i2s_sync_program_init(i2s->pio, &config, i2s);
+    }
+
+    // The ring restarts from its first buffer, on the new state machines' FIFOs
+    dma_ring_configure(i2s);
+    i2s_restart(i2s);
+}
+
+void i2s_add_follower(pio_i2s* i2s, PIO pio, uint8_t dout_pin, pio_i2s_follower* f) {
+    if (((uint32_t)f->ctrl_blocks & (I2S_CTRL_BLOCK_SIZE - 1)) != 0) {
+        panic("pio_i2s_follower control blocks are not aligned for the DMA ring!");
+    }
+
+    f->pio = pio;
+    f->sm = (uint8_t)pio_claim_unused_sm(pio, true);
+    f->offset = (uint8_t)pio_add_program(pio, &I2S_FOLLOW_PROGRAM);
+    i2s_out_follower_program_init(pio, f->sm, f->offset, dout_pin, i2s->config.clock_pin_base, AUDIO_I2S_PACKED);
+
+    f->dma_ch_ctrl = dma_claim_unused_channel(true);
+    f->dma_ch_data = dma_claim_unused_channel(true);
+    for (int i = 0; i < I2S_BUFFER_COUNT; i++) {
+        f->ctrl_blocks[i] = &f->output_buffer[i * STEREO_BUFFER_SIZE];
+    }
+
+    // Same ring as the main output's, without an interrupt of its own
+    dma_channel_config c = dma_channel_get_default_config(f->dma_ch_ctrl);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_ring(&c, false, I2S_CTRL_RING_BITS);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    dma_channel_configure(f->dma_ch_ctrl, &c, &dma_hw->ch[f->dma_ch_data].al3_read_addr_trig, f->ctrl_blocks, 1, false);
+
+    c = dma_channel_get_default_config(f->dma_ch_data);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_chain_to(&c, f->dma_ch_ctrl);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, f->sm, true));
+    dma_channel_configure(f->dma_ch_data, &c, &pio->txf[f->sm], NULL, STEREO_BUFFER_SIZE, false);
+
+    // Both rings start again together
+    i2s_stop(i2s);
+    i2s->follower = f;
+    i2s_restart(i2s);
+}
+
+// Pin polls before giving up on a clock, a few frames at the slowest rate
+#define I2S_MEASURE_POLLS   8192
+
+uint32_t __not_in_flash_func(i2s_measure_bck_per_frame)(const pio_i2s* i2s) {
+    const uint32_t bck_mask = 1u << i2s->config.clock_pin_base;
+    const uint32_t lrck_mask = bck_mask << 1;
+    uint32_t count = 0;
+    uint32_t frames = 0;
+
+    // LRCK changes on a falling BCK edge, so each rising edge falls in one frame
+    uint32_t irq_state = save_and_disable_interrupts();
+    uint32_t last = sio_hw->gpio_in;
+    for (uint32_t polls = 0; polls < I2S_MEASURE_POLLS; polls++) {
+        uint32_t now = sio_hw->gpio_in;
+        uint32_t rising = now & ~last;
+        last = now;
+        if (rising & lrck_mask) {
+            if (++frames == 2) break;
+        } else if ((rising & bck_mask) && frames == 1) {
+            count++;
+        }
+    }
+    restore_interrupts(irq_state);
+
+    return (frames == 2) ? count : 0;
 }
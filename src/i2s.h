@@ -28,9 +28,35 @@
 #include <stdio.h>
 #include "hardware/pio.h"
 #include "app_config.h"
+#include "clock_plan.h"
 
+/* Words of one buffer. Packed, a frame is one word with the left sample in
+ * the top half and the right in the bottom half. Otherwise it is two words,
+ * left then right, each left-justified.
+ */
+#if AUDIO_I2S_PACKED
+#define I2S_WORDS_PER_FRAME 1
+#else
+#define I2S_WORDS_PER_FRAME 2
+#endif
 // AUDIO_BUFFER_FRAMES is now defined in app_config.h
-#define STEREO_BUFFER_SIZE  (AUDIO_BUFFER_FRAMES * 2)
+#define STEREO_BUFFER_SIZE  (AUDIO_BUFFER_FRAMES * I2S_WORDS_PER_FRAME)
+
+_Static_assert(!AUDIO_I2S_PACKED || AUDIO_BIT_DEPTH == 16, "packed I2S frames need 16-bit audio");
+
+// BCK periods per LRCK frame the packed programs line their words up with
+#define I2S_PACKED_BCK_PER_FRAME    (AUDIO_BIT_DEPTH * 2)
+
+/* The DMA control channels cycle through a ring of AUDIO_BUFFER_COUNT
+ * buffer pointers using the DMA address wrap, so the count must be a power
+ * of two and the pointer arrays aligned to their own size.
+ */
+#define I2S_BUFFER_COUNT    AUDIO_BUFFER_COUNT
+#define I2S_CTRL_BLOCK_SIZE (I2S_BUFFER_COUNT * sizeof(int32_t*))
+#define I2S_CTRL_RING_BITS  ((I2S_BUFFER_COUNT == 2) ? 3 : (I2S_BUFFER_COUNT == 4) ? 4 : 5)
+
+_Static_assert(I2S_BUFFER_COUNT == 2 || I2S_BUFFER_COUNT == 4 || I2S_BUFFER_COUNT == 8,
+               "AUDIO_BUFFER_COUNT must be 2, 4 or 8");
 
 typedef struct i2s_config {
     uint32_t fs;
@@ -56,22 +82,40 @@ typedef struct pio_i2s_clocks {
     uint8_t  bck_f;
 } pio_i2s_clocks;
 
-// NOTE: Use __attribute__ ((aligned(8))) on this struct or the DMA wrap won't work!
+/* A data only output on any PIO, clocked by the BCK and LRCK of a pio_i2s
+ * for a second DAC on the same clocks. Its DMA ring is stopped, restarted
+ * and enabled with the pio_i2s's, so ring buffer n of both carries the
+ * same frames and the pio_i2s's DMA interrupt paces both.
+ */
+typedef struct pio_i2s_follower {
+    PIO        pio;
+    uint8_t    sm;
+    uint8_t    offset;
+    uint       dma_ch_ctrl;
+    uint       dma_ch_data;
+    int32_t*   ctrl_blocks[I2S_BUFFER_COUNT] __attribute__((aligned(I2S_CTRL_BLOCK_SIZE)));
+    int32_t    output_buffer[STEREO_BUFFER_SIZE * I2S_BUFFER_COUNT];
+} pio_i2s_follower;
+
+// NOTE: The control blocks carry their own alignment for the DMA wrap
 typedef struct pio_i2s {
     PIO        pio;
     uint8_t    sm_mask;
     uint8_t    sm_sck;
     uint8_t    sm_dout;
     uint8_t    sm_din;
+    uint8_t    sm_offset[NUM_PIO_STATE_MACHINES];  // Program start of each claimed state machine
+    bool       slaved;                             // BCK and LRCK come from an external master
     uint       dma_ch_in_ctrl;
     uint       dma_ch_in_data;
     uint       dma_ch_out_ctrl;
     uint       dma_ch_out_data;
-    int32_t*   in_ctrl_blocks[2];  // Control blocks MUST have 8-byte alignment.
-    int32_t*   out_ctrl_blocks[2];
-    int32_t    input_buffer[STEREO_BUFFER_SIZE * 2];
-    int32_t    output_buffer[STEREO_BUFFER_SIZE * 2];
+    int32_t*   in_ctrl_blocks[I2S_BUFFER_COUNT] __attribute__((aligned(I2S_CTRL_BLOCK_SIZE)));
+    int32_t*   out_ctrl_blocks[I2S_BUFFER_COUNT] __attribute__((aligned(I2S_CTRL_BLOCK_SIZE)));
+    int32_t    input_buffer[STEREO_BUFFER_SIZE * I2S_BUFFER_COUNT];
+    int32_t    output_buffer[STEREO_BUFFER_SIZE * I2S_BUFFER_COUNT];
     i2s_config config;
+    pio_i2s_follower* follower;                    // Second output on the same clocks, or NULL
 } pio_i2s;
 
 extern const i2s_config i2s_config_default;
@@ -79,4 +123,36 @@ extern const i2s_config i2s_config_default;
 void i2s_program_start_slaved(PIO pio, const i2s_config* config, void (*dma_handler)(void), pio_i2s* i2s);
 void i2s_program_start_synched(PIO pio, const i2s_config* config, void (*dma_handler)(void), pio_i2s* i2s);
 
+/* Fills a clock plan request for running config at sample rate fs, with the
+ * system clock window from app_config.h.
+ */
+void i2s_get_clock_request(const i2s_config* config, uint32_t fs, clock_plan_request_t* req);
+
+// Stops the state machines and the DMA ring
+void i2s_stop(pio_i2s* i2s);
+
+/* Stops the state machines and DMA, recomputes the PIO dividers for fs at
+ * the current system clock and restarts both from the first buffer of the
+ * ring. Call after clock_plan_apply when changing rate.
+ */
+void i2s_set_sample_rate(pio_i2s* i2s, uint32_t fs);
+
+/* Switches between driving BCK and LRCK (synched) and following an
+ * external master on the same pins (slaved), reloading the state machines.
+ * The DMA ring restarts from its first buffer, as on a rate change.
+ */
+void i2s_set_slaved(pio_i2s* i2s, bool slaved);
+
+/* Starts a second output on dout_pin, a state machine of pio following
+ * i2s's clock pins. i2s restarts from the first buffer of its ring with
+ * the follower, and both stay together through rate and mode changes.
+ */
+void i2s_add_follower(pio_i2s* i2s, PIO pio, uint8_t dout_pin, pio_i2s_follower* follower);
+
+/* Counts the BCK periods of one LRCK frame on i2s's clock pins, whoever
+ * drives them, or returns 0 when they do not toggle within a few frames.
+ * Polls the pins with interrupts disabled for up to two frames.
+ */
+uint32_t i2s_measure_bck_per_frame(const pio_i2s* i2s);
+
 #endif  // I2S_TEST_I2S_H
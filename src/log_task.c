@@ -2,11 +2,12 @@
 #include "task.h"
 #include "log_task.h"
 #include "queue.h"
-#include "semphr.h"
 #include "pico/stdlib.h"
 #include "hardware/uart.h"
 #include "hardware/irq.h"
 #include "app_config.h"
+#include "diagnostics.h"
+#include "trace.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -20,8 +21,24 @@ typedef struct {
 } LogMessage_t;
 
 static QueueHandle_t xLogQueue = NULL;
-static SemaphoreHandle_t xUartTxSem = NULL;
-static QueueSetHandle_t xLogQueueSet = NULL;
+static TaskHandle_t xLogTaskHandle = NULL;
+static StaticQueue_t xLogQueueBuffer;
+static uint8_t ucLogQueueStorage[MAX_LOG_MSG_LEN * sizeof(LogMessage_t)];
+
+// Binary control replies, sent whole between log lines
+typedef struct {
+    uint16_t len;
+    uint8_t data[LOG_MAX_FRAME_LEN];
+} LogFrame_t;
+
+#define LOG_FRAME_QUEUE_LENGTH 4
+static QueueHandle_t xFrameQueue = NULL;
+static StaticQueue_t xFrameQueueBuffer;
+static uint8_t ucFrameQueueStorage[LOG_FRAME_QUEUE_LENGTH * sizeof(LogFrame_t)];
+
+// Wake-up reasons for the logging task
+#define LOG_NOTIFY_TX       (1u << 0)   // UART TX FIFO has room
+#define LOG_NOTIFY_MSG      (1u << 1)   // A message was queued
 
 #define TX_BUFFER_SIZE 512
 static uint8_t ucTxBuffer[TX_BUFFER_SIZE];
@@ -48,23 +65,27 @@ static bool tx_buffer_empty() {
 }
 
 static void on_uart_irq(void) {
+    TRACE_RECORD(TRACE_EV_ISR_ENTER, TRACE_ISR_UART_LOG);
     if (uart_is_writable(UART_ID_LOG)) {
         // Disable TX interrupt
         uart_set_irq_enables(UART_ID_LOG, false, false);
         
         BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-        xSemaphoreGiveFromISR(xUartTxSem, &xHigherPriorityTaskWoken);
+        xTaskNotifyFromISR(xLogTaskHandle, LOG_NOTIFY_TX, eSetBits, &xHigherPriorityTaskWoken);
+        TRACE_RECORD(TRACE_EV_ISR_EXIT, TRACE_ISR_UART_LOG);
         portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+        return;
     }
+    TRACE_RECORD(TRACE_EV_ISR_EXIT, TRACE_ISR_UART_LOG);
 }
 
 void vLogTaskInit(void) {
-    xLogQueue = xQueueCreate(MAX_LOG_MSG_LEN, sizeof(LogMessage_t));
-    xUartTxSem = xSemaphoreCreateBinary();
-    xLogQueueSet = xQueueCreateSet(MAX_LOG_MSG_LEN + 1);
-    
-    xQueueAddToSet(xLogQueue, xLogQueueSet);
-    xQueueAddToSet(xUartTxSem, xLogQueueSet);
+    xLogQueue = xQueueCreateStatic(MAX_LOG_MSG_LEN, sizeof(LogMessage_t),
+                                   ucLogQueueStorage, &xLogQueueBuffer);
+    diag_register_queue(xLogQueue, "Log");
+    xFrameQueue = xQueueCreateStatic(LOG_FRAME_QUEUE_LENGTH, sizeof(LogFrame_t),
+                                     ucFrameQueueStorage, &xFrameQueueBuffer);
+    diag_register_queue(xFrameQueue, "LogFrame");
 
     uart_set_fifo_enabled(UART_ID_LOG, true);
     uart_init(UART_ID_LOG, BAUD_RATE_LOG);
@@ -93,24 +114,41 @@ void log_msg(const char *msg) {
     }
     data.sender[configMAX_TASK_NAME_LEN - 1] = '\0';
     
-    xQueueSendToBack(xLogQueue, &data, 0);
+    if (xQueueSendToBack(xLogQueue, &data, 0) == pdTRUE && xLogTaskHandle != NULL) {
+        xTaskNotify(xLogTaskHandle, LOG_NOTIFY_MSG, eSetBits);
+    }
+}
+
+bool log_write_frame(const uint8_t *data, size_t len) {
+    static LogFrame_t frame;    // Too large for the callers' stacks, and only the audio task sends
+    if (xFrameQueue == NULL || len > LOG_MAX_FRAME_LEN) return false;
+
+    frame.len = (uint16_t)len;
+    memcpy(frame.data, data, len);
+    if (xQueueSendToBack(xFrameQueue, &frame, 0) != pdTRUE) return false;
+    if (xLogTaskHandle != NULL) {
+        xTaskNotify(xLogTaskHandle, LOG_NOTIFY_MSG, eSetBits);
+    }
+    return true;
+}
+
+static size_t tx_buffer_free(void) {
+    size_t used = (uxTxHead >= uxTxTail) ? (uxTxHead - uxTxTail) : (TX_BUFFER_SIZE - uxTxTail + uxTxHead);
+    return (TX_BUFFER_SIZE - 1) - used;
 }
 
 void vLoggingTask(void *pvParameters) {
     LogMessage_t msg_data;
+    static LogFrame_t frame_data;
     char formatted_buf[128];
     
+    xLogTaskHandle = xTaskGetCurrentTaskHandle();
     log_msg("Logging Task Initialized");
 
+    /* Messages queued before the scheduler started are already waiting, so
+     * the queue is serviced before the first wait */
     for(;;)
     {
-
-        QueueSetMemberHandle_t xActivated = xQueueSelectFromSet(xLogQueueSet, portMAX_DELAY); // Block until TX interrupt or message added to queue
-        
-        if (xActivated == xUartTxSem) {
-            xSemaphoreTake(xUartTxSem, 0);
-        }
-
         // Write as much data as possible to UART
         while (!tx_buffer_empty() && uart_is_writable(UART_ID_LOG)) {
             uint8_t c;
@@ -119,12 +157,18 @@ void vLoggingTask(void *pvParameters) {
             }
         }
         
+        // Control replies go first, a host is waiting on them
+        while (uxQueueMessagesWaiting(xFrameQueue) > 0 && tx_buffer_free() >= LOG_MAX_FRAME_LEN) {
+            if (xQueueReceive(xFrameQueue, &frame_data, 0) == pdTRUE) {
+                for (size_t i = 0; i < frame_data.len; i++) {
+                    tx_buffer_put(frame_data.data[i]);
+                }
+            }
+        }
+
         // Process log queue
         while (uxQueueMessagesWaiting(xLogQueue) > 0) {
-            size_t used = (uxTxHead >= uxTxTail) ? (uxTxHead - uxTxTail) : (TX_BUFFER_SIZE - uxTxTail + uxTxHead);
-            size_t free = (TX_BUFFER_SIZE - 1) - used;
-
-            if (free < 128) {
+            if (tx_buffer_free() < 128) {
                 break; // Not enough space, wait for next TX interrupt
             }
 
@@ -145,6 +189,7 @@ void vLoggingTask(void *pvParameters) {
         } else {
             uart_set_irq_enables(UART_ID_LOG, false, false);
         }
-        
+
+        xTaskNotifyWait(0, UINT32_MAX, NULL, portMAX_DELAY); // Block until TX interrupt or message added to queue
     }
 }
\ No newline at end of file
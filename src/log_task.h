@@ -1,11 +1,21 @@
 #ifndef LOG_TASK_H
 #define LOG_TASK_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "FreeRTOS.h"
 #include "task.h"
 
 void vLogTaskInit(void);
 void log_msg(const char *msg);
+
+/* Queues a binary frame for the log UART, sent whole between log lines.
+ * Returns false if it is too long or the queue is full.
+ */
+#define LOG_MAX_FRAME_LEN   160
+bool log_write_frame(const uint8_t *data, size_t len);
+
 void vLoggingTask(void *pvParameters);
     
 #endif // LOG_TASK_H
\ No newline at end of file
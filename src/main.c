@@ -6,6 +6,8 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include "hardware/clocks.h"
+#include "clock_plan.h"
+#include "i2s.h"
 
 /* App Configuration */
 #include "app_config.h"
@@ -14,6 +16,9 @@
 #include "log_task.h"
 #include "audio_task.h"
 #include "midi_task.h"
+#include "usb_task.h"
+#include "diagnostics.h"
+#include "trace.h"
 
 static void prvSetupHardware( void );
 void vApplicationMallocFailedHook( void );
@@ -29,55 +34,120 @@ uint32_t ulGetRunTimeCounterValue( void )
 
 void vAliveTask(void *pvParameters)
 {
+    uint32_t ulElapsedMs = 0;
+
 	for( ;; )
     {
-        vTaskDelay(pdMS_TO_TICKS(500));
+        vTaskDelay(pdMS_TO_TICKS(ALIVE_PERIOD_MS));
         gpio_xor_mask( 1u << PIN_LED_ALIVE );
         //log_msg("Alive Task Heartbeat");
+
+        // An xrun froze the trace, send it to the host
+        if (trace_is_frozen()) {
+            trace_dump();
+        }
+
+        ulElapsedMs += ALIVE_PERIOD_MS;
+        if (ulElapsedMs >= DIAG_REPORT_INTERVAL_MS) {
+            ulElapsedMs = 0;
+            diag_report();
+        }
     }
 }
 
+/* Task stacks and control blocks are allocated statically so that their
+ * RAM is accounted for at link time */
+static StackType_t xsLoggingStack[STACK_SIZE_LOGGING];
+static StackType_t xsAudioStack[STACK_SIZE_AUDIO];
+static StackType_t xsMidiStack[STACK_SIZE_MIDI];
+static StackType_t xsUsbStack[STACK_SIZE_USB];
+static StackType_t xsAliveStack[STACK_SIZE_ALIVE];
+static StaticTask_t xLoggingTCB;
+static StaticTask_t xAudioTCB;
+static StaticTask_t xMidiTCB;
+static StaticTask_t xUsbTCB;
+static StaticTask_t xAliveTCB;
+
 int main( void )
 {
 
+    TaskHandle_t xLogTaskHandle;
+    TaskHandle_t xAudioTaskHandle;
+    TaskHandle_t xMidiTaskHandle;
+    TaskHandle_t xUsbTaskHandle;
+    TaskHandle_t xAliveTaskHandle;
+
     prvSetupHardware();
 
     /* Create logging task */
-    xTaskCreate(vLoggingTask,				        /* The function that implements the task. */
-				"Log", 							    /* The text name assigned to the task - for debug only as it is not used by the kernel. */
-				STACK_SIZE_LOGGING, 			    /* The size of the stack to allocate to the task. */
-				NULL, 								/* The parameter passed to the task - not used in this case. */
-				PRIORITY_LOGGING_TASK, 	            /* The priority assigned to the task. */
-				NULL );								/* The task handle is not required, so NULL is passed. */
+    xLogTaskHandle = xTaskCreateStatic(vLoggingTask, /* The function that implements the task. */
+				"Log",                          /* The text name assigned to the task - for debug only as it is not used by the kernel. */
+				STACK_SIZE_LOGGING,             /* The size of the stack to allocate to the task. */
+				NULL,                           /* The parameter passed to the task - not used in this case. */
+				PRIORITY_LOGGING_TASK,          /* The priority assigned to the task. */
+				xsLoggingStack,                 /* The statically allocated stack. */
+				&xLoggingTCB );                 /* The statically allocated task control block. */
 
     /* Create audio task */
-    xTaskCreate(vAudioTask,				            /* The function that implements the task. */
-				"Audio", 							/* The text name assigned to the task - for debug only as it is not used by the kernel. */
-				STACK_SIZE_AUDIO, 			        /* The size of the stack to allocate to the task. */
-				NULL, 								/* The parameter passed to the task - not used in this case. */
-				PRIORITY_AUDIO_TASK, 	            /* The priority assigned to the task. */
-				NULL );								/* The task handle is not required, so NULL is passed. */
+    xAudioTaskHandle = xTaskCreateStatic(vAudioTask, /* The function that implements the task. */
+				"Audio",                        /* The text name assigned to the task - for debug only as it is not used by the kernel. */
+				STACK_SIZE_AUDIO,               /* The size of the stack to allocate to the task. */
+				NULL,                           /* The parameter passed to the task - not used in this case. */
+				PRIORITY_AUDIO_TASK,            /* The priority assigned to the task. */
+				xsAudioStack,                   /* The statically allocated stack. */
+				&xAudioTCB );                   /* The statically allocated task control block. */
+    vTaskCoreAffinitySet(xAudioTaskHandle, CORE_AFFINITY_AUDIO);
 
     /* Create MIDI task */
-    xTaskCreate(vMidiTask,				            /* The function that implements the task. */
-				"MIDI", 							/* The text name assigned to the task - for debug only as it is not used by the kernel. */
-				STACK_SIZE_MIDI, 			        /* The size of the stack to allocate to the task. */
-				NULL, 								/* The parameter passed to the task - not used in this case. */
-				PRIORITY_MIDI_TASK, 	            /* The priority assigned to the task. */
-				NULL );								/* The task handle is not required, so NULL is passed. */
+    xMidiTaskHandle = xTaskCreateStatic(vMidiTask, /* The function that implements the task. */
+				"MIDI",                         /* The text name assigned to the task - for debug only as it is not used by the kernel. */
+				STACK_SIZE_MIDI,                /* The size of the stack to allocate to the task. */
+				NULL,                           /* The parameter passed to the task - not used in this case. */
+				PRIORITY_MIDI_TASK,             /* The priority assigned to the task. */
+				xsMidiStack,                    /* The statically allocated stack. */
+				&xMidiTCB );                    /* The statically allocated task control block. */
+
+    /* Create USB task */
+    xUsbTaskHandle = xTaskCreateStatic(vUsbTask, /* The function that implements the task. */
+				"USB",                          /* The text name assigned to the task - for debug only as it is not used by the kernel. */
+				STACK_SIZE_USB,                 /* The size of the stack to allocate to the task. */
+				NULL,                           /* The parameter passed to the task - not used in this case. */
+				PRIORITY_USB_TASK,              /* The priority assigned to the task. */
+				xsUsbStack,                     /* The statically allocated stack. */
+				&xUsbTCB );                     /* The statically allocated task control block. */
 
     /* Create Alive task */
-    xTaskCreate(vAliveTask,				            /* The function that implements the task. */
-				"Alive", 							/* The text name assigned to the task - for debug only as it is not used by the kernel. */
-				STACK_SIZE_ALIVE, 			        /* The size of the stack to allocate to the task. */
-				NULL, 								/* The parameter passed to the task - not used in this case. */
-				PRIORITY_ALIVE_TASK, 	            /* The priority assigned to the task. */
-				NULL );	
+    xAliveTaskHandle = xTaskCreateStatic(vAliveTask, /* The function that implements the task. */
+				"Alive",                        /* The text name assigned to the task - for debug only as it is not used by the kernel. */
+				STACK_SIZE_ALIVE,               /* The size of the stack to allocate to the task. */
+				NULL,                           /* The parameter passed to the task - not used in this case. */
+				PRIORITY_ALIVE_TASK,            /* The priority assigned to the task. */
+				xsAliveStack,                   /* The statically allocated stack. */
+				&xAliveTCB );                   /* The statically allocated task control block. */
+
+    vTaskSetTaskNumber(xLogTaskHandle, TRACE_TASK_LOG);
+    vTaskSetTaskNumber(xAudioTaskHandle, TRACE_TASK_AUDIO);
+    vTaskSetTaskNumber(xMidiTaskHandle, TRACE_TASK_MIDI);
+    vTaskSetTaskNumber(xUsbTaskHandle, TRACE_TASK_USB);
+    vTaskSetTaskNumber(xAliveTaskHandle, TRACE_TASK_ALIVE);
+
+    diag_register_task(xLogTaskHandle, STACK_SIZE_LOGGING);
+    diag_register_task(xAudioTaskHandle, STACK_SIZE_AUDIO);
+    diag_register_task(xMidiTaskHandle, STACK_SIZE_MIDI);
+    diag_register_task(xUsbTaskHandle, STACK_SIZE_USB);
+    diag_register_task(xAliveTaskHandle, STACK_SIZE_ALIVE);
 
     /* Initialize Tasks */
     vLogTaskInit();
+    trace_init();
+#if TRACE_ENABLE
+    char msg_buf[48];
+    snprintf(msg_buf, sizeof(msg_buf), "Trace %lu ns/event", trace_get_overhead_ns());
+    log_msg(msg_buf);
+#endif
     vAudioTaskInit();
     vMidiTaskInit();
+    vUsbTaskInit();
 
     /* Start the tasks and timer running. */
 	vTaskStartScheduler();
@@ -87,8 +157,14 @@ int main( void )
 
 static void prvSetupHardware( void )
 {
-    // Set a 132.000 MHz system clock to more evenly divide the audio frequencies
-    set_sys_clock_khz(SYS_CLOCK_KHZ, true);
+    // Run the system clock that divides best into the audio clocks at the boot rate
+    clock_plan_request_t req;
+    clock_plan_t plan;
+    i2s_get_clock_request(&i2s_config_default, AUDIO_SAMPLE_RATE, &req);
+    if (!clock_plan_search(&req, &plan)) {
+        panic("No clock plan for %d Hz", AUDIO_SAMPLE_RATE);
+    }
+    clock_plan_apply(&plan);
     //stdio_init_all();
     gpio_init(PIN_LED_ALIVE);
     gpio_set_dir(PIN_LED_ALIVE, 1);
@@ -124,3 +200,61 @@ void vApplicationStackOverflowHook( TaskHandle_t pxTask, char *pcTaskName )
 /*-----------------------------------------------------------*/
 
 
+
+/* With static allocation the kernel asks the application for the memory of
+the tasks it creates itself. */
+void vApplicationGetIdleTaskMemory( StaticTask_t **ppxIdleTaskTCBBuffer,
+                                    StackType_t **ppxIdleTaskStackBuffer,
+                                    uint32_t *pulIdleTaskStackSize )
+{
+    static StaticTask_t xIdleTaskTCB;
+    static StackType_t uxIdleTaskStack[ configMINIMAL_STACK_SIZE ];
+
+    *ppxIdleTaskTCBBuffer = &xIdleTaskTCB;
+    *ppxIdleTaskStackBuffer = uxIdleTaskStack;
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+/*-----------------------------------------------------------*/
+
+/* The second core runs its own idle task. The SMP kernel branch calls it
+the minimal idle task, V11 and later the passive idle task. */
+#if ( tskKERNEL_VERSION_MAJOR >= 11 )
+void vApplicationGetPassiveIdleTaskMemory( StaticTask_t **ppxIdleTaskTCBBuffer,
+                                           StackType_t **ppxIdleTaskStackBuffer,
+                                           uint32_t *pulIdleTaskStackSize,
+                                           BaseType_t xPassiveIdleTaskIndex )
+{
+    static StaticTask_t xIdleTaskTCBs[ configNUM_CORES - 1 ];
+    static StackType_t uxIdleTaskStacks[ configNUM_CORES - 1 ][ configMINIMAL_STACK_SIZE ];
+
+    *ppxIdleTaskTCBBuffer = &xIdleTaskTCBs[ xPassiveIdleTaskIndex ];
+    *ppxIdleTaskStackBuffer = uxIdleTaskStacks[ xPassiveIdleTaskIndex ];
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+#else
+void vApplicationGetMinimalIdleTaskMemory( StaticTask_t **ppxIdleTaskTCBBuffer,
+                                           StackType_t **ppxIdleTaskStackBuffer,
+                                           uint32_t *pulIdleTaskStackSize )
+{
+    static StaticTask_t xIdleTaskTCB;
+    static StackType_t uxIdleTaskStack[ configMINIMAL_STACK_SIZE ];
+
+    *ppxIdleTaskTCBBuffer = &xIdleTaskTCB;
+    *ppxIdleTaskStackBuffer = uxIdleTaskStack;
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+#endif
+/*-----------------------------------------------------------*/
+
+void vApplicationGetTimerTaskMemory( StaticTask_t **ppxTimerTaskTCBBuffer,
+                                     StackType_t **ppxTimerTaskStackBuffer,
+                                     uint32_t *pulTimerTaskStackSize )
+{
+    static StaticTask_t xTimerTaskTCB;
+    static StackType_t uxTimerTaskStack[ configTIMER_TASK_STACK_DEPTH ];
+
+    *ppxTimerTaskTCBBuffer = &xTimerTaskTCB;
+    *ppxTimerTaskStackBuffer = uxTimerTaskStack;
+    *pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+}
+/*-----------------------------------------------------------*/
@@ -0,0 +1,99 @@
+#include "midi_clock.h"
+
+// PLL gains as shifts: phase takes 1/8 of the error, period 1/64
+#define MIDI_CLOCK_ALPHA_SHIFT  3
+#define MIDI_CLOCK_BETA_SHIFT   6
+
+// Accepted tick period range, 20 to 300 BPM
+#define MIDI_CLOCK_MIN_PERIOD_US    (60000000u / (300 * MIDI_CLOCK_PPQN))
+#define MIDI_CLOCK_MAX_PERIOD_US    (60000000u / (20 * MIDI_CLOCK_PPQN))
+
+static uint32_t last_timestamp_us = 0;
+static int64_t  now_q8 = 0;         // Unwrapped time of the last tick, us Q8
+static int64_t  phase_q8 = 0;       // Filtered time of the last tick, us Q8
+static int32_t  period_q8 = 0;      // Filtered tick period, us Q8
+static uint32_t jitter_q4 = 0;      // Mean absolute error, us Q4
+static uint32_t max_error_us = 0;
+static uint32_t ticks = 0;
+static uint32_t valid_ticks = 0;    // Ticks since the PLL was last (re)seeded
+static bool running = false;
+
+void midi_clock_init(void) {
+    running = false;
+    ticks = 0;
+    valid_ticks = 0;
+    period_q8 = 0;
+    jitter_q4 = 0;
+    max_error_us = 0;
+}
+
+void midi_clock_tick(uint32_t timestamp_us) {
+    // Extend the 32-bit microsecond timer, ticks arrive far more often than it wraps
+    now_q8 += (int64_t)(uint32_t)(timestamp_us - last_timestamp_us) << 8;
+    last_timestamp_us = timestamp_us;
+    ticks++;
+
+    if (valid_ticks == 0) {
+        phase_q8 = now_q8;
+        valid_ticks = 1;
+        return;
+    }
+
+    if (valid_ticks == 1) {
+        int64_t measured = now_q8 - phase_q8;
+        phase_q8 = now_q8;
+        if (measured < ((int64_t)MIDI_CLOCK_MIN_PERIOD_US << 8) || measured > ((int64_t)MIDI_CLOCK_MAX_PERIOD_US << 8)) {
+            return;     // Still waiting for a plausible pair of ticks
+        }
+        period_q8 = (int32_t)measured;
+        valid_ticks = 2;
+        return;
+    }
+
+    int64_t predicted = phase_q8 + period_q8;
+    int32_t error_q8 = (int32_t)(now_q8 - predicted);
+    int32_t abs_error_q8 = (error_q8 < 0) ? -error_q8 : error_q8;
+
+    // An error of half a period is a tempo jump or dropout, not jitter
+    if (abs_error_q8 > period_q8 / 2) {
+        phase_q8 = now_q8;
+        valid_ticks = 1;
+        return;
+    }
+
+    phase_q8  = predicted + (error_q8 >> MIDI_CLOCK_ALPHA_SHIFT);
+    period_q8 = period_q8 + (error_q8 >> MIDI_CLOCK_BETA_SHIFT);
+    valid_ticks++;
+
+    uint32_t abs_error_us = (uint32_t)abs_error_q8 >> 8;
+    if (abs_error_us > max_error_us) max_error_us = abs_error_us;
+    // Mean absolute error, exponentially weighted over about 16 ticks
+    jitter_q4 += (int32_t)((abs_error_us << 4) - jitter_q4) >> 4;
+}
+
+void midi_clock_start(uint32_t timestamp_us) {
+    (void)timestamp_us;
+    running = true;
+    ticks = 0;
+    max_error_us = 0;
+}
+
+void midi_clock_continue(uint32_t timestamp_us) {
+    (void)timestamp_us;
+    running = true;
+}
+
+void midi_clock_stop(void) {
+    running = false;
+}
+
+void midi_clock_get_stats(midi_clock_stats_t* stats) {
+    stats->locked       = (valid_ticks >= 2);
+    stats->period_us    = (uint32_t)period_q8 >> 8;
+    stats->period_us_q8 = (uint32_t)period_q8;
+    stats->bpm_x100     = stats->locked ? (uint32_t)((60000000ull * 100 * 256) / ((uint64_t)period_q8 * MIDI_CLOCK_PPQN)) : 0;
+    stats->jitter_us    = jitter_q4 >> 4;
+    stats->max_error_us = max_error_us;
+    stats->ticks        = ticks;
+    stats->running      = running;
+}
@@ -0,0 +1,36 @@
+#ifndef MIDI_CLOCK_H
+#define MIDI_CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* MIDI clock (24 ticks per quarter note) tempo tracker.
+ *
+ * Tick timestamps are filtered with an alpha-beta PLL: each tick's arrival
+ * is compared with the predicted time, a fraction of the error corrects the
+ * phase and a smaller fraction corrects the period. Transport jitter on the
+ * individual ticks is rejected while real tempo changes are followed within
+ * a few beats. Plain C, so recorded clock streams can be replayed on a host.
+ */
+
+#define MIDI_CLOCK_PPQN     24
+
+typedef struct {
+    uint32_t period_us;     // Filtered tick period
+    uint32_t period_us_q8;  // The same with 8 fractional bits
+    uint32_t bpm_x100;      // Tempo in hundredths of a BPM
+    uint32_t jitter_us;     // Mean absolute tick error against the prediction
+    uint32_t max_error_us;  // Largest tick error since the last start
+    uint32_t ticks;         // Ticks since start
+    bool     running;
+    bool     locked;        // At least two ticks seen, period valid
+} midi_clock_stats_t;
+
+void midi_clock_init(void);
+void midi_clock_tick(uint32_t timestamp_us);
+void midi_clock_start(uint32_t timestamp_us);
+void midi_clock_continue(uint32_t timestamp_us);
+void midi_clock_stop(void);
+void midi_clock_get_stats(midi_clock_stats_t* stats);
+
+#endif /* MIDI_CLOCK_H */
@@ -0,0 +1,57 @@
+#include "midi_merge.h"
+#include <stddef.h>
+
+typedef struct {
+    midi_message_t msgs[MIDI_MERGE_DEPTH];
+    uint32_t head;
+    uint32_t tail;
+} merge_fifo_t;
+
+static merge_fifo_t fifos[MIDI_SOURCE_COUNT];
+static uint32_t dropped = 0;
+
+void midi_merge_init(void) {
+    for (int i = 0; i < MIDI_SOURCE_COUNT; i++) {
+        fifos[i].head = 0;
+        fifos[i].tail = 0;
+    }
+    dropped = 0;
+}
+
+bool midi_merge_push(const midi_message_t* msg) {
+    if (msg->source >= MIDI_SOURCE_COUNT) return false;
+    merge_fifo_t* f = &fifos[msg->source];
+
+    if (f->head - f->tail >= MIDI_MERGE_DEPTH) {
+        dropped++;
+        return false;
+    }
+    f->msgs[f->head & (MIDI_MERGE_DEPTH - 1)] = *msg;
+    f->head++;
+    return true;
+}
+
+bool midi_merge_pop(midi_message_t* msg) {
+    merge_fifo_t* best = NULL;
+    const midi_message_t* best_msg = NULL;
+
+    for (int i = 0; i < MIDI_SOURCE_COUNT; i++) {
+        merge_fifo_t* f = &fifos[i];
+        if (f->head == f->tail) continue;
+        const midi_message_t* m = &f->msgs[f->tail & (MIDI_MERGE_DEPTH - 1)];
+        // Signed difference keeps the order correct across timer wrap
+        if (best == NULL || (int32_t)(m->timestamp_us - best_msg->timestamp_us) < 0) {
+            best = f;
+            best_msg = m;
+        }
+    }
+
+    if (best == NULL) return false;
+    *msg = *best_msg;
+    best->tail++;
+    return true;
+}
+
+uint32_t midi_merge_get_dropped(void) {
+    return dropped;
+}
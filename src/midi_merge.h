@@ -0,0 +1,37 @@
+#ifndef MIDI_MERGE_H
+#define MIDI_MERGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "midi_parser.h"
+
+/* Merges the messages of several MIDI sources into one stream ordered by
+ * timestamp. Each source has its own FIFO, which is already in time order,
+ * so popping always takes the earliest head. Not thread safe: push and pop
+ * from the same task.
+ *
+ * The order only holds among the messages queued when popping starts.
+ * midi_task drains the merge on every wake, so a message that reaches it
+ * on a later wake is delivered after everything popped before, even when
+ * its timestamp is earlier: a USB packet stamped while the previous wake
+ * was delivering, say. Within one DIN FIFO a Real-Time byte sent in the
+ * middle of a message completes first and so precedes that message.
+ * DIN bytes are stamped in the UART interrupt, back-dated by their place
+ * in the FIFO, and USB packets as they arrive, so neither source is
+ * biased behind the other by the drain.
+ * tools/midi_replay.c counts both cases in a recorded stream.
+ */
+
+#define MIDI_MERGE_DEPTH    32  // Messages buffered per source, power of two
+
+void midi_merge_init(void);
+
+// Returns false, and counts a drop, if the source's FIFO is full
+bool midi_merge_push(const midi_message_t* msg);
+
+// Returns false when every source is empty
+bool midi_merge_pop(midi_message_t* msg);
+
+uint32_t midi_merge_get_dropped(void);
+
+#endif /* MIDI_MERGE_H */
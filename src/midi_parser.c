@@ -1,32 +1,51 @@
 #include "midi_parser.h"
 #include <stddef.h>
 
-static midi_note_on_callback_t note_on_cb = NULL;
-static midi_note_off_callback_t note_off_cb = NULL;
+static const midi_parser_callbacks_t* cb = NULL;
 
 static uint8_t status = 0;
 static uint8_t data_count = 0;
 static uint8_t data1 = 0;
+static uint32_t message_start_us = 0;
+static bool status_fresh = false;   // No data byte seen since the status byte
 
-void midi_parser_init(midi_note_on_callback_t on_cb, midi_note_off_callback_t off_cb) {
-    note_on_cb = on_cb;
-    note_off_cb = off_cb;
+void midi_parser_init(const midi_parser_callbacks_t* callbacks) {
+    cb = callbacks;
     status = 0;
     data_count = 0;
 }
 
-static void process_message(uint8_t st, uint8_t d1, uint8_t d2) {
+void midi_parser_dispatch(const midi_message_t* msg) {
+    uint8_t st = msg->status;
+    uint8_t d1 = msg->data1;
+    uint8_t d2 = msg->data2;
     uint8_t command = st & 0xF0;
+    uint8_t channel = st & 0x0F;
+
+    if (cb == NULL) return;
+
+    if (st >= 0xF8) { // Real-Time: clock, start, continue, stop, ...
+        if (cb->realtime) cb->realtime(st, msg->timestamp_us);
+        return;
+    }
     
     if (command == 0x90) { // Note On
         if (d2 > 0) {
-            if (note_on_cb) note_on_cb(d1, d2);
+            if (cb->note_on) cb->note_on(channel, d1, d2);
         } else {
             // Note On with velocity 0 is Note Off
-            if (note_off_cb) note_off_cb(d1);
+            if (cb->note_off) cb->note_off(channel, d1);
         }
     } else if (command == 0x80) { // Note Off
-        if (note_off_cb) note_off_cb(d1);
+        if (cb->note_off) cb->note_off(channel, d1);
+    } else if (command == 0xA0) { // Polyphonic Key Pressure
+        if (cb->poly_pressure) cb->poly_pressure(channel, d1, d2);
+    } else if (command == 0xB0) { // Control Change
+        if (cb->control_change) cb->control_change(channel, d1, d2);
+    } else if (command == 0xC0) { // Program Change
+        if (cb->program_change) cb->program_change(channel, d1);
+    } else if (command == 0xD0) { // Channel Pressure
+        if (cb->channel_pressure) cb->channel_pressure(channel, d1);
     }
 }
 
@@ -44,53 +63,61 @@ static uint8_t get_expected_data_count(uint8_t status) {
     return 2; 
 }
 
-void midi_parser_process_byte(uint8_t byte) {
+static void complete_message(uint8_t d1, uint8_t d2, midi_message_t* msg) {
+    msg->timestamp_us = message_start_us;
+    msg->source = MIDI_SOURCE_DIN;
+    msg->status = status;
+    msg->data1 = d1;
+    msg->data2 = d2;
+}
+
+bool midi_parser_process_byte(uint8_t byte, uint32_t timestamp_us, midi_message_t* msg) {
     // Real-Time messages (0xF8 - 0xFF) can occur anywhere and should not affect running status
     if (byte >= 0xF8) {
-        return;
+        msg->timestamp_us = timestamp_us;
+        msg->source = MIDI_SOURCE_DIN;
+        msg->status = byte;
+        msg->data1 = 0;
+        msg->data2 = 0;
+        return true;
     }
 
     if (byte & 0x80) { // Status byte
         status = byte;
         data_count = 0;
+        message_start_us = timestamp_us;
+        status_fresh = true;
         
         // Handle 1-byte messages (no data bytes)
         // e.g., F6 (Tune Request). We should process immediately if we supported it.
         // For now, we just reset state.
-        
-    } else { // Data byte
-        if (status == 0) return; // Ignore data if no valid status
+        return false;
+    }
 
-        uint8_t expected = get_expected_data_count(status);
-        
-        if (expected == 0) return; // Should not happen for handled statuses
+    // Data byte
+    if (status == 0) return false; // Ignore data if no valid status
+
+    uint8_t expected = get_expected_data_count(status);
+    if (expected == 0) return false; // Should not happen for handled statuses
 
-        if (data_count == 0) {
-            data1 = byte;
-            data_count++;
-        } else if (data_count == 1) {
-            if (expected == 2) {
-                process_message(status, data1, byte);
-                data_count = 0; // Complete
-            } else {
-                // Unexpected extra byte for 1-byte data message?
-                // Treat as start of next message (Running Status)?
-                // e.g. C0 01 02 -> C0 01 (Done), C0 02 (Running Status).
-                // So if we are here (count 1), and expected was 1...
-                // We should have processed at count 1!
-            }
+    if (data_count == 0) {
+        // Under running status the first data byte starts the message
+        if (!status_fresh) {
+            message_start_us = timestamp_us;
         }
-        
-        // Re-eval logic for variable length support
-        if (data_count == expected) {
-            // If expected is 1, data1 is the byte. d2 is 0.
-            // If expected is 2, data1 is set, byte is d2.
-            uint8_t d2 = (expected == 2) ? byte : 0;
-            process_message(status, data1, d2);
-            
-            // Handle Running Status
-            // Reset data_count to 0 to capture next message
-            data_count = 0;
+        status_fresh = false;
+        data1 = byte;
+        data_count = 1;
+        if (expected == 1) {
+            complete_message(data1, 0, msg);
+            data_count = 0; // Running Status: the next data byte starts a new message
+            return true;
         }
+        return false;
     }
-}
\ No newline at end of file
+
+    // Second data byte of a 3-byte message
+    complete_message(data1, byte, msg);
+    data_count = 0; // Running Status: the next data byte starts a new message
+    return true;
+}
@@ -2,11 +2,52 @@
 #define MIDI_PARSER_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
-typedef void (*midi_note_on_callback_t)(uint8_t note, uint8_t velocity);
-typedef void (*midi_note_off_callback_t)(uint8_t note);
+// channel is 0-15
+typedef void (*midi_note_on_callback_t)(uint8_t channel, uint8_t note, uint8_t velocity);
+typedef void (*midi_note_off_callback_t)(uint8_t channel, uint8_t note);
+typedef void (*midi_control_change_callback_t)(uint8_t channel, uint8_t controller, uint8_t value);
+typedef void (*midi_program_change_callback_t)(uint8_t channel, uint8_t program);
+typedef void (*midi_channel_pressure_callback_t)(uint8_t channel, uint8_t pressure);
+typedef void (*midi_poly_pressure_callback_t)(uint8_t channel, uint8_t note, uint8_t pressure);
+// Real-Time messages keep their arrival time, the clock tracker needs it
+typedef void (*midi_realtime_callback_t)(uint8_t status, uint32_t timestamp_us);
 
-void midi_parser_init(midi_note_on_callback_t on_cb, midi_note_off_callback_t off_cb);
-void midi_parser_process_byte(uint8_t byte);
+// Any callback may be NULL if the message is not of interest
+typedef struct {
+    midi_note_on_callback_t          note_on;
+    midi_note_off_callback_t         note_off;
+    midi_control_change_callback_t   control_change;
+    midi_program_change_callback_t   program_change;
+    midi_channel_pressure_callback_t channel_pressure;
+    midi_poly_pressure_callback_t    poly_pressure;
+    midi_realtime_callback_t         realtime;
+} midi_parser_callbacks_t;
+
+typedef enum {
+    MIDI_SOURCE_DIN = 0,
+    MIDI_SOURCE_USB,
+    MIDI_SOURCE_COUNT
+} midi_source_t;
+
+// A complete MIDI message, stamped with the arrival time of its first byte
+typedef struct {
+    uint32_t timestamp_us;
+    uint8_t  source;        // midi_source_t
+    uint8_t  status;
+    uint8_t  data1;
+    uint8_t  data2;
+} midi_message_t;
+
+void midi_parser_init(const midi_parser_callbacks_t* callbacks);
+
+/* Feeds one byte of the DIN stream, read at timestamp_us. Returns true and
+ * fills msg when the byte completes a message.
+ */
+bool midi_parser_process_byte(uint8_t byte, uint32_t timestamp_us, midi_message_t* msg);
+
+// Delivers a complete message from any source to the callbacks
+void midi_parser_dispatch(const midi_message_t* msg);
 
 #endif /* MIDI_PARSER_H */
@@ -1,56 +1,185 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "midi_task.h"
-#include "semphr.h"
 #include "queue.h"
 #include "hardware/uart.h"
 #include "hardware/gpio.h"
 #include "hardware/irq.h"
 #include <stdio.h>
 #include <string.h>
-#include <math.h>
 #include "log_task.h"
 #include "audio_task.h"
 #include "app_config.h"
+#include "trace.h"
+#include "diagnostics.h"
 #include "midi_parser.h"
+#include "midi_merge.h"
+#include "midi_clock.h"
 
-static SemaphoreHandle_t xMidiRxSem = NULL;
-static QueueSetHandle_t xMidiQueueSet = NULL;
+static QueueHandle_t xMidiUsbQueue = NULL;
+static TaskHandle_t xMidiTaskHandle = NULL;
 
-static void on_note_on(uint8_t note, uint8_t velocity) {
-    float frequency = 440.0f * powf(2.0f, (note - 69) / 12.0f);
-    vAudioTaskSetFrequency(1, frequency);
+// Wake-up reasons, both sources are polled whichever is set
+#define MIDI_NOTIFY_UART    (1u << 0)
+#define MIDI_NOTIFY_USB     (1u << 1)
+
+#define MIDI_USB_QUEUE_LENGTH 32
+static StaticQueue_t xMidiUsbQueueBuffer;
+static uint8_t ucMidiUsbQueueStorage[MIDI_USB_QUEUE_LENGTH * sizeof(midi_message_t)];
+
+/* DIN bytes as the ISR drains them from the UART FIFO, each with the time
+ * its stop bit ended. The ISR only writes the head, the task the tail. */
+#define MIDI_DIN_RING_SIZE      64      // Power of two
+#define MIDI_DIN_BIT_US         (1000000u / BAUD_RATE_MIDI)
+#define MIDI_DIN_BYTE_US        (10u * MIDI_DIN_BIT_US)     // 8N1
+#define MIDI_DIN_TIMEOUT_US     (32u * MIDI_DIN_BIT_US)     // The PL011's receive timeout
+static uint8_t ucDinBytes[MIDI_DIN_RING_SIZE];
+static uint32_t ulDinStamps[MIDI_DIN_RING_SIZE];
+static volatile uint32_t ulDinHead = 0;
+static volatile uint32_t ulDinTail = 0;
+static volatile uint32_t ulDinDropped = 0;
+
+static void on_note_on(uint8_t channel, uint8_t note, uint8_t velocity) {
+    vAudioTaskPostEvent(AUDIO_EVENT_NOTE_ON, channel, note, velocity);
     
     char log_buf[32];
-    snprintf(log_buf, sizeof(log_buf), "Note On: %d", note);
+    snprintf(log_buf, sizeof(log_buf), "Note On: %d Vel: %d Ch: %d", note, velocity, channel + 1);
     log_msg(log_buf);
 }
 
-static void on_note_off(uint8_t note) {
-    vAudioTaskSetFrequency(0, 0.0f);
+static void on_note_off(uint8_t channel, uint8_t note) {
+    vAudioTaskPostEvent(AUDIO_EVENT_NOTE_OFF, channel, note, 0);
     
     char log_buf[32];
-    snprintf(log_buf, sizeof(log_buf), "Note Off: %d", note);
+    snprintf(log_buf, sizeof(log_buf), "Note Off: %d Ch: %d", note, channel + 1);
     log_msg(log_buf);
 }
 
+// Controller sweeps are not logged, they would flood the log queue
+static void on_control_change(uint8_t channel, uint8_t controller, uint8_t value) {
+    vAudioTaskPostEvent(AUDIO_EVENT_CONTROL_CHANGE, channel, controller, value);
+}
+
+static void on_program_change(uint8_t channel, uint8_t program) {
+    vAudioTaskPostEvent(AUDIO_EVENT_PROGRAM_CHANGE, channel, program, 0);
+}
+
+static void on_channel_pressure(uint8_t channel, uint8_t pressure) {
+    vAudioTaskPostEvent(AUDIO_EVENT_CHANNEL_PRESSURE, channel, pressure, 0);
+}
+
+static void on_poly_pressure(uint8_t channel, uint8_t note, uint8_t pressure) {
+    vAudioTaskPostEvent(AUDIO_EVENT_POLY_PRESSURE, channel, note, pressure);
+}
+
+static void log_tempo(const char* prefix) {
+    midi_clock_stats_t stats;
+    midi_clock_get_stats(&stats);
+
+    char log_buf[48];
+    snprintf(log_buf, sizeof(log_buf), "%s %lu.%02lu BPM, jitter %lu us",
+             prefix, stats.bpm_x100 / 100, stats.bpm_x100 % 100, stats.jitter_us);
+    log_msg(log_buf);
+}
+
+// Tempo is logged once a bar, logging every tick would flood the log queue
+static void on_realtime(uint8_t status, uint32_t timestamp_us) {
+    midi_clock_stats_t stats;
+
+    switch (status) {
+    case 0xF8:  // Timing Clock
+        midi_clock_tick(timestamp_us);
+        midi_clock_get_stats(&stats);
+        vAudioTaskPostClock(AUDIO_EVENT_CLOCK, stats.locked ? stats.period_us_q8 : 0);
+        if (stats.running && stats.locked && (stats.ticks % (4 * MIDI_CLOCK_PPQN)) == 0) {
+            log_tempo("Clock");
+        }
+        break;
+    case 0xFA:  // Start
+        midi_clock_start(timestamp_us);
+        vAudioTaskPostClock(AUDIO_EVENT_START, 0);
+        log_msg("Clock start");
+        break;
+    case 0xFB:  // Continue
+        midi_clock_continue(timestamp_us);
+        vAudioTaskPostClock(AUDIO_EVENT_CONTINUE, 0);
+        log_msg("Clock continue");
+        break;
+    case 0xFC:  // Stop
+        midi_clock_stop();
+        vAudioTaskPostClock(AUDIO_EVENT_STOP, 0);
+        log_tempo("Clock stop");
+        break;
+    default:
+        break;
+    }
+}
+
+static const midi_parser_callbacks_t midi_callbacks = {
+    .note_on          = on_note_on,
+    .note_off         = on_note_off,
+    .control_change   = on_control_change,
+    .program_change   = on_program_change,
+    .channel_pressure = on_channel_pressure,
+    .poly_pressure    = on_poly_pressure,
+    .realtime         = on_realtime,
+};
+
+/* Drains the UART FIFO and stamps the bytes. The interrupt comes at a
+ * fill level, just as the newest byte ends, or on the receive timeout,
+ * MIDI_DIN_TIMEOUT_US after it. The bytes before it ended a byte time
+ * apart, so each stamp is its arrival time rather than the drain's.
+ */
 void vMidiTaskISR(void)
 {
-    uart_set_irq_enables(UART_ID_MIDI, false, false);
+    TRACE_RECORD(TRACE_EV_ISR_ENTER, TRACE_ISR_UART_MIDI);
+    uint32_t ulLast = time_us_32();
+    if (uart_get_hw(UART_ID_MIDI)->mis & UART_UARTMIS_RTMIS_BITS) {
+        ulLast -= MIDI_DIN_TIMEOUT_US;
+    }
+
+    uint8_t ucBytes[32];    // The FIFO's depth
+    uint32_t n = 0;
+    while (n < sizeof(ucBytes) && uart_is_readable(UART_ID_MIDI)) {
+        ucBytes[n++] = uart_getc(UART_ID_MIDI);
+    }
+    uint32_t ulHead = ulDinHead;
+    for (uint32_t i = 0; i < n; i++) {
+        if (ulHead - ulDinTail == MIDI_DIN_RING_SIZE) {
+            ulDinDropped++;
+            continue;
+        }
+        ucDinBytes[ulHead & (MIDI_DIN_RING_SIZE - 1)] = ucBytes[i];
+        ulDinStamps[ulHead & (MIDI_DIN_RING_SIZE - 1)] = ulLast - (n - 1 - i) * MIDI_DIN_BYTE_US;
+        ulHead++;
+    }
+    ulDinHead = ulHead;
+
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    xSemaphoreGiveFromISR(xMidiRxSem, &xHigherPriorityTaskWoken);
+    xTaskNotifyFromISR(xMidiTaskHandle, MIDI_NOTIFY_UART, eSetBits, &xHigherPriorityTaskWoken);
+    TRACE_RECORD(TRACE_EV_ISR_EXIT, TRACE_ISR_UART_MIDI);
     portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
+void vMidiTaskPostMessage(const midi_message_t* msg)
+{
+    if (xQueueSendToBack(xMidiUsbQueue, msg, 0) != pdTRUE) {
+        log_msg("USB MIDI queue full");
+    } else if (xMidiTaskHandle != NULL) {
+        xTaskNotify(xMidiTaskHandle, MIDI_NOTIFY_USB, eSetBits);
+    }
+}
+
 void vMidiTaskInit(void)
 {
-    xMidiRxSem = xSemaphoreCreateBinary();
-    xMidiQueueSet = xQueueCreateSet(1);
-    
-    xQueueAddToSet(xMidiRxSem, xMidiQueueSet);
+    xMidiUsbQueue = xQueueCreateStatic(MIDI_USB_QUEUE_LENGTH, sizeof(midi_message_t),
+                                       ucMidiUsbQueueStorage, &xMidiUsbQueueBuffer);
+    diag_register_queue(xMidiUsbQueue, "MIDI USB");
 
-    // Initialize Parser
-    midi_parser_init(on_note_on, on_note_off);
+    // Initialize Parser and the DIN/USB merge
+    midi_parser_init(&midi_callbacks);
+    midi_merge_init();
+    midi_clock_init();
 
     // Initialize UART for MIDI communication
     gpio_set_function((uint)PIN_MIDI_TX, UART_FUNCSEL_NUM(UART_ID_MIDI, PIN_MIDI_TX));
@@ -72,25 +201,45 @@ void vMidiTaskInit(void)
 
 void vMidiTask(void *pvParameters)
 {
+    xMidiTaskHandle = xTaskGetCurrentTaskHandle();
+
     // Enable UART IRQ
     int uart_irq = (UART_ID_MIDI == uart0) ? UART0_IRQ : UART1_IRQ;
     irq_set_enabled(uart_irq, true);
     uart_set_irq_enables(UART_ID_MIDI, true, false);
     log_msg("MIDI Task Initialized");
     
+    uint32_t ulDroppedSeen = 0;
 	for( ;; )
     {
-        QueueSetMemberHandle_t xActivated = xQueueSelectFromSet(xMidiQueueSet, portMAX_DELAY); 
-        
-        if (xActivated == xMidiRxSem) {
-            xSemaphoreTake(xMidiRxSem, 0);
+        xTaskNotifyWait(0, UINT32_MAX, NULL, portMAX_DELAY);
+
+        midi_message_t msg;
+
+        // DIN bytes with the stamps the ISR gave them
+        uint32_t ulTail = ulDinTail;
+        uint32_t ulHead = ulDinHead;
+        while (ulTail != ulHead) {
+            uint32_t i = ulTail & (MIDI_DIN_RING_SIZE - 1);
+            if (midi_parser_process_byte(ucDinBytes[i], ulDinStamps[i], &msg)) {
+                midi_merge_push(&msg);
+            }
+            ulTail++;
+        }
+        ulDinTail = ulTail;
+        if (ulDinDropped != ulDroppedSeen) {
+            ulDroppedSeen = ulDinDropped;
+            log_msg("DIN MIDI ring full");
+        }
+
+        // Collect whatever USB has delivered meanwhile
+        while (xQueueReceive(xMidiUsbQueue, &msg, 0) == pdTRUE) {
+            midi_merge_push(&msg);
         }
 
-        // Read MIDI data
-        while (uart_is_readable(UART_ID_MIDI)) {
-            uint8_t byte = uart_getc(UART_ID_MIDI);
-            midi_parser_process_byte(byte);
+        // Deliver both sources in timestamp order
+        while (midi_merge_pop(&msg)) {
+            midi_parser_dispatch(&msg);
         }
-        uart_set_irq_enables(UART_ID_MIDI, true, false);
     }
 }
\ No newline at end of file
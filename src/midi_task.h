@@ -3,8 +3,12 @@
 
 #include "FreeRTOS.h"
 #include "task.h"
+#include "midi_parser.h"
 
 void vMidiTaskInit(void);
 void vMidiTask(void *pvParameters);
 
+// Queues a message from another input (USB) for merging with the DIN stream
+void vMidiTaskPostMessage(const midi_message_t* msg);
+
 #endif // MIDI_TASK_H
\ No newline at end of file
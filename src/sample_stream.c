@@ -0,0 +1,371 @@
+#include "sample_stream.h"
+#include "app_config.h"
+#include <string.h>
+
+#if PICO_ON_DEVICE
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/structs/xip_ctrl.h"
+#include "hardware/regs/addressmap.h"
+#include "pico/time.h"
+#endif
+
+#define RING_MASK           (SAMPLE_STREAM_RING_FRAMES - 1)
+
+// Largest transfer, so a newly started voice never queues behind a long one
+#define STREAM_CHUNK_FRAMES 256
+
+/* Frames a start copies in: every block the audio task renders back to
+ * back, AUDIO_BUFFER_COUNT - 1 of them, at the top step. Limited by the
+ * ring, and even so the DMA carries on in whole words */
+#define STREAM_PREFILL_WANT ((SAMPLE_STREAM_MAX_STEP >> 16) * AUDIO_BUFFER_FRAMES * (AUDIO_BUFFER_COUNT - 1) + 2)
+#define STREAM_PREFILL_FRAMES \
+    ((STREAM_PREFILL_WANT < SAMPLE_STREAM_RING_FRAMES - 2) ? STREAM_PREFILL_WANT : SAMPLE_STREAM_RING_FRAMES - 2)
+
+/* Each zone's first STREAM_PREFILL_FRAMES, unrolled through its loop, held
+ * in SRAM from init so a start never reads flash */
+static int16_t __attribute__((aligned(4))) heads[SAMPLE_STREAM_MAX_ZONES][STREAM_PREFILL_FRAMES];
+static uint32_t head_frames[SAMPLE_STREAM_MAX_ZONES];
+
+/* A block at the top step reads 2 * AUDIO_BUFFER_FRAMES + 1 frames past the
+ * position, all of which must have been asked for by the previous refill */
+_Static_assert(SAMPLE_STREAM_RING_FRAMES - 2 > (SAMPLE_STREAM_MAX_STEP >> 16) * AUDIO_BUFFER_FRAMES + 2,
+               "sample stream ring too small for a block at the top step");
+
+typedef struct {
+    const synth_sample_zone_t* zone;
+    uint32_t pos;               // Frame the kernel reads next
+    uint32_t frac;              // Q16 between pos and pos + 1
+    uint32_t fetched;           // Frames queued to the ring, advanced as a transfer starts
+    volatile uint32_t landed;   // Frames in the ring, advanced as a transfer completes
+    volatile uint32_t want;     // The refill target
+    uint8_t epoch;              // Bumped on start so a stale transfer's completion is dropped
+} stream_t;
+
+static stream_t streams[SAMPLE_STREAM_COUNT];
+static int16_t __attribute__((aligned(4))) rings[SAMPLE_STREAM_COUNT][SAMPLE_STREAM_RING_FRAMES];
+
+static uint8_t next_stream = 0;
+static uint32_t misses = 0;
+static uint32_t bandwidth = 0;
+
+#if PICO_ON_DEVICE
+static int dma_ch;
+
+// The transfer in flight, if any
+static volatile int busy_stream = -1;
+static uint32_t busy_end;
+static uint8_t busy_epoch;
+
+#define STREAM_LOCK()       uint32_t irq_state = save_and_disable_interrupts()
+#define STREAM_UNLOCK()     restore_interrupts(irq_state)
+#else
+#define STREAM_LOCK()
+#define STREAM_UNLOCK()
+#endif
+
+/* Maps an unrolled frame back into the zone */
+static uint32_t source_frame(const synth_sample_zone_t* z, uint32_t u) {
+    if (z->loop_end == 0 || u < z->loop_end) {
+        return u;
+    }
+    return z->loop_start + (u - z->loop_start) % (z->loop_end - z->loop_start);
+}
+
+/* Frames of the stream's next transfer and their zone offset, 0 when it has
+ * all it wants. A transfer never crosses the ring wrap or the loop end, so
+ * it is one contiguous read into one contiguous write. Every bound is even,
+ * so transfers are whole words.
+ */
+static uint32_t next_chunk(const stream_t* st, uint32_t* src) {
+    const synth_sample_zone_t* z = st->zone;
+    if (z == NULL) return 0;
+    int32_t wanted = (int32_t)(st->want - st->fetched);
+    if (wanted <= 0) return 0;
+
+    uint32_t s = source_frame(z, st->fetched);
+    uint32_t end = z->loop_end ? z->loop_end : z->length;
+    if (s >= end) return 0;
+
+    uint32_t n = end - s;
+    if (n > (uint32_t)wanted) n = (uint32_t)wanted;
+    uint32_t ring_left = SAMPLE_STREAM_RING_FRAMES - (st->fetched & RING_MASK);
+    if (n > ring_left) n = ring_left;
+    if (n > STREAM_CHUNK_FRAMES) n = STREAM_CHUNK_FRAMES;
+    *src = s;
+    return n;
+}
+
+#if PICO_ON_DEVICE
+static void stream_words(const void* src, void* dst, uint32_t words, bool start) {
+    xip_ctrl_hw->stream_addr = (uint32_t)src;
+    xip_ctrl_hw->stream_ctr  = words;
+    dma_channel_set_write_addr(dma_ch, dst, false);
+    dma_channel_set_trans_count(dma_ch, words, start);
+}
+
+static void start_transfer(int s, uint32_t src, uint32_t n) {
+    stream_t* st = &streams[s];
+    busy_stream = s;
+    busy_epoch  = st->epoch;
+    stream_words(&st->zone->data[src], &rings[s][st->fetched & RING_MASK], n / 2, true);
+    st->fetched += n;
+    busy_end = st->fetched;
+}
+
+/* Drops the transfer in flight and empties the streaming FIFO after it,
+ * so a start can write its ring. Called with interrupts disabled.
+ */
+static void abort_transfer(void) {
+    dma_channel_set_irq1_enabled(dma_ch, false);
+    dma_channel_abort(dma_ch);
+    dma_hw->ints1 = 1u << dma_ch;
+    dma_channel_set_irq1_enabled(dma_ch, true);
+    xip_ctrl_hw->stream_ctr = 0;
+    while (!(xip_ctrl_hw->stat & XIP_STAT_FIFO_EMPTY_BITS)) {
+        (void)xip_ctrl_hw->stream_fifo;
+    }
+    busy_stream = -1;
+}
+#else
+// The host has no streaming FIFO, a transfer completes as it starts
+static void start_transfer(int s, uint32_t src, uint32_t n) {
+    stream_t* st = &streams[s];
+    memcpy(&rings[s][st->fetched & RING_MASK], &st->zone->data[src], n * sizeof(int16_t));
+    st->fetched += n;
+    st->landed = st->fetched;
+}
+#endif
+
+/* Starts the next transfer, taking the streams in turn. Returns false when
+ * none of them wants more.
+ */
+static bool kick_one(void) {
+    for (int i = 0; i < SAMPLE_STREAM_COUNT; i++) {
+        int s = (next_stream + i) % SAMPLE_STREAM_COUNT;
+        uint32_t src;
+        uint32_t n = next_chunk(&streams[s], &src);
+        if (n != 0) {
+            next_stream = (uint8_t)((s + 1) % SAMPLE_STREAM_COUNT);
+            start_transfer(s, src, n);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Called with interrupts disabled on the device
+static void kick(void) {
+#if PICO_ON_DEVICE
+    if (busy_stream < 0) {
+        kick_one();
+    }
+#else
+    while (kick_one()) {
+    }
+#endif
+}
+
+#if PICO_ON_DEVICE
+static void stream_dma_handler(void) {
+    dma_hw->ints1 = 1u << dma_ch;
+    stream_t* st = &streams[busy_stream];
+    if (st->epoch == busy_epoch) {
+        st->landed = busy_end;
+    }
+    busy_stream = -1;
+    kick_one();
+}
+
+/* Streams the largest zone through the first ring, one blocking transfer
+ * at a time, and returns the rate in bytes per second. This is the flash
+ * side of the budget: the voices it can feed at a given playback step is
+ * bandwidth / (2 bytes * step * sample rate).
+ */
+static uint32_t measure_bandwidth(void) {
+    const synth_sample_zone_t* z = &synth_sample_zones[0];
+    for (uint8_t i = 1; i < synth_sample_zone_count; i++) {
+        if (synth_sample_zones[i].length > z->length) z = &synth_sample_zones[i];
+    }
+
+    uint32_t start = time_us_32();
+    uint32_t done = 0;
+    while (done < z->length) {
+        uint32_t n = z->length - done;
+        if (n > SAMPLE_STREAM_RING_FRAMES) n = SAMPLE_STREAM_RING_FRAMES;
+        stream_words(&z->data[done], rings[0], n / 2, true);
+        dma_channel_wait_for_finish_blocking(dma_ch);
+        done += n;
+    }
+    uint32_t us = time_us_32() - start;
+    return us ? (uint32_t)(((uint64_t)done * sizeof(int16_t) * 1000000u) / us) : 0;
+}
+#endif
+
+/* Copies the frames a start puts in the ring, as the transfers would
+ * fetch them, into the zone's head.
+ */
+static void load_head(uint8_t i) {
+    stream_t pre = { .zone = &synth_sample_zones[i], .want = STREAM_PREFILL_FRAMES };
+    uint32_t src;
+    uint32_t n;
+    while ((n = next_chunk(&pre, &src)) != 0) {
+        memcpy(&heads[i][pre.fetched], &pre.zone->data[src], n * sizeof(int16_t));
+        pre.fetched += n;
+    }
+    head_frames[i] = pre.fetched;
+}
+
+void sample_stream_init(void) {
+    for (int s = 0; s < SAMPLE_STREAM_COUNT; s++) {
+        memset(&streams[s], 0, sizeof(streams[s]));
+    }
+    next_stream = 0;
+    misses = 0;
+
+#if PICO_ON_DEVICE
+    if (synth_sample_zone_count > SAMPLE_STREAM_MAX_ZONES) {
+        panic("%u sample zones, SAMPLE_STREAM_MAX_ZONES is %u", synth_sample_zone_count, SAMPLE_STREAM_MAX_ZONES);
+    }
+#endif
+    for (uint8_t i = 0; i < synth_sample_zone_count && i < SAMPLE_STREAM_MAX_ZONES; i++) {
+        load_head(i);
+    }
+
+#if PICO_ON_DEVICE
+    busy_stream = -1;
+
+    // Word reads from the streaming FIFO, paced by its DREQ, into the ring
+    dma_ch = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(dma_ch);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_dreq(&c, DREQ_XIP_STREAM);
+    dma_channel_configure(dma_ch, &c, NULL, (const void*)XIP_AUX_BASE, 0, false);
+
+    bandwidth = measure_bandwidth();
+
+    // DMA_IRQ_0 belongs to the I2S ring. The measurement left the channel's
+    // raw interrupt set, clear it before enabling
+    dma_hw->ints1 = 1u << dma_ch;
+    dma_channel_set_irq1_enabled(dma_ch, true);
+    irq_set_exclusive_handler(DMA_IRQ_1, stream_dma_handler);
+    irq_set_enabled(DMA_IRQ_1, true);
+#endif
+}
+
+uint32_t sample_stream_get_bandwidth(void) {
+    return bandwidth;
+}
+
+void sample_stream_start(uint8_t s, const synth_sample_zone_t* zone) {
+    stream_t* st = &streams[s];
+    size_t i = (size_t)(zone - synth_sample_zones);
+    {
+        STREAM_LOCK();
+#if PICO_ON_DEVICE
+        // The old zone's transfer would land in the head copied in below
+        if (busy_stream == s) {
+            abort_transfer();
+        }
+#endif
+        st->zone = NULL;
+        st->epoch++;
+        STREAM_UNLOCK();
+    }
+
+    // The head is copied from SRAM, so the blocks rendered ahead of the
+    // first transfer find it in the ring. The stream has no zone meanwhile,
+    // so no transfer is started into it.
+    memcpy(rings[s], heads[i], head_frames[i] * sizeof(int16_t));
+
+    {
+        STREAM_LOCK();
+        st->zone    = zone;
+        st->pos     = 0;
+        st->frac    = 0;
+        st->fetched = head_frames[i];
+        st->landed  = head_frames[i];
+        STREAM_UNLOCK();
+    }
+    sample_stream_refill(s);
+}
+
+void sample_stream_stop(uint8_t s) {
+    STREAM_LOCK();
+    streams[s].zone = NULL;
+    streams[s].epoch++;
+    STREAM_UNLOCK();
+}
+
+bool __not_in_flash_func(sample_stream_accumulate)(uint8_t s, int32_t* mix, size_t num_frames, uint32_t step, int32_t gain, int32_t gain_step) {
+    stream_t* st = &streams[s];
+    const synth_sample_zone_t* z = st->zone;
+    bool playing = true;
+
+    if (step > SAMPLE_STREAM_MAX_STEP) step = SAMPLE_STREAM_MAX_STEP;
+
+    // A one-shot zone ends on the last frame its interpolation pair fits in
+    if (z->loop_end == 0) {
+        if (st->pos + 1 >= z->length) return false;
+        uint64_t room = ((uint64_t)(z->length - 1 - st->pos) << 16) - st->frac;
+        uint64_t fit = (room + step - 1) / step;
+        if (fit < num_frames) {
+            num_frames = (size_t)fit;
+            playing = false;
+        }
+    }
+    if (num_frames == 0) return playing;
+
+    // The last frame this call reads must have landed. If a transfer is
+    // late, play the frames it covers and leave the rest silent: the voice
+    // carries on from there next block, a little behind.
+    uint32_t last = st->pos + (uint32_t)(((uint64_t)st->frac + (uint64_t)step * (num_frames - 1)) >> 16) + 1;
+    if ((int32_t)(st->landed - last) <= 0) {
+        misses++;
+        int32_t ahead = (int32_t)(st->landed - st->pos) - 1;
+        if (ahead <= 0 || ((uint64_t)ahead << 16) <= st->frac) return playing;
+        size_t fit = (size_t)((((uint64_t)ahead << 16) - st->frac - 1) / step) + 1;
+        if (fit < num_frames) num_frames = fit;
+    }
+
+    const int16_t* ring = rings[s];
+    uint32_t pos = st->pos;
+    uint32_t frac = st->frac;
+    for (size_t i = 0; i < num_frames; i++) {
+        int32_t a = ring[pos & RING_MASK];
+        int32_t b = ring[(pos + 1) & RING_MASK];
+        int32_t x = a + (((b - a) * (int32_t)(frac >> 1)) >> 15);
+        mix[i] += (x * gain) >> 15;
+        gain += gain_step;
+        frac += step;
+        pos += frac >> 16;
+        frac &= 0xFFFF;
+    }
+    st->pos = pos;
+    st->frac = frac;
+    return playing;
+}
+
+void sample_stream_refill(uint8_t s) {
+    stream_t* st = &streams[s];
+    const synth_sample_zone_t* z = st->zone;
+    if (z == NULL) return;
+
+    // Keep the ring full short of the frame under the kernel, in whole words
+    uint32_t want = (st->pos + SAMPLE_STREAM_RING_FRAMES - 2) & ~1u;
+    if (z->loop_end == 0 && want > z->length) want = z->length;
+
+    STREAM_LOCK();
+    st->want = want;
+    kick();
+    STREAM_UNLOCK();
+}
+
+uint32_t sample_stream_take_misses(void) {
+    uint32_t n = misses;
+    misses = 0;
+    return n;
+}
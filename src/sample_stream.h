@@ -0,0 +1,64 @@
+#ifndef SAMPLE_STREAM_H
+#define SAMPLE_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "pico.h"
+#include "synth_samples.h"
+
+/* Streams sample zones out of flash for the sample voices.
+ *
+ * Each stream owns an SRAM ring that one DMA channel keeps filled ahead of
+ * the playback position through the XIP streaming FIFO, which reads flash
+ * in the XIP controller's idle cycles without going through (or evicting)
+ * the XIP cache. The render kernel only ever reads the ring, so the audio
+ * path never waits on a flash access. Each zone's first frames, enough
+ * for every block rendered ahead before the DMA catches up, stay in SRAM
+ * from init and a start copies them into the ring, so the DMA streams only
+ * the rest. If a transfer is still late, the kernel plays what has
+ * landed, leaves the rest of the block silent and counts a prefetch miss.
+ *
+ * Positions count frames from the start of the zone with the loop
+ * unrolled, so the ring just follows them and only the fetch side maps a
+ * position back into the zone. Transfers are served round-robin from the
+ * DMA completion interrupt, which must be on the core that renders.
+ */
+
+#define SAMPLE_STREAM_COUNT         16      // One per synth voice
+#define SAMPLE_STREAM_MAX_ZONES     16      // Zones with a resident head, about 1 KB each, 2 KB with 8 buffers
+#define SAMPLE_STREAM_RING_BITS     10
+#define SAMPLE_STREAM_RING_FRAMES   (1u << SAMPLE_STREAM_RING_BITS)
+
+// Playback step limit, Q16. Zones are played at most an octave above their root.
+#define SAMPLE_STREAM_MAX_STEP      (2u << 16)
+
+/* Copies each zone's head into SRAM, claims the DMA channel, measures the
+ * flash streaming bandwidth and installs the completion interrupt on the
+ * calling core.
+ */
+void sample_stream_init(void);
+
+// Streaming bandwidth measured at init in bytes per second, 0 on the host
+uint32_t sample_stream_get_bandwidth(void);
+
+/* Restarts stream s at the beginning of zone: copies in the zone's head,
+ * the frames the blocks rendered ahead will read, and queues the rest of
+ * the fill. A transfer still in flight for the previous zone is aborted.
+ */
+void sample_stream_start(uint8_t s, const synth_sample_zone_t* zone);
+void sample_stream_stop(uint8_t s);
+
+/* Adds num_frames of stream s, linearly interpolated at a Q16 step per
+ * frame, into mix with a Q15 gain ramp. Returns false once a one-shot zone
+ * has played out.
+ */
+bool sample_stream_accumulate(uint8_t s, int32_t* mix, size_t num_frames, uint32_t step, int32_t gain, int32_t gain_step);
+
+// Asks for the ring to be filled ahead of the new playback position
+void sample_stream_refill(uint8_t s);
+
+// Prefetch misses since the last call
+uint32_t sample_stream_take_misses(void);
+
+#endif /* SAMPLE_STREAM_H */
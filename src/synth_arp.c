@@ -0,0 +1,235 @@
+#include "synth_arp.h"
+#include "midi_clock.h"
+
+typedef enum {
+    SYNC_INTERNAL = 0,  // No MIDI Start seen, free-run on the internal tempo
+    SYNC_RUNNING,       // Locked to the external clock
+    SYNC_STOPPED,       // External transport stopped
+} sync_state_t;
+
+static uint32_t sample_rate = 48000;
+static uint8_t arp_part = SYNTH_ARP_NONE;
+static synth_arp_mode_t mode = SYNTH_ARP_UP;
+static uint8_t ticks_per_step = 6;  // 1/16 notes at 24 PPQN
+
+static uint8_t held_notes[SYNTH_ARP_MAX_NOTES];    // Ascending
+static uint8_t held_velocity[SYNTH_ARP_MAX_NOTES];
+static uint8_t held_count = 0;
+
+static sync_state_t sync = SYNC_INTERNAL;
+static uint32_t tick_frames_q16 = 0;    // Render frames per clock tick
+static uint32_t tick_phase_q16 = 0;     // Frames into the current tick
+static uint32_t ticks = 0;              // Index of the next tick to play
+static uint32_t ext_ticks = 0;          // Clock ticks received since Start
+
+static int step_index = 0;
+static int step_dir = 1;
+static uint8_t sounding_note = 0;
+static bool sounding = false;
+static uint32_t gate_off_tick = 0;
+
+static uint32_t period_to_tick_frames(uint32_t period_us_q8) {
+    return (uint32_t)(((uint64_t)period_us_q8 * sample_rate * 256) / 1000000u);
+}
+
+static void set_internal_tempo(void) {
+    uint32_t period_q8 = (uint32_t)((60000000ull << 8) / (SYNTH_ARP_DEFAULT_BPM * MIDI_CLOCK_PPQN));
+    tick_frames_q16 = period_to_tick_frames(period_q8);
+}
+
+void synth_arp_init(uint32_t rate) {
+    sample_rate = rate;
+    arp_part = SYNTH_ARP_NONE;
+    held_count = 0;
+    sounding = false;
+    sync = SYNC_INTERNAL;
+    ticks = 0;
+    ext_ticks = 0;
+    tick_phase_q16 = 0;
+    set_internal_tempo();
+}
+
+void synth_arp_set_sample_rate(uint32_t rate) {
+    if (rate == 0 || rate == sample_rate) return;
+    tick_frames_q16 = (uint32_t)(((uint64_t)tick_frames_q16 * rate) / sample_rate);
+    tick_phase_q16  = (uint32_t)(((uint64_t)tick_phase_q16 * rate) / sample_rate);
+    sample_rate = rate;
+}
+
+void synth_arp_set_part(uint8_t part) {
+    arp_part = part;
+    held_count = 0;
+}
+
+uint8_t synth_arp_get_part(void) {
+    return arp_part;
+}
+
+void synth_arp_set_mode(synth_arp_mode_t m) {
+    if (m < SYNTH_ARP_MODE_COUNT) mode = m;
+}
+
+void synth_arp_set_ticks_per_step(uint8_t t) {
+    if (t > 0) ticks_per_step = t;
+}
+
+void synth_arp_note_on(uint8_t note, uint8_t velocity) {
+    if (held_count >= SYNTH_ARP_MAX_NOTES) return;
+
+    int i = 0;
+    while (i < held_count && held_notes[i] < note) i++;
+    if (i < held_count && held_notes[i] == note) {
+        held_velocity[i] = velocity;
+        return;
+    }
+    for (int j = held_count; j > i; j--) {
+        held_notes[j] = held_notes[j - 1];
+        held_velocity[j] = held_velocity[j - 1];
+    }
+    held_notes[i] = note;
+    held_velocity[i] = velocity;
+    held_count++;
+}
+
+void synth_arp_note_off(uint8_t note) {
+    for (int i = 0; i < held_count; i++) {
+        if (held_notes[i] == note) {
+            for (int j = i; j < held_count - 1; j++) {
+                held_notes[j] = held_notes[j + 1];
+                held_velocity[j] = held_velocity[j + 1];
+            }
+            held_count--;
+            return;
+        }
+    }
+}
+
+void synth_arp_clock_tick(uint32_t period_us_q8) {
+    if (sync != SYNC_RUNNING) return;
+    ext_ticks++;
+    if (period_us_q8 != 0) {
+        tick_frames_q16 = period_to_tick_frames(period_us_q8);
+    }
+}
+
+void synth_arp_clock_start(void) {
+    sync = SYNC_RUNNING;
+    ticks = 0;
+    ext_ticks = 0;
+    tick_phase_q16 = tick_frames_q16;   // Bar one starts with the next block
+    step_index = 0;
+    step_dir = 1;
+}
+
+// Resumes from the stopped position instead of bar one
+void synth_arp_clock_continue(void) {
+    sync = SYNC_RUNNING;
+    ext_ticks = ticks;
+    tick_phase_q16 = 0;
+}
+
+void synth_arp_clock_stop(void) {
+    sync = SYNC_STOPPED;
+}
+
+static int next_step(void) {
+    if (held_count == 1) {
+        step_index = 0;
+        return 0;
+    }
+    if (step_index >= held_count) step_index = 0;
+
+    int idx;
+    switch (mode) {
+    case SYNTH_ARP_DOWN:
+        idx = held_count - 1 - step_index;
+        step_index = (step_index + 1) % held_count;
+        break;
+    case SYNTH_ARP_UP_DOWN:
+        idx = step_index;
+        if (step_index + step_dir < 0 || step_index + step_dir >= held_count) step_dir = -step_dir;
+        step_index += step_dir;
+        break;
+    case SYNTH_ARP_UP:
+    default:
+        idx = step_index;
+        step_index = (step_index + 1) % held_count;
+        break;
+    }
+    return idx;
+}
+
+static size_t push_event(synth_arp_event_t* events, size_t count, size_t max_events,
+                         size_t offset, uint8_t on, uint8_t note, uint8_t velocity) {
+    if (count >= max_events) return count;
+    events[count].offset = (uint16_t)offset;
+    events[count].note_on = on;
+    events[count].note = note;
+    events[count].velocity = velocity;
+    return count + 1;
+}
+
+static size_t on_tick(uint32_t tick, size_t offset, synth_arp_event_t* events, size_t count, size_t max_events) {
+    if (sounding && tick == gate_off_tick) {
+        count = push_event(events, count, max_events, offset, 0, sounding_note, 0);
+        sounding = false;
+    }
+
+    if ((tick % ticks_per_step) != 0 || held_count == 0) {
+        return count;
+    }
+
+    if (sounding) {
+        count = push_event(events, count, max_events, offset, 0, sounding_note, 0);
+    }
+    int idx = next_step();
+    sounding_note = held_notes[idx];
+    sounding = true;
+    gate_off_tick = tick + ((ticks_per_step > 1) ? ticks_per_step / 2 : 1);
+    return push_event(events, count, max_events, offset, 1, sounding_note, held_velocity[idx]);
+}
+
+size_t synth_arp_render(size_t num_frames, synth_arp_event_t* events, size_t max_events) {
+    size_t count = 0;
+
+    if (arp_part == SYNTH_ARP_NONE) {
+        return 0;
+    }
+
+    // Transport stopped or nothing held: silence the current step
+    if (sync == SYNC_STOPPED || held_count == 0) {
+        if (sounding) {
+            count = push_event(events, count, max_events, 0, 0, sounding_note, 0);
+            sounding = false;
+        }
+        if (sync == SYNC_STOPPED) return count;
+    }
+
+    // Fell behind the external clock (e.g. it jumped), skip ahead
+    if (sync == SYNC_RUNNING && (int32_t)(ext_ticks - ticks) > 1) {
+        ticks = ext_ticks - 1;
+    }
+
+    size_t pos = 0;
+    for (;;) {
+        uint32_t remaining_q16 = (tick_frames_q16 > tick_phase_q16) ? tick_frames_q16 - tick_phase_q16 : 0;
+        size_t frames_to_tick = (remaining_q16 + 0xFFFF) >> 16;
+
+        if (pos + frames_to_tick >= num_frames) {
+            tick_phase_q16 += (uint32_t)(num_frames - pos) << 16;
+            break;
+        }
+
+        // Never run more than one tick ahead of the received clock
+        if (sync == SYNC_RUNNING && (int32_t)(ticks - ext_ticks) > 0) {
+            tick_phase_q16 = tick_frames_q16;
+            break;
+        }
+
+        pos += frames_to_tick;
+        tick_phase_q16 = tick_phase_q16 + ((uint32_t)frames_to_tick << 16) - tick_frames_q16;
+        count = on_tick(ticks, pos, events, count, max_events);
+        ticks++;
+    }
+    return count;
+}
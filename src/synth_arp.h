@@ -0,0 +1,61 @@
+#ifndef SYNTH_ARP_H
+#define SYNTH_ARP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Tempo-locked arpeggiator.
+ *
+ * The arpeggiator keeps its own tick clock in render frames, so the notes
+ * it plays land on exact sample offsets within the block being rendered.
+ * With no external clock it free-runs at SYNTH_ARP_DEFAULT_BPM. Once MIDI
+ * Start has been received, the tick length follows the clock tracker's
+ * filtered period and ticks are never allowed to run more than one ahead
+ * of the received clock, so the arpeggiator cannot drift from the master.
+ */
+
+#define SYNTH_ARP_NONE          0xFF
+#define SYNTH_ARP_MAX_NOTES     16
+#define SYNTH_ARP_DEFAULT_BPM   120
+
+typedef enum {
+    SYNTH_ARP_UP = 0,
+    SYNTH_ARP_DOWN,
+    SYNTH_ARP_UP_DOWN,
+    SYNTH_ARP_MODE_COUNT
+} synth_arp_mode_t;
+
+typedef struct {
+    uint16_t offset;    // Frame within the block
+    uint8_t  note_on;
+    uint8_t  note;
+    uint8_t  velocity;
+} synth_arp_event_t;
+
+void synth_arp_init(uint32_t sample_rate);
+// Rescales the tick length and position, the pattern carries on in time
+void synth_arp_set_sample_rate(uint32_t sample_rate);
+
+// Binds the arpeggiator to a part, or SYNTH_ARP_NONE to turn it off
+void synth_arp_set_part(uint8_t part);
+uint8_t synth_arp_get_part(void);
+void synth_arp_set_mode(synth_arp_mode_t mode);
+void synth_arp_set_ticks_per_step(uint8_t ticks);
+
+// Held notes of the bound part
+void synth_arp_note_on(uint8_t note, uint8_t velocity);
+void synth_arp_note_off(uint8_t note);
+
+// External clock, period_us_q8 is the clock tracker's filtered tick period
+void synth_arp_clock_tick(uint32_t period_us_q8);
+void synth_arp_clock_start(void);
+void synth_arp_clock_continue(void);
+void synth_arp_clock_stop(void);
+
+/* Advances the arpeggiator by num_frames and writes the note events that
+ * fall inside the block, in time order. Returns the number of events.
+ */
+size_t synth_arp_render(size_t num_frames, synth_arp_event_t* events, size_t max_events);
+
+#endif /* SYNTH_ARP_H */
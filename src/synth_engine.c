@@ -1,45 +1,812 @@
 #include "synth_engine.h"
-#include "sine.h"
+#include "synth_osc.h"
+#include "synth_fm.h"
+#include "synth_string.h"
+#include "synth_unison.h"
+#include "synth_tables.h"
+#include "synth_presets.h"
+#include "synth_samples.h"
+#include "sample_stream.h"
 #include "app_config.h"
+#include "pico/time.h"
+#include <string.h>
 
-static float phase = 0;
-static float freq = 440.0f; // Default frequency A4
-static uint8_t note_is_on = 0;
+/* Voice state, kept as a structure of arrays so the render loop walks one
+ * voice at a time with only that voice's phase, increment and gain live.
+ * The pool is shared by all parts.
+ */
+static uint32_t voice_phase[SYNTH_MAX_VOICES];
+static uint32_t voice_increment[SYNTH_MAX_VOICES];
+static int32_t  voice_gain[SYNTH_MAX_VOICES];       // Q15 gain reached at the end of the last block
+static int32_t  voice_velocity[SYNTH_MAX_VOICES];   // Q15 velocity gain
+static int32_t  voice_pressure[SYNTH_MAX_VOICES];   // Smoothed poly pressure, Q15
+static int32_t  voice_pressure_target[SYNTH_MAX_VOICES];
+static uint32_t voice_age[SYNTH_MAX_VOICES];
+static uint8_t  voice_note[SYNTH_MAX_VOICES];
+static uint8_t  voice_part[SYNTH_MAX_VOICES];
+static uint8_t  voice_active[SYNTH_MAX_VOICES];
+static uint8_t  voice_gate[SYNTH_MAX_VOICES];
+static uint8_t  voice_sustained[SYNTH_MAX_VOICES];  // Released while the sustain pedal was down
+static uint16_t voice_drive[SYNTH_MAX_VOICES];      // Q8 saturator drive, 0 for a plain sine, chosen at note on
+static uint8_t  voice_oversample[SYNTH_MAX_VOICES]; // Renders through the 2x path, chosen at note on
+static int16_t  voice_os_history[SYNTH_MAX_VOICES][SYNTH_OSC_2X_HISTORY];
+static const synth_sample_zone_t* voice_zone[SYNTH_MAX_VOICES];    // Sample voices only, chosen at note on
+static uint32_t voice_sample_base[SYNTH_MAX_VOICES];   // Phase increment that plays the zone at step 1.0
+static const synth_fm_patch_t* voice_fm_patch[SYNTH_MAX_VOICES];  // FM voices only, chosen at note on
+static synth_fm_voice_t voice_fm[SYNTH_MAX_VOICES];
+static int8_t   voice_string[SYNTH_MAX_VOICES];     // Delay line slot of a string voice, -1 otherwise
+static const synth_string_patch_t* voice_string_patch[SYNTH_MAX_VOICES];
+static uint8_t  voice_tail[SYNTH_MAX_VOICES];       // Fades out by itself after release: FM envelopes, string decay
+static const synth_unison_patch_t* voice_unison_patch[SYNTH_MAX_VOICES];  // Unison voices only, chosen at note on
+static synth_unison_voice_t voice_unison[SYNTH_MAX_VOICES];
+
+_Static_assert(SAMPLE_STREAM_COUNT >= SYNTH_MAX_VOICES, "one sample stream per voice");
+
+static uint32_t note_counter = 0;
+
+// Set by the overload governor
+static synth_cost_tier_t cost_tier = SYNTH_TIER_FULL;
+static uint8_t voice_budget = SYNTH_MAX_VOICES;
+
+// Phase increment of MIDI note 0 at the current sample rate
+static uint32_t base_increment = 0;
+static uint32_t output_rate = AUDIO_SAMPLE_RATE;
+static uint32_t nominal_rate = AUDIO_SAMPLE_RATE;
+static int32_t  rate_drift_ppm = 0;
+static int32_t  fm_env_rate = 0;
+
+/* Channel controllers. Targets are set from MIDI, the current values chase
+ * them once per sub-block.
+ */
+typedef struct {
+    int32_t target;
+    int32_t current;
+} smoothed_param_t;
+
+typedef struct {
+    synth_part_config_t config;
+    const synth_preset_t* preset;
+    int32_t pan_left;               // Q15 constant power pan gains
+    int32_t pan_right;
+    smoothed_param_t volume;        // CC7, Q15
+    smoothed_param_t expression;    // CC11, Q15
+    smoothed_param_t mod_wheel;     // CC1, Q15
+    smoothed_param_t pressure;      // Channel pressure, Q15
+    uint8_t sustain_down;           // CC64
+    uint8_t voice_count;
+} synth_part_t;
+
+static synth_part_t parts[SYNTH_MAX_PARTS];
+
+/* Each part renders into part_mix, which is then panned onto its output
+ * bus. Unison voices add their stereo spread into part_side, which is only
+ * cleared and mixed for parts that have one playing.
+ */
+static int32_t part_mix[AUDIO_BUFFER_FRAMES];
+static int32_t part_side[AUDIO_BUFFER_FRAMES];
+static bool part_side_used;
+static int32_t mix_left[SYNTH_OUTPUT_BUSES][AUDIO_BUFFER_FRAMES];
+static int32_t mix_right[SYNTH_OUTPUT_BUSES][AUDIO_BUFFER_FRAMES];
+
+// Per sub-block values for the part being rendered
+#define SUBBLOCKS_PER_BLOCK ((AUDIO_BUFFER_FRAMES + SYNTH_SUBBLOCK_FRAMES - 1) / SYNTH_SUBBLOCK_FRAMES)
+static int32_t subblock_gain[SUBBLOCKS_PER_BLOCK];
+static int32_t subblock_vibrato[SUBBLOCKS_PER_BLOCK];   // Q15 LFO * channel depth
+static int32_t subblock_lfo[SUBBLOCKS_PER_BLOCK];       // Q15 LFO for poly pressure depth
+
+static uint32_t lfo_phase = 0;
+static uint32_t lfo_increment = 0;
+
+static synth_engine_stats_t stats;
+
+// One-pole smoothing per sub-block: cur += (target - cur) >> SMOOTH_SHIFT
+#define SYNTH_SMOOTH_SHIFT      2
+
+#define SYNTH_VIBRATO_HZ        5.5f
+
+#define Q15_ONE                 32768
+
+/* 7-bit MIDI value to a Q15 gain on a squared curve */
+static int32_t midi_to_gain(uint8_t value) {
+    return ((int32_t)value * value * Q15_ONE) / (127 * 127);
+}
+
+/* Steps are per full sub-block. A short sub-block, the end of a block
+ * split at an arpeggiator event, takes the matching fraction of a step,
+ * so smoothing times do not depend on how the block was split.
+ */
+static int32_t smooth(smoothed_param_t* p, size_t frames) {
+    int32_t diff = p->target - p->current;
+    int32_t step = diff >> SYNTH_SMOOTH_SHIFT;
+    if (step == 0) {
+        p->current = p->target;
+    } else {
+        p->current += (step * (int32_t)frames) >> SYNTH_SUBBLOCK_BITS;
+    }
+    return p->current;
+}
+
+// Frames in sub-block sb of a num_frames call, only the last may be short
+static inline size_t subblock_frames(size_t num_frames, size_t sb) {
+    size_t left = num_frames - sb * SYNTH_SUBBLOCK_FRAMES;
+    return (left < SYNTH_SUBBLOCK_FRAMES) ? left : SYNTH_SUBBLOCK_FRAMES;
+}
+
+/* Converts a pitch in 1/256 semitone units to a phase increment. The
+ * octave multiplier is interpolated between exp2_table entries, a
+ * truncated lookup would round every pitch down to the table step.
+ */
+static uint32_t pitch_to_increment(int32_t pitch) {
+    if (pitch < 0) pitch = 0;
+    uint32_t octave = (uint32_t)pitch / (12 * 256);
+    uint32_t pos    = ((uint32_t)pitch % (12 * 256)) * EXP2_TABLE_SIZE;
+    uint32_t i      = pos / (12 * 256);
+    uint32_t weight = ((pos % (12 * 256)) << 16) / (12 * 256);     // Q16
+    uint32_t a      = exp2_table[i];
+    uint32_t b      = (i + 1 < EXP2_TABLE_SIZE) ? exp2_table[i + 1] : (1u << 31);  // 2.0 closes the octave
+    uint32_t mult   = a + (uint32_t)(((uint64_t)(b - a) * weight) >> 16);
+    return (uint32_t)(((uint64_t)base_increment * mult) >> 30) << octave;
+}
+
+static void voice_release(int v) {
+    voice_gate[v] = 0;
+    voice_sustained[v] = 0;
+    if (voice_fm_patch[v] != NULL) {
+        synth_fm_release(&voice_fm[v]);
+    }
+    if (voice_string[v] >= 0) {
+        synth_string_release(voice_string[v], voice_string_patch[v]);
+    }
+}
+
+static void voice_free(int v) {
+    voice_gain[v] = 0;
+    voice_active[v] = 0;
+    if (voice_zone[v] != NULL) {
+        sample_stream_stop(v);
+        voice_zone[v] = NULL;
+    }
+    voice_fm_patch[v] = NULL;
+    voice_unison_patch[v] = NULL;
+    if (voice_string[v] >= 0) {
+        synth_string_free(voice_string[v]);
+        voice_string[v] = -1;
+    }
+    voice_tail[v] = 0;
+    parts[voice_part[v]].voice_count--;
+}
+
+static void part_update_pan(synth_part_t* p) {
+    // cos/sin over a quarter cycle of the sine table
+    uint32_t idx = ((uint32_t)p->config.pan * (SINE_TABLE_SIZE / 4)) / 127;
+    p->pan_left  = sine_table[(SINE_TABLE_SIZE / 4 + idx) & (SINE_TABLE_SIZE - 1)];
+    p->pan_right = sine_table[idx & (SINE_TABLE_SIZE - 1)];
+}
+
+static void part_reset_controllers(synth_part_t* p) {
+    p->volume.target     = p->volume.current     = midi_to_gain(100);
+    p->expression.target = p->expression.current = Q15_ONE;
+    p->mod_wheel.target  = p->mod_wheel.current  = 0;
+    p->pressure.target   = p->pressure.current   = 0;
+    p->sustain_down = 0;
+}
 
 void synth_engine_init(void) {
-    phase = 0;
-    freq = 440.0f;
-    note_is_on = 0;
+    synth_engine_set_sample_rate(AUDIO_SAMPLE_RATE);
+
+    for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+        voice_phase[v]  = 0;
+        voice_active[v] = 0;
+        voice_gate[v]   = 0;
+        voice_drive[v] = 0;
+        voice_oversample[v] = 0;
+        voice_zone[v] = NULL;
+        voice_fm_patch[v] = NULL;
+        voice_unison_patch[v] = NULL;
+        voice_string[v] = -1;
+        voice_tail[v] = 0;
+    }
+    synth_string_init();
+    note_counter = 0;
+    lfo_phase = 0;
+    cost_tier = SYNTH_TIER_FULL;
+    voice_budget = SYNTH_MAX_VOICES;
+
+    for (int i = 0; i < SYNTH_MAX_PARTS; i++) {
+        synth_part_t* p = &parts[i];
+        p->config.preset      = 0;
+        p->config.voice_limit = SYNTH_MAX_VOICES;
+        p->config.priority    = 0;
+        p->config.pan         = SYNTH_PAN_CENTRE;
+        p->config.gain        = Q15_ONE;
+        p->config.output      = 0;
+        p->preset      = &synth_presets[0];
+        p->voice_count = 0;
+        part_update_pan(p);
+        part_reset_controllers(p);
+    }
+}
+
+/* The phase increment at which zone z plays back at its own pitch: its
+ * root note's increment, scaled from the output rate to the zone's rate.
+ */
+static uint32_t zone_base_increment(const synth_sample_zone_t* z) {
+    return (uint32_t)(((uint64_t)pitch_to_increment((int32_t)z->root_note << 8) * output_rate) / z->sample_rate);
+}
+
+// Q16 step through the zone for the voice's current increment
+static uint32_t sample_step(int v) {
+    return (uint32_t)(((uint64_t)voice_increment[v] << 16) / voice_sample_base[v]);
+}
+
+// The patch itself, or a copy in scratch with fewer oscillators under the reduced tier
+static const synth_unison_patch_t* unison_patch_for_tier(const synth_unison_patch_t* patch,
+                                                         synth_unison_patch_t* scratch) {
+    if (cost_tier == SYNTH_TIER_FULL || patch->voices <= SYNTH_REDUCED_UNISON) {
+        return patch;
+    }
+    *scratch = *patch;
+    scratch->voices = SYNTH_REDUCED_UNISON;
+    return scratch;
 }
 
-void synth_engine_set_frequency(float frequency) {
-    freq = frequency;
+static const synth_sample_zone_t* find_zone(uint8_t note, uint8_t velocity) {
+    for (uint8_t i = 0; i < synth_sample_zone_count; i++) {
+        const synth_sample_zone_t* z = &synth_sample_zones[i];
+        if (note >= z->key_lo && note <= z->key_hi && velocity >= z->vel_lo && velocity <= z->vel_hi) {
+            return z;
+        }
+    }
+    return NULL;
 }
 
-void synth_engine_note_on(void) {
-    note_is_on = 1;
+// The rate-dependent increments for the nominal rate corrected by the drift
+static void update_rate(void) {
+    float rate = (float)nominal_rate * (1.0f + (float)rate_drift_ppm * 1e-6f);
+
+    // 8.1758 Hz is MIDI note 0, a full cycle is 2^32 phase units
+    base_increment = (uint32_t)(8.1757989f * (4294967296.0f / rate));
+    lfo_increment  = (uint32_t)(SYNTH_VIBRATO_HZ * SYNTH_SUBBLOCK_FRAMES * (4294967296.0f / rate));
+    output_rate    = (uint32_t)(rate + 0.5f);
+    fm_env_rate    = synth_fm_env_rate(output_rate);
+
+    for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+        if (voice_active[v]) {
+            voice_increment[v] = pitch_to_increment((int32_t)voice_note[v] << 8);
+            if (voice_zone[v] != NULL) {
+                voice_sample_base[v] = zone_base_increment(voice_zone[v]);
+            }
+            if (voice_fm_patch[v] != NULL) {
+                synth_fm_set_pitch(&voice_fm[v], voice_fm_patch[v], voice_increment[v]);
+            }
+            if (voice_string[v] >= 0) {
+                synth_string_tune(voice_string[v], voice_increment[v]);
+            }
+        }
+    }
 }
 
-void synth_engine_note_off(void) {
-    note_is_on = 0;
+void synth_engine_set_sample_rate(uint32_t rate) {
+    nominal_rate = rate;
+    rate_drift_ppm = 0;
+    update_rate();
 }
 
-void synth_engine_process(int32_t* output_buffer, size_t num_frames) {
-    float phase_increment = freq * 1024.0f / (float)AUDIO_SAMPLE_RATE;
+void synth_engine_set_rate_drift(int32_t drift_ppm) {
+    if (drift_ppm == rate_drift_ppm) return;
+    rate_drift_ppm = drift_ppm;
+    update_rate();
+}
 
-    for (size_t i = 0; i < num_frames * 2; i = i + 2) {
-        int16_t sine_val = sine_table[(uint16_t)phase] / 8;
+/* Picks a voice to steal. Released voices go first, then voices of the
+ * lowest priority part, then the oldest. Only parts at or below
+ * max_priority are considered; only_part >= 0 restricts the search to
+ * that part, and strings to voices holding a delay line.
+ */
+static int steal_voice(int only_part, uint8_t max_priority, bool strings) {
+    int best = -1;
+    for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+        if (!voice_active[v]) continue;
+        if (only_part >= 0 && voice_part[v] != only_part) continue;
+        if (strings && voice_string[v] < 0) continue;
+        uint8_t prio = parts[voice_part[v]].config.priority;
+        if (prio > max_priority) continue;
+        if (best < 0) {
+            best = v;
+            continue;
+        }
+        if (voice_gate[v] != voice_gate[best]) {
+            if (!voice_gate[v]) best = v;
+            continue;
+        }
+        uint8_t best_prio = parts[voice_part[best]].config.priority;
+        if (prio != best_prio) {
+            if (prio < best_prio) best = v;
+            continue;
+        }
+        if (voice_age[v] < voice_age[best]) best = v;
+    }
+    return best;
+}
+
+static int allocate_voice(uint8_t part, uint8_t note) {
+    synth_part_t* p = &parts[part];
 
-        if (!note_is_on) {
-            sine_val = 0;
+    // Retrigger the same note on the same part
+    for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+        if (voice_active[v] && voice_part[v] == part && voice_note[v] == note) {
+            return v;
         }
+    }
 
-        output_buffer[i] = sine_val << 16;
-        output_buffer[i + 1] = sine_val << 16;
+    // A part at its budget recycles one of its own voices
+    if (p->voice_count >= p->config.voice_limit) {
+        return steal_voice(part, 0xFF, false);
+    }
+
+    // So does the whole pool at the governor's budget
+    if (synth_engine_get_active_voices() >= voice_budget) {
+        return steal_voice(-1, p->config.priority, false);
+    }
+
+    for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+        if (!voice_active[v]) {
+            return v;
+        }
+    }
+
+    return steal_voice(-1, p->config.priority, false);
+}
+
+void synth_engine_note_on(uint8_t channel, uint8_t note, uint8_t velocity) {
+    if (channel >= SYNTH_MAX_PARTS) return;
+    synth_part_t* p = &parts[channel];
+    if (p->config.voice_limit == 0) return;
+
+    const synth_sample_zone_t* zone = NULL;
+    if (p->preset->voice_type == SYNTH_VOICE_SAMPLE) {
+        zone = find_zone(note, velocity);
+        if (zone == NULL) return;   // No zone covers the key
+    }
+
+    int slot = allocate_voice(channel, note);
+    if (slot < 0) return;   // Every voice belongs to a higher priority part
+
+    /* A string needs a delay line. The pool is smaller than the voice pool,
+     * so when it runs out the note steals a string voice instead, by the
+     * same rules and with the same ramp as any stolen voice: from this
+     * part alone once it is at its limit, otherwise from parts at or
+     * below its priority. With none to take, the note is dropped.
+     */
+    const synth_string_patch_t* string = (p->preset->voice_type == SYNTH_VOICE_STRING) ? p->preset->string : NULL;
+    int line = -1;
+    if (string != NULL) {
+        line = voice_active[slot] ? voice_string[slot] : -1;
+        if (line < 0) line = synth_string_alloc();
+        if (line < 0) {
+            bool at_limit = p->voice_count >= p->config.voice_limit;
+            slot = steal_voice(at_limit ? channel : -1, p->config.priority, true);
+            if (slot < 0) return;
+            line = voice_string[slot];
+        }
+    }
+
+    if (voice_active[slot]) {
+        // A stolen voice ramps from where it was, but changes owner
+        parts[voice_part[slot]].voice_count--;
+    } else {
+        voice_gain[slot] = 0;
+    }
+    p->voice_count++;
+
+    voice_part[slot]      = channel;
+    voice_note[slot]      = note;
+    voice_increment[slot] = pitch_to_increment((int32_t)note << 8);
+    voice_velocity[slot]  = midi_to_gain(velocity);
+    voice_pressure[slot]  = 0;
+    voice_pressure_target[slot] = 0;
+    voice_age[slot]       = ++note_counter;
+
+    /* The kernel is fixed for the note, so a program change does not move
+     * sounding voices between the sine and drive paths. Only notes high
+     * enough to alias pay for oversampling, and not under overload.
+     */
+    voice_drive[slot] = (p->preset->voice_type == SYNTH_VOICE_DRIVE) ? p->preset->drive : 0;
+    uint8_t oversample = (voice_drive[slot] != 0 && note >= p->preset->oversample_note &&
+                          cost_tier == SYNTH_TIER_FULL);
+    if (oversample && !voice_oversample[slot]) {
+        memset(voice_os_history[slot], 0, sizeof(voice_os_history[slot]));
+    }
+    voice_oversample[slot] = oversample;
+
+    // Sample voices start streaming now, the first frames are copied in at once
+    if (zone != NULL) {
+        voice_sample_base[slot] = zone_base_increment(zone);
+        sample_stream_start(slot, zone);
+    } else if (voice_zone[slot] != NULL) {
+        sample_stream_stop(slot);
+    }
+    voice_zone[slot]      = zone;
+
+    // A retriggered FM voice carries on from its current phases and levels
+    const synth_fm_patch_t* fm = (p->preset->voice_type == SYNTH_VOICE_FM) ? p->preset->fm : NULL;
+    if (fm != NULL) {
+        synth_fm_note_on(&voice_fm[slot], fm, voice_active[slot] && voice_fm_patch[slot] != NULL);
+        synth_fm_set_pitch(&voice_fm[slot], fm, voice_increment[slot]);
+    }
+    voice_fm_patch[slot]  = fm;
+
+    const synth_unison_patch_t* unison = (p->preset->voice_type == SYNTH_VOICE_UNISON) ? p->preset->unison : NULL;
+    if (unison != NULL) {
+        synth_unison_patch_t reduced;
+        synth_unison_note_on(&voice_unison[slot], unison_patch_for_tier(unison, &reduced),
+                             voice_active[slot] && voice_unison_patch[slot] != NULL);
+    }
+    voice_unison_patch[slot] = unison;
+
+    if (line >= 0) {
+        synth_string_pluck(line, string, voice_increment[slot]);
+    } else if (voice_string[slot] >= 0) {
+        synth_string_free(voice_string[slot]);
+    }
+    voice_string[slot]    = (int8_t)line;
+    voice_string_patch[slot] = string;
+
+    voice_tail[slot]      = (fm != NULL || line >= 0);
+    voice_active[slot]    = 1;
+    voice_gate[slot]      = 1;
+    voice_sustained[slot] = 0;
+}
 
-        phase += phase_increment;
-        if (phase >= 1024.0f) {
-            phase -= 1024.0f;
+void synth_engine_note_off(uint8_t channel, uint8_t note) {
+    if (channel >= SYNTH_MAX_PARTS) return;
+    for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+        if (voice_active[v] && voice_gate[v] && voice_part[v] == channel && voice_note[v] == note) {
+            if (parts[channel].sustain_down) {
+                voice_sustained[v] = 1;
+            } else {
+                voice_release(v);
+            }
         }
     }
 }
+
+void synth_engine_control_change(uint8_t channel, uint8_t controller, uint8_t value) {
+    if (channel >= SYNTH_MAX_PARTS) return;
+    synth_part_t* p = &parts[channel];
+
+    switch (controller) {
+    case 1:     // Modulation wheel
+        p->mod_wheel.target = ((int32_t)value * Q15_ONE) / 127;
+        break;
+    case 7:     // Channel volume
+        p->volume.target = midi_to_gain(value);
+        break;
+    case 10:    // Pan
+        p->config.pan = value;
+        part_update_pan(p);
+        break;
+    case 11:    // Expression
+        p->expression.target = midi_to_gain(value);
+        break;
+    case 64:    // Sustain pedal
+        p->sustain_down = (value >= 64);
+        if (!p->sustain_down) {
+            for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+                if (voice_sustained[v] && voice_part[v] == channel) {
+                    voice_release(v);
+                }
+            }
+        }
+        break;
+    case 121:   // Reset all controllers
+        part_reset_controllers(p);
+        break;
+    case 123:   // All notes off
+        for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+            if (voice_part[v] == channel) {
+                voice_release(v);
+            }
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void synth_engine_program_change(uint8_t channel, uint8_t program) {
+    if (channel >= SYNTH_MAX_PARTS || program >= synth_preset_count) return;
+    parts[channel].config.preset = program;
+    parts[channel].preset = &synth_presets[program];
+}
+
+void synth_engine_channel_pressure(uint8_t channel, uint8_t value) {
+    if (channel >= SYNTH_MAX_PARTS) return;
+    parts[channel].pressure.target = ((int32_t)value * Q15_ONE) / 127;
+}
+
+void synth_engine_poly_pressure(uint8_t channel, uint8_t note, uint8_t value) {
+    for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+        if (voice_active[v] && voice_gate[v] && voice_part[v] == channel && voice_note[v] == note) {
+            voice_pressure_target[v] = ((int32_t)value * Q15_ONE) / 127;
+        }
+    }
+}
+
+void synth_engine_get_part_config(uint8_t part, synth_part_config_t* config) {
+    if (part >= SYNTH_MAX_PARTS) return;
+    *config = parts[part].config;
+}
+
+void synth_engine_set_part_config(uint8_t part, const synth_part_config_t* config) {
+    if (part >= SYNTH_MAX_PARTS || config->preset >= synth_preset_count) return;
+    synth_part_t* p = &parts[part];
+    p->config = *config;
+    if (p->config.voice_limit > SYNTH_MAX_VOICES) {
+        p->config.voice_limit = SYNTH_MAX_VOICES;
+    }
+    if (p->config.output >= SYNTH_OUTPUT_BUSES) {
+        p->config.output = 0;
+    }
+    p->preset = &synth_presets[p->config.preset];
+    part_update_pan(p);
+}
+
+void synth_engine_set_cost_tier(synth_cost_tier_t tier) {
+    if (tier == cost_tier) return;
+    cost_tier = tier;
+    if (tier == SYNTH_TIER_FULL) return;
+
+    // Sounding voices shed their cost now, a tier held only by new notes
+    // would save nothing until the overload had played out
+    for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+        if (!voice_active[v]) continue;
+        voice_oversample[v] = 0;
+        if (voice_unison_patch[v] != NULL && voice_unison[v].count > SYNTH_REDUCED_UNISON) {
+            synth_unison_patch_t reduced;
+            synth_unison_note_on(&voice_unison[v], unison_patch_for_tier(voice_unison_patch[v], &reduced), true);
+        }
+    }
+}
+
+void synth_engine_set_voice_budget(uint8_t budget) {
+    if (budget < 1) budget = 1;
+    if (budget > SYNTH_MAX_VOICES) budget = SYNTH_MAX_VOICES;
+    voice_budget = budget;
+}
+
+uint8_t synth_engine_get_active_voices(void) {
+    uint8_t count = 0;
+    for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+        count += voice_active[v];
+    }
+    return count;
+}
+
+void synth_engine_take_stats(synth_engine_stats_t* out) {
+    stats.stream_misses += sample_stream_take_misses();
+    *out = stats;
+    memset(&stats, 0, sizeof(stats));
+}
+
+/* Advances a part's controllers across the block, one step per sub-block,
+ * so the voice loop only reads precomputed values.
+ */
+static void update_part_params(synth_part_t* p, size_t num_frames, size_t subblocks) {
+    for (size_t sb = 0; sb < subblocks; sb++) {
+        size_t n = subblock_frames(num_frames, sb);
+        int32_t vol   = smooth(&p->volume, n);
+        int32_t expr  = smooth(&p->expression, n);
+        int32_t depth = smooth(&p->mod_wheel, n) + smooth(&p->pressure, n);
+        if (depth > Q15_ONE) depth = Q15_ONE;
+
+        int32_t gain = (int32_t)(((int64_t)vol * expr) >> 15);
+        subblock_gain[sb]    = (gain * p->preset->level) >> 15;
+        subblock_vibrato[sb] = (subblock_lfo[sb] * depth) >> 15;
+    }
+}
+
+static void update_lfo(size_t num_frames, size_t subblocks) {
+    for (size_t sb = 0; sb < subblocks; sb++) {
+        subblock_lfo[sb] = sine_table[lfo_phase >> (32 - SINE_TABLE_BITS)];
+        lfo_phase += (uint32_t)(((uint64_t)lfo_increment * subblock_frames(num_frames, sb)) >> SYNTH_SUBBLOCK_BITS);
+    }
+}
+
+static void render_voice(int v, const synth_part_t* p, size_t num_frames) {
+    int32_t gain = voice_gain[v];
+    int32_t base_pitch = (int32_t)voice_note[v] << 8;
+    size_t offset = 0;
+    bool playing = true;
+
+    for (size_t sb = 0; offset < num_frames; sb++) {
+        size_t n = num_frames - offset;
+        if (n > SYNTH_SUBBLOCK_FRAMES) n = SYNTH_SUBBLOCK_FRAMES;
+
+        // Target gain for the end of this sub-block, reached by a linear ramp.
+        // Voices with a tail fade out by themselves instead.
+        int32_t target = 0;
+        if (voice_gate[v] || voice_tail[v]) {
+            target = (int32_t)(((int64_t)voice_velocity[v] * subblock_gain[sb]) >> 15);
+        }
+        int32_t step = (target - gain) >> SYNTH_SUBBLOCK_BITS;
+
+        // Vibrato: channel depth plus this voice's poly pressure
+        voice_pressure[v] += (((voice_pressure_target[v] - voice_pressure[v]) >> SYNTH_SMOOTH_SHIFT) * (int32_t)n)
+                             >> SYNTH_SUBBLOCK_BITS;
+        int32_t vibrato = subblock_vibrato[sb] + ((subblock_lfo[sb] * voice_pressure[v]) >> 15);
+        // The reduced tier holds the first sub-block's pitch for the whole block
+        if (vibrato != 0 && (sb == 0 || cost_tier == SYNTH_TIER_FULL)) {
+            voice_increment[v] = pitch_to_increment(base_pitch + ((vibrato * p->preset->vibrato_depth) >> 15));
+            if (voice_fm_patch[v] != NULL) {
+                synth_fm_set_pitch(&voice_fm[v], voice_fm_patch[v], voice_increment[v]);
+            }
+        }
+
+        if (voice_fm_patch[v] != NULL) {
+            synth_fm_update(&voice_fm[v], voice_fm_patch[v], fm_env_rate, n);
+            synth_fm_accumulate(&part_mix[offset], n, &voice_fm[v], voice_fm_patch[v]->algorithm, gain, step);
+        } else if (voice_string[v] >= 0) {
+            playing = synth_string_accumulate(voice_string[v], &part_mix[offset], n, gain, step);
+        } else if (voice_unison_patch[v] != NULL) {
+            if (!part_side_used) {
+                memset(part_side, 0, sizeof(int32_t) * num_frames);
+                part_side_used = true;
+            }
+            synth_unison_accumulate(&part_mix[offset], &part_side[offset], n, &voice_unison[v], voice_increment[v], gain, step);
+        } else if (voice_zone[v] != NULL) {
+            playing = sample_stream_accumulate(v, &part_mix[offset], n, sample_step(v), gain, step);
+        } else if (voice_drive[v] != 0) {
+            if (voice_oversample[v]) {
+                voice_phase[v] = synth_osc_drive_accumulate_2x(&part_mix[offset], n, voice_phase[v], voice_increment[v],
+                                                               gain, step, voice_drive[v], voice_os_history[v]);
+            } else {
+                voice_phase[v] = synth_osc_drive_accumulate(&part_mix[offset], n, voice_phase[v], voice_increment[v],
+                                                            gain, step, voice_drive[v]);
+            }
+        } else {
+            voice_phase[v] = synth_osc_sine_accumulate(&part_mix[offset], n, voice_phase[v], voice_increment[v], gain, step);
+        }
+        gain += step * (int32_t)n;
+        offset += n;
+        if (!playing) break;
+    }
+
+    voice_gain[v] = gain;
+
+    // A released voice is freed once its ramp has reached silence, a
+    // one-shot sample once it has played out, a string once it has decayed
+    // and an FM voice once its carriers have
+    if (voice_fm_patch[v] != NULL) {
+        playing = !synth_fm_finished(&voice_fm[v], voice_fm_patch[v]);
+    }
+    if ((!voice_gate[v] && gain <= 0) || !playing) {
+        voice_free(v);
+    } else if (voice_zone[v] != NULL) {
+        sample_stream_refill(v);
+    }
+}
+
+/* Renders one part's voices into part_mix and pans the result onto the
+ * part's output bus. Returns the number of voices rendered.
+ */
+static uint32_t render_part(uint8_t part, size_t num_frames, size_t subblocks) {
+    synth_part_t* p = &parts[part];
+    uint32_t voices = 0;
+
+    for (size_t i = 0; i < num_frames; i++) {
+        part_mix[i] = 0;
+    }
+    part_side_used = false;
+
+    update_part_params(p, num_frames, subblocks);
+
+    // Voice-outer, frame-inner: each voice runs its whole block in one pass
+    for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+        if (!voice_active[v] || voice_part[v] != part) {
+            continue;
+        }
+        render_voice(v, p, num_frames);
+        voices++;
+    }
+
+    int32_t gain_l = (p->pan_left * p->config.gain) >> 15;
+    int32_t gain_r = (p->pan_right * p->config.gain) >> 15;
+    int32_t* left  = mix_left[p->config.output];
+    int32_t* right = mix_right[p->config.output];
+    if (part_side_used) {
+        for (size_t i = 0; i < num_frames; i++) {
+            int32_t m = part_mix[i];
+            int32_t d = part_side[i];
+            left[i]  += ((m + d) * gain_l) >> 15;
+            right[i] += ((m - d) * gain_r) >> 15;
+        }
+        return voices;
+    }
+    for (size_t i = 0; i < num_frames; i++) {
+        int32_t s = part_mix[i];
+        left[i]  += (s * gain_l) >> 15;
+        right[i] += (s * gain_r) >> 15;
+    }
+    return voices;
+}
+
+/* Releases the quietest held voices until no more than voice_budget are
+ * held. Released voices ramp to silence within one sub-block and are
+ * freed, so the budget is met from the next block on.
+ */
+static void shed_voices(void) {
+    uint8_t held = 0;
+    for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+        held += voice_active[v] && voice_gate[v];
+    }
+
+    while (held > voice_budget) {
+        int quietest = -1;
+        for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+            if (!voice_active[v] || !voice_gate[v]) continue;
+            if (quietest < 0 || voice_gain[v] < voice_gain[quietest]) quietest = v;
+        }
+        voice_release(quietest);
+        voice_tail[quietest] = 0;   // Cut the tail, the gain ramp silences it
+        held--;
+    }
+}
+
+static void snap_part_params(synth_part_t* p) {
+    p->volume.current     = p->volume.target;
+    p->expression.current = p->expression.target;
+    p->mod_wheel.current  = p->mod_wheel.target;
+    p->pressure.current   = p->pressure.target;
+}
+
+static inline int32_t clip16(int32_t s) {
+    if (s > INT16_MAX) return INT16_MAX;
+    if (s < INT16_MIN) return INT16_MIN;
+    return s;
+}
+
+void synth_engine_process(int32_t* const outputs[], size_t num_frames) {
+    uint32_t start = time_us_32();
+    uint32_t voices = 0;
+    size_t subblocks = (num_frames + SYNTH_SUBBLOCK_FRAMES - 1) / SYNTH_SUBBLOCK_FRAMES;
+
+    for (int bus = 0; bus < SYNTH_OUTPUT_BUSES; bus++) {
+        for (size_t i = 0; i < num_frames; i++) {
+            mix_left[bus][i] = 0;
+            mix_right[bus][i] = 0;
+        }
+    }
+
+    shed_voices();
+    update_lfo(num_frames, subblocks);
+
+    for (uint8_t part = 0; part < SYNTH_MAX_PARTS; part++) {
+        if (parts[part].voice_count == 0) {
+            // Idle parts jump straight to their controller targets
+            snap_part_params(&parts[part]);
+            continue;
+        }
+        uint32_t part_start = time_us_32();
+        voices += render_part(part, num_frames, subblocks);
+        stats.part_render_us[part] += time_us_32() - part_start;
+    }
+
+    // Interleave every bus into its I2S buffer in one pass at the end
+    for (size_t i = 0; i < num_frames; i++) {
+        for (int bus = 0; bus < SYNTH_OUTPUT_BUSES; bus++) {
+#if AUDIO_I2S_PACKED
+            outputs[bus][i] = (int32_t)(((uint32_t)clip16(mix_left[bus][i]) << 16) | (uint16_t)clip16(mix_right[bus][i]));
+#else
+            outputs[bus][2 * i]     = clip16(mix_left[bus][i]) << 16;
+            outputs[bus][2 * i + 1] = clip16(mix_right[bus][i]) << 16;
+#endif
+        }
+    }
+
+    stats.render_us    += time_us_32() - start;
+    stats.voice_frames += voices * (uint32_t)num_frames;
+    if (voices > stats.active_voices) {
+        stats.active_voices = voices;
+    }
+}
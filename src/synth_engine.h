@@ -3,11 +3,74 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include "app_config.h"
+
+// One part per MIDI channel
+#define SYNTH_MAX_PARTS         16
+
+#define SYNTH_PAN_CENTRE        64
+
+// Stereo outputs the parts are mixed onto, one per I2S bus
+#define SYNTH_OUTPUT_BUSES      (AUDIO_I2S_BUS2 ? 2 : 1)
+
+typedef struct {
+    uint8_t preset;         // Index into synth_presets
+    uint8_t voice_limit;    // Most voices the part may hold, 0 mutes the part
+    uint8_t priority;       // A part may only steal voices from parts of equal or lower priority
+    uint8_t pan;            // 0 = left, 64 = centre, 127 = right
+    int32_t gain;           // Q15 output gain
+    uint8_t output;         // Bus the part is mixed onto, below SYNTH_OUTPUT_BUSES
+} synth_part_config_t;
+
+/* Cost tiers for the overload governor. REDUCED takes sounding drive
+ * voices off the 2x oversampled path and cuts unison voices to
+ * SYNTH_REDUCED_UNISON oscillators, which is where its savings come from,
+ * and also recomputes vibrato pitch once per block instead of once per
+ * sub-block. New notes start reduced too; voices stay reduced until they
+ * are retriggered after the tier returns to FULL.
+ */
+typedef enum {
+    SYNTH_TIER_FULL = 0,
+    SYNTH_TIER_REDUCED,
+} synth_cost_tier_t;
+
+#define SYNTH_REDUCED_UNISON    3
+
+typedef struct {
+    uint32_t render_us;     // Time spent in synth_engine_process
+    uint32_t active_voices; // Most voices rendered in one call
+    uint32_t voice_frames;  // Sum of voices * frames over the calls
+    uint32_t part_render_us[SYNTH_MAX_PARTS];  // Share of render_us spent on each part
+    uint32_t stream_misses; // Sample voices cut short by a late flash prefetch
+} synth_engine_stats_t;
 
 void synth_engine_init(void);
-void synth_engine_set_frequency(float frequency);
-void synth_engine_note_on(void);
-void synth_engine_note_off(void);
-void synth_engine_process(int32_t* output_buffer, size_t num_frames);
+// Recomputes the rate-dependent increments, sounding voices keep their pitch
+void synth_engine_set_sample_rate(uint32_t rate);
+/* Corrects the increments for an output clock running drift_ppm off the
+ * sample rate, an external I2S master, so pitch stays true to the crystal.
+ * Cleared by synth_engine_set_sample_rate.
+ */
+void synth_engine_set_rate_drift(int32_t drift_ppm);
+void synth_engine_note_on(uint8_t channel, uint8_t note, uint8_t velocity);
+void synth_engine_note_off(uint8_t channel, uint8_t note);
+void synth_engine_control_change(uint8_t channel, uint8_t controller, uint8_t value);
+void synth_engine_program_change(uint8_t channel, uint8_t program);
+void synth_engine_channel_pressure(uint8_t channel, uint8_t value);
+void synth_engine_poly_pressure(uint8_t channel, uint8_t note, uint8_t value);
+void synth_engine_get_part_config(uint8_t part, synth_part_config_t* config);
+void synth_engine_set_part_config(uint8_t part, const synth_part_config_t* config);
+/* Renders num_frames into outputs[bus] for each of the SYNTH_OUTPUT_BUSES,
+ * in the I2S layout of AUDIO_I2S_PACKED.
+ */
+void synth_engine_process(int32_t* const outputs[], size_t num_frames);
+void synth_engine_set_cost_tier(synth_cost_tier_t tier);
+/* Caps the voices the engine renders. Above the budget the quietest held
+ * voices are released at the next process call and new notes steal.
+ */
+void synth_engine_set_voice_budget(uint8_t budget);
+uint8_t synth_engine_get_active_voices(void);
+// Statistics accumulate over process calls, taking them resets the counts
+void synth_engine_take_stats(synth_engine_stats_t* out);
 
 #endif /* SYNTH_ENGINE_H */
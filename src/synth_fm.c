@@ -0,0 +1,251 @@
+#include "synth_fm.h"
+#include "synth_tables.h"
+
+// Envelope full scale
+#define FM_ENV_ONE          (1 << 23)
+
+// synth_fm_env_rate is the change over 2^FM_ENV_RATE_BITS frames, which keeps long stages precise
+#define FM_ENV_RATE_BITS    8
+
+// A full-scale modulator moves the modulated phase by one whole cycle
+#define FM_MOD_SHIFT        17
+
+enum {
+    FM_ATTACK = 0,
+    FM_DECAY,
+    FM_SUSTAIN,
+    FM_RELEASE,
+    FM_OFF,
+};
+
+static const uint8_t fm_op_counts[SYNTH_FM_ALG_COUNT] = { 2, 3, 3, 4, 4, 4 };
+
+// Operators that reach the output, one bit each
+static const uint8_t fm_carriers[SYNTH_FM_ALG_COUNT] = { 0x1, 0x1, 0x1, 0x1, 0x5, 0x1 };
+
+uint8_t synth_fm_op_count(uint8_t algorithm) {
+    return fm_op_counts[algorithm];
+}
+
+void synth_fm_note_on(synth_fm_voice_t* fm, const synth_fm_patch_t* patch, bool retrigger) {
+    for (int k = 0; k < SYNTH_FM_OPS; k++) {
+        if (!retrigger) {
+            fm->phase[k] = 0;
+            fm->level[k] = 0;
+            fm->env[k] = 0;
+        }
+        fm->level_step[k] = 0;
+        fm->stage[k] = FM_ATTACK;
+    }
+    if (!retrigger) {
+        fm->fb[0] = fm->fb[1] = 0;
+    }
+    fm->feedback = patch->feedback;
+}
+
+void synth_fm_release(synth_fm_voice_t* fm) {
+    for (int k = 0; k < SYNTH_FM_OPS; k++) {
+        if (fm->stage[k] != FM_OFF) fm->stage[k] = FM_RELEASE;
+    }
+}
+
+void synth_fm_set_pitch(synth_fm_voice_t* fm, const synth_fm_patch_t* patch, uint32_t increment) {
+    for (int k = 0; k < fm_op_counts[patch->algorithm]; k++) {
+        fm->increment[k] = (uint32_t)(((uint64_t)increment * patch->op[k].ratio) >> 8);
+    }
+}
+
+int32_t synth_fm_env_rate(uint32_t rate) {
+    return (int32_t)(((uint64_t)FM_ENV_ONE * 1000u << FM_ENV_RATE_BITS) / rate);
+}
+
+// Envelope change over frames for a stage of the given length, a whole stage when it is 0 ms
+static int32_t env_advance(int32_t env_rate, uint16_t ms, size_t frames) {
+    return ms ? (int32_t)(((int64_t)(env_rate / ms) * (int64_t)frames) >> FM_ENV_RATE_BITS) : FM_ENV_ONE;
+}
+
+void synth_fm_update(synth_fm_voice_t* fm, const synth_fm_patch_t* patch, int32_t env_rate, size_t frames) {
+    for (int k = 0; k < fm_op_counts[patch->algorithm]; k++) {
+        const synth_fm_op_t* op = &patch->op[k];
+        int32_t env = fm->env[k];
+        int32_t sustain = (int32_t)op->sustain << 8;
+
+        switch (fm->stage[k]) {
+        case FM_ATTACK:
+            env += env_advance(env_rate, op->attack_ms, frames);
+            if (env >= FM_ENV_ONE) {
+                env = FM_ENV_ONE;
+                fm->stage[k] = FM_DECAY;
+            }
+            break;
+        case FM_DECAY:
+            env -= env_advance(env_rate, op->decay_ms, frames);
+            if (env <= sustain) {
+                env = sustain;
+                fm->stage[k] = (sustain > 0) ? FM_SUSTAIN : FM_OFF;
+            }
+            break;
+        case FM_RELEASE:
+            env -= env_advance(env_rate, op->release_ms, frames);
+            if (env <= 0) {
+                env = 0;
+                fm->stage[k] = FM_OFF;
+            }
+            break;
+        default:
+            break;
+        }
+        fm->env[k] = env;
+
+        // The previous ramp can undershoot by a step on its way to zero
+        if (fm->level[k] < 0) fm->level[k] = 0;
+        int32_t target = ((env >> 8) * op->level) >> 15;
+        fm->level_step[k] = (target - fm->level[k]) / (int32_t)frames;
+    }
+}
+
+bool synth_fm_finished(const synth_fm_voice_t* fm, const synth_fm_patch_t* patch) {
+    uint8_t carriers = fm_carriers[patch->algorithm];
+    for (int k = 0; k < SYNTH_FM_OPS; k++) {
+        if ((carriers & (1u << k)) && (fm->stage[k] != FM_OFF || fm->level[k] > 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Kernel building blocks. Each algorithm keeps its operators in locals for
+ * the whole run and writes them back at the end.
+ */
+#define FM_LOAD(k) \
+    uint32_t p##k = fm->phase[k]; \
+    const uint32_t i##k = fm->increment[k]; \
+    int32_t l##k = fm->level[k]; \
+    const int32_t s##k = fm->level_step[k];
+
+#define FM_SAVE(k) \
+    fm->phase[k] = p##k; \
+    fm->level[k] = l##k;
+
+#define FM_ADVANCE(k) \
+    p##k += i##k; \
+    l##k += s##k;
+
+#define FM_FB_LOAD \
+    int32_t fb0 = fm->fb[0]; \
+    int32_t fb1 = fm->fb[1]; \
+    const int32_t fbk = fm->feedback;
+
+#define FM_FB_SAVE \
+    fm->fb[0] = fb0; \
+    fm->fb[1] = fb1;
+
+// Phase offset of the top modulator's self-modulation
+#define FM_FEEDBACK()   ((uint32_t)((fb0 + fb1) * fbk) << (FM_MOD_SHIFT - 9))
+#define FM_FB_PUSH(x)   fb1 = fb0; fb0 = (x);
+
+#define FM_MOD(x)       ((uint32_t)(x) << FM_MOD_SHIFT)
+
+#define FM_OUT_MIX(x) \
+    mix[n] += ((x) * gain) >> 15; \
+    gain += gain_step;
+
+// One operator's output: the sine at its modulated phase, scaled by its level
+static inline int32_t fm_op(uint32_t phase, uint32_t mod, int32_t level) {
+    return (sine_table[(phase + mod) >> (32 - SINE_TABLE_BITS)] * level) >> 15;
+}
+
+static void __not_in_flash_func(fm_2op)(int32_t* mix, size_t num_frames, synth_fm_voice_t* fm, int32_t gain, int32_t gain_step) {
+    FM_LOAD(0) FM_LOAD(1) FM_FB_LOAD
+    for (size_t n = 0; n < num_frames; n++) {
+        int32_t m1 = fm_op(p1, FM_FEEDBACK(), l1);
+        FM_FB_PUSH(m1)
+        int32_t c0 = fm_op(p0, FM_MOD(m1), l0);
+        FM_OUT_MIX(c0)
+        FM_ADVANCE(0) FM_ADVANCE(1)
+    }
+    FM_SAVE(0) FM_SAVE(1) FM_FB_SAVE
+}
+
+static void __not_in_flash_func(fm_3op_stack)(int32_t* mix, size_t num_frames, synth_fm_voice_t* fm, int32_t gain, int32_t gain_step) {
+    FM_LOAD(0) FM_LOAD(1) FM_LOAD(2) FM_FB_LOAD
+    for (size_t n = 0; n < num_frames; n++) {
+        int32_t m2 = fm_op(p2, FM_FEEDBACK(), l2);
+        FM_FB_PUSH(m2)
+        int32_t m1 = fm_op(p1, FM_MOD(m2), l1);
+        int32_t c0 = fm_op(p0, FM_MOD(m1), l0);
+        FM_OUT_MIX(c0)
+        FM_ADVANCE(0) FM_ADVANCE(1) FM_ADVANCE(2)
+    }
+    FM_SAVE(0) FM_SAVE(1) FM_SAVE(2) FM_FB_SAVE
+}
+
+static void __not_in_flash_func(fm_3op_y)(int32_t* mix, size_t num_frames, synth_fm_voice_t* fm, int32_t gain, int32_t gain_step) {
+    FM_LOAD(0) FM_LOAD(1) FM_LOAD(2) FM_FB_LOAD
+    for (size_t n = 0; n < num_frames; n++) {
+        int32_t m2 = fm_op(p2, FM_FEEDBACK(), l2);
+        FM_FB_PUSH(m2)
+        int32_t m1 = fm_op(p1, 0, l1);
+        int32_t c0 = fm_op(p0, FM_MOD(m1 + m2), l0);
+        FM_OUT_MIX(c0)
+        FM_ADVANCE(0) FM_ADVANCE(1) FM_ADVANCE(2)
+    }
+    FM_SAVE(0) FM_SAVE(1) FM_SAVE(2) FM_FB_SAVE
+}
+
+static void __not_in_flash_func(fm_4op_stack)(int32_t* mix, size_t num_frames, synth_fm_voice_t* fm, int32_t gain, int32_t gain_step) {
+    FM_LOAD(0) FM_LOAD(1) FM_LOAD(2) FM_LOAD(3) FM_FB_LOAD
+    for (size_t n = 0; n < num_frames; n++) {
+        int32_t m3 = fm_op(p3, FM_FEEDBACK(), l3);
+        FM_FB_PUSH(m3)
+        int32_t m2 = fm_op(p2, FM_MOD(m3), l2);
+        int32_t m1 = fm_op(p1, FM_MOD(m2), l1);
+        int32_t c0 = fm_op(p0, FM_MOD(m1), l0);
+        FM_OUT_MIX(c0)
+        FM_ADVANCE(0) FM_ADVANCE(1) FM_ADVANCE(2) FM_ADVANCE(3)
+    }
+    FM_SAVE(0) FM_SAVE(1) FM_SAVE(2) FM_SAVE(3) FM_FB_SAVE
+}
+
+static void __not_in_flash_func(fm_4op_pairs)(int32_t* mix, size_t num_frames, synth_fm_voice_t* fm, int32_t gain, int32_t gain_step) {
+    FM_LOAD(0) FM_LOAD(1) FM_LOAD(2) FM_LOAD(3) FM_FB_LOAD
+    for (size_t n = 0; n < num_frames; n++) {
+        int32_t m3 = fm_op(p3, FM_FEEDBACK(), l3);
+        FM_FB_PUSH(m3)
+        int32_t c2 = fm_op(p2, FM_MOD(m3), l2);
+        int32_t m1 = fm_op(p1, 0, l1);
+        int32_t c0 = fm_op(p0, FM_MOD(m1), l0);
+        FM_OUT_MIX(c0 + c2)
+        FM_ADVANCE(0) FM_ADVANCE(1) FM_ADVANCE(2) FM_ADVANCE(3)
+    }
+    FM_SAVE(0) FM_SAVE(1) FM_SAVE(2) FM_SAVE(3) FM_FB_SAVE
+}
+
+static void __not_in_flash_func(fm_4op_branch)(int32_t* mix, size_t num_frames, synth_fm_voice_t* fm, int32_t gain, int32_t gain_step) {
+    FM_LOAD(0) FM_LOAD(1) FM_LOAD(2) FM_LOAD(3) FM_FB_LOAD
+    for (size_t n = 0; n < num_frames; n++) {
+        int32_t m3 = fm_op(p3, FM_FEEDBACK(), l3);
+        FM_FB_PUSH(m3)
+        int32_t m2 = fm_op(p2, FM_MOD(m3), l2);
+        int32_t m1 = fm_op(p1, 0, l1);
+        int32_t c0 = fm_op(p0, FM_MOD(m1 + m2), l0);
+        FM_OUT_MIX(c0)
+        FM_ADVANCE(0) FM_ADVANCE(1) FM_ADVANCE(2) FM_ADVANCE(3)
+    }
+    FM_SAVE(0) FM_SAVE(1) FM_SAVE(2) FM_SAVE(3) FM_FB_SAVE
+}
+
+typedef void (*fm_kernel_t)(int32_t* mix, size_t num_frames, synth_fm_voice_t* fm, int32_t gain, int32_t gain_step);
+
+static const fm_kernel_t fm_kernels[SYNTH_FM_ALG_COUNT] = {
+    fm_2op,
+    fm_3op_stack,
+    fm_3op_y,
+    fm_4op_stack,
+    fm_4op_pairs,
+    fm_4op_branch,
+};
+
+void synth_fm_accumulate(int32_t* mix, size_t num_frames, synth_fm_voice_t* fm, uint8_t algorithm, int32_t gain, int32_t gain_step) {
+    fm_kernels[algorithm](mix, num_frames, fm, gain, gain_step);
+}
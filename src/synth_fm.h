@@ -0,0 +1,85 @@
+#ifndef SYNTH_FM_H
+#define SYNTH_FM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "pico.h"
+
+/* Integer FM (phase modulation) voices of two to four sine operators.
+ *
+ * Each operator is a phase accumulator into sine_table scaled by its own
+ * envelope. A modulator's Q15 output is shifted straight into the phase of
+ * the operator below it, so full scale swings that operator's phase by one
+ * whole cycle. The top modulator of every algorithm can modulate itself
+ * through the average of its last two outputs.
+ *
+ * Operator 0 is always a carrier. Every algorithm has its own unrolled
+ * inner loop with the routing fixed at compile time; the per-algorithm
+ * cost on the device is logged by the audio task at startup.
+ */
+
+#define SYNTH_FM_OPS            4
+
+typedef enum {
+    SYNTH_FM_ALG_2OP = 0,       // 1 > 0
+    SYNTH_FM_ALG_3OP_STACK,     // 2 > 1 > 0
+    SYNTH_FM_ALG_3OP_Y,         // 1 + 2 > 0
+    SYNTH_FM_ALG_4OP_STACK,     // 3 > 2 > 1 > 0
+    SYNTH_FM_ALG_4OP_PAIRS,     // 1 > 0 and 3 > 2, two carriers
+    SYNTH_FM_ALG_4OP_BRANCH,    // 3 > 2 and 1, both > 0
+    SYNTH_FM_ALG_COUNT
+} synth_fm_algorithm_t;
+
+typedef struct {
+    uint16_t ratio;         // Q8 multiple of the note frequency
+    uint16_t level;         // Q15 peak output, for a modulator its depth
+    uint16_t attack_ms;     // Linear envelope stage times, 0 jumps
+    uint16_t decay_ms;
+    uint16_t sustain;       // Q15 fraction of level. A carrier decaying to 0 ends the note.
+    uint16_t release_ms;
+} synth_fm_op_t;
+
+typedef struct {
+    uint8_t  algorithm;     // synth_fm_algorithm_t
+    uint16_t feedback;      // Q8 self-modulation of the top modulator, 256 is one cycle at full scale
+    synth_fm_op_t op[SYNTH_FM_OPS];
+} synth_fm_patch_t;
+
+typedef struct {
+    uint32_t phase[SYNTH_FM_OPS];
+    uint32_t increment[SYNTH_FM_OPS];
+    int32_t  level[SYNTH_FM_OPS];       // Q15, ramped per frame by level_step
+    int32_t  level_step[SYNTH_FM_OPS];
+    int32_t  env[SYNTH_FM_OPS];         // Envelope position, Q23
+    uint8_t  stage[SYNTH_FM_OPS];
+    int32_t  feedback;
+    int32_t  fb[2];                     // Last two outputs of the top modulator
+} synth_fm_voice_t;
+
+// Operators the algorithm uses
+uint8_t synth_fm_op_count(uint8_t algorithm);
+
+/* Starts the envelopes. A retriggered voice keeps its phases and levels
+ * so the new attack starts from where the old note was.
+ */
+void synth_fm_note_on(synth_fm_voice_t* fm, const synth_fm_patch_t* patch, bool retrigger);
+void synth_fm_release(synth_fm_voice_t* fm);
+// Sets the operator frequencies from the note's phase increment
+void synth_fm_set_pitch(synth_fm_voice_t* fm, const synth_fm_patch_t* patch, uint32_t increment);
+
+// Envelope rate for synth_fm_update at the given sample rate
+int32_t synth_fm_env_rate(uint32_t rate);
+
+/* Advances the envelopes by frames and sets the level ramps across the
+ * next frames rendered, so an update may cover any run of frames.
+ */
+void synth_fm_update(synth_fm_voice_t* fm, const synth_fm_patch_t* patch, int32_t env_rate, size_t frames);
+
+// True once every carrier has released to silence
+bool synth_fm_finished(const synth_fm_voice_t* fm, const synth_fm_patch_t* patch);
+
+// Adds num_frames of the voice into mix with a Q15 gain ramp
+void synth_fm_accumulate(int32_t* mix, size_t num_frames, synth_fm_voice_t* fm, uint8_t algorithm, int32_t gain, int32_t gain_step);
+
+#endif /* SYNTH_FM_H */
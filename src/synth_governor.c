@@ -0,0 +1,73 @@
+#include "synth_governor.h"
+#include "synth_engine.h"
+
+static uint32_t block_us = 1;
+static uint8_t max_voices = 0;
+static uint8_t tier = SYNTH_TIER_FULL;
+static uint8_t voice_budget = 0;
+static uint32_t calm_blocks = 0;
+static bool settling = false;
+
+void synth_governor_init(uint32_t period_us, uint8_t voices) {
+    block_us = period_us ? period_us : 1;
+    max_voices = voices;
+    voice_budget = voices;
+    tier = SYNTH_TIER_FULL;
+    calm_blocks = 0;
+    settling = false;
+}
+
+static void fill_state(synth_governor_state_t* state, uint32_t load_pct) {
+    state->tier = tier;
+    state->voice_budget = voice_budget;
+    state->level = (uint8_t)((tier != SYNTH_TIER_FULL) + (max_voices - voice_budget));
+    state->load_pct = load_pct;
+}
+
+bool synth_governor_update(uint32_t render_us, uint32_t active_voices, synth_governor_state_t* state) {
+    uint32_t load_pct = (render_us * 100u) / block_us;
+
+    // A shed voice still renders its fade in the block after the step
+    if (settling) {
+        settling = false;
+        return false;
+    }
+
+    if (load_pct >= SYNTH_GOVERNOR_HIGH_PCT) {
+        calm_blocks = 0;
+        settling = true;
+        if (tier == SYNTH_TIER_FULL) {
+            // Cheaper stages first, every voice keeps sounding
+            tier = SYNTH_TIER_REDUCED;
+        } else {
+            // Then shed a voice below what is actually sounding
+            uint8_t budget = (active_voices < voice_budget) ? (uint8_t)active_voices : voice_budget;
+            if (budget <= 1) {
+                return false;   // Nothing left to shed
+            }
+            voice_budget = budget - 1;
+        }
+        fill_state(state, load_pct);
+        return true;
+    }
+
+    if (tier == SYNTH_TIER_FULL || load_pct >= SYNTH_GOVERNOR_LOW_PCT) {
+        calm_blocks = 0;
+        return false;
+    }
+    if (++calm_blocks < SYNTH_GOVERNOR_HOLD_BLOCKS) {
+        return false;
+    }
+    calm_blocks = 0;
+
+    /* Give voices back one at a time while the budget is what limits the
+     * load, all at once when fewer voices are sounding. The tier goes last.
+     */
+    if (voice_budget < max_voices) {
+        voice_budget = (active_voices < voice_budget) ? max_voices : (uint8_t)(voice_budget + 1);
+    } else {
+        tier = SYNTH_TIER_FULL;
+    }
+    fill_state(state, load_pct);
+    return true;
+}
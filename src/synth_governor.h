@@ -0,0 +1,37 @@
+#ifndef SYNTH_GOVERNOR_H
+#define SYNTH_GOVERNOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Render overload governor.
+ *
+ * Fed the render time of every block, it compares it with the block period
+ * and steps through a ladder of degradation levels. The first step lowers
+ * the engine's cost tier, each further step takes one voice off the voice
+ * budget, and the engine sheds its quietest voices to meet it. A block
+ * over the high threshold steps up at once, then one block is skipped while
+ * the shed voices fade. Stepping back down needs SYNTH_GOVERNOR_HOLD_BLOCKS
+ * consecutive blocks under the low threshold, so the level does not
+ * oscillate around the limit.
+ */
+
+#define SYNTH_GOVERNOR_HIGH_PCT     85
+#define SYNTH_GOVERNOR_LOW_PCT      60
+#define SYNTH_GOVERNOR_HOLD_BLOCKS  64
+
+typedef struct {
+    uint8_t  tier;          // synth_cost_tier_t to apply
+    uint8_t  voice_budget;  // Most voices the engine may render
+    uint8_t  level;         // 0 = nothing shed, +1 for the tier, +1 per voice shed
+    uint32_t load_pct;      // Load of the block that caused the change
+} synth_governor_state_t;
+
+void synth_governor_init(uint32_t block_us, uint8_t max_voices);
+
+/* Feeds one block's render time and the voices it rendered. Returns true
+ * when the level changed, with the new settings in state.
+ */
+bool synth_governor_update(uint32_t render_us, uint32_t active_voices, synth_governor_state_t* state);
+
+#endif /* SYNTH_GOVERNOR_H */
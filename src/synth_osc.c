@@ -0,0 +1,160 @@
+#include "synth_osc.h"
+#include "synth_tables.h"
+#include <string.h>
+
+#if PICO_ON_DEVICE
+#include "hardware/interp.h"
+#endif
+
+// Output frames the 2x kernel decimates per pass, bounds its stack buffer
+#define OS_CHUNK_FRAMES     32
+
+// Centre tap of the half-band decimator
+#define HALFBAND_CENTRE     (2 * HALFBAND_PAIRS - 1)
+
+// Shift that leaves the table index scaled to a byte offset into an int16 table
+#define SINE_BYTE_SHIFT     (32 - SINE_TABLE_BITS - 1)
+
+void synth_osc_init(void) {
+#if PICO_ON_DEVICE
+    interp_claim_lane(interp0, 0);
+    interp_claim_lane(interp0, 1);
+#endif
+}
+
+uint32_t __not_in_flash_func(synth_osc_sine_accumulate_sw)(int32_t* mix, size_t num_frames, uint32_t phase, uint32_t increment, int32_t gain, int32_t gain_step) {
+    const uint8_t* base = (const uint8_t*)sine_table;
+    const uint32_t mask = (SINE_TABLE_SIZE - 1) << 1;
+
+#define SW_STEP(k) \
+    mix[k] += (*(const int16_t*)(base + ((phase >> SINE_BYTE_SHIFT) & mask)) * gain) >> 15; \
+    phase += increment; \
+    gain += gain_step;
+
+    size_t blocks = num_frames >> 2;
+    while (blocks--) {
+        SW_STEP(0) SW_STEP(1) SW_STEP(2) SW_STEP(3)
+        mix += 4;
+    }
+    for (size_t i = 0; i < (num_frames & 3); i++) {
+        SW_STEP(i)
+    }
+#undef SW_STEP
+    return phase;
+}
+
+#if PICO_ON_DEVICE
+uint32_t __not_in_flash_func(synth_osc_sine_accumulate_interp)(int32_t* mix, size_t num_frames, uint32_t phase, uint32_t increment, int32_t gain, int32_t gain_step) {
+    // Lane 0: accumulate the increment raw, present (phase >> shift) & mask
+    interp_config cfg = interp_default_config();
+    interp_config_set_add_raw(&cfg, true);
+    interp_config_set_shift(&cfg, SINE_BYTE_SHIFT);
+    interp_config_set_mask(&cfg, 1, SINE_TABLE_BITS);
+    interp_set_config(interp0, 0, &cfg);
+
+    // Lane 1 contributes nothing to the FULL result
+    cfg = interp_default_config();
+    interp_set_config(interp0, 1, &cfg);
+    interp0->accum[1] = 0;
+    interp0->base[1]  = 0;
+
+    interp0->accum[0] = phase;
+    interp0->base[0]  = increment;
+    interp0->base[2]  = (uint32_t)sine_table;
+
+#define INTERP_STEP(k) \
+    mix[k] += (*(const int16_t*)interp0->pop[2] * gain) >> 15; \
+    gain += gain_step;
+
+    size_t blocks = num_frames >> 2;
+    while (blocks--) {
+        INTERP_STEP(0) INTERP_STEP(1) INTERP_STEP(2) INTERP_STEP(3)
+        mix += 4;
+    }
+    for (size_t i = 0; i < (num_frames & 3); i++) {
+        INTERP_STEP(i)
+    }
+#undef INTERP_STEP
+    return interp0->accum[0];
+}
+#endif
+
+// Interpolated sine for the driven voices, whose table steps would alias too
+#define SINE_FRAC_BITS      (32 - SINE_TABLE_BITS)
+
+static inline int32_t sine_at(uint32_t phase) {
+    uint32_t i = phase >> SINE_FRAC_BITS;
+    int32_t a = sine_table[i];
+    int32_t b = sine_table[(i + 1) & (SINE_TABLE_SIZE - 1)];
+    int32_t frac = (int32_t)((phase >> (SINE_FRAC_BITS - 15)) & 0x7FFF);
+    return a + (((b - a) * frac) >> 15);
+}
+
+/* The tanh lookup is interpolated: a truncated lookup is a staircase whose
+ * steps alias no matter how far the voice is oversampled.
+ */
+#define TANH_FRAC_BITS      (16 - TANH_TABLE_BITS)
+
+static inline int32_t saturate(int32_t s, int32_t drive) {
+    int32_t x = (s * drive) >> 8;
+    if (x > INT16_MAX) x = INT16_MAX;
+    if (x < INT16_MIN) x = INT16_MIN;
+    uint32_t u = (uint32_t)(x + 0x8000);
+    uint32_t i = u >> TANH_FRAC_BITS;
+    int32_t a = tanh_table[i];
+    int32_t b = (i + 1 < TANH_TABLE_SIZE) ? tanh_table[i + 1] : a;
+    return a + (((b - a) * (int32_t)(u & ((1u << TANH_FRAC_BITS) - 1))) >> TANH_FRAC_BITS);
+}
+
+uint32_t __not_in_flash_func(synth_osc_drive_accumulate)(int32_t* mix, size_t num_frames, uint32_t phase, uint32_t increment, int32_t gain, int32_t gain_step, int32_t drive) {
+    for (size_t i = 0; i < num_frames; i++) {
+        mix[i] += (saturate(sine_at(phase), drive) * gain) >> 15;
+        phase += increment;
+        gain += gain_step;
+    }
+    return phase;
+}
+
+uint32_t __not_in_flash_func(synth_osc_drive_accumulate_2x)(int32_t* mix, size_t num_frames, uint32_t phase, uint32_t increment, int32_t gain, int32_t gain_step, int32_t drive, int16_t* history) {
+    // Decimator history followed by this pass's 2x samples
+    int16_t buf[SYNTH_OSC_2X_HISTORY + 2 * OS_CHUNK_FRAMES];
+    uint32_t half_increment = increment >> 1;
+
+    while (num_frames > 0) {
+        size_t frames = (num_frames < OS_CHUNK_FRAMES) ? num_frames : OS_CHUNK_FRAMES;
+
+        memcpy(buf, history, sizeof(int16_t) * SYNTH_OSC_2X_HISTORY);
+        int16_t* x = &buf[SYNTH_OSC_2X_HISTORY];
+        for (size_t i = 0; i < 2 * frames; i++) {
+            x[i] = (int16_t)saturate(sine_at(phase), drive);
+            phase += half_increment;
+        }
+
+        /* Output frame m is the filter centred on 2x sample 2m + 1 + centre.
+         * Even offsets from the centre are zero, so only the centre and the
+         * symmetric odd pairs are summed, Q15 with the centre at 1/2.
+         */
+        for (size_t m = 0; m < frames; m++) {
+            const int16_t* w = &buf[2 * m + 1 + HALFBAND_CENTRE];
+            int32_t acc = (int32_t)w[0] << 14;
+            for (int k = 0; k < HALFBAND_PAIRS; k++) {
+                acc += halfband_table[k] * ((int32_t)w[-(2 * k + 1)] + w[2 * k + 1]);
+            }
+            mix[m] += ((acc >> 15) * gain) >> 15;
+            gain += gain_step;
+        }
+
+        memcpy(history, &buf[2 * frames], sizeof(int16_t) * SYNTH_OSC_2X_HISTORY);
+        mix += frames;
+        num_frames -= frames;
+    }
+    return phase;
+}
+
+uint32_t synth_osc_sine_accumulate(int32_t* mix, size_t num_frames, uint32_t phase, uint32_t increment, int32_t gain, int32_t gain_step) {
+#if SYNTH_OSC_USE_INTERP
+    return synth_osc_sine_accumulate_interp(mix, num_frames, phase, increment, gain, gain_step);
+#else
+    return synth_osc_sine_accumulate_sw(mix, num_frames, phase, increment, gain, gain_step);
+#endif
+}
@@ -0,0 +1,62 @@
+#ifndef SYNTH_OSC_H
+#define SYNTH_OSC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "pico.h"
+#include "synth_tables.h"
+
+/* Table-lookup oscillator kernels.
+ *
+ * Phase is a 32-bit accumulator where a full cycle is 2^32, so the table
+ * index is simply the top SINE_TABLE_BITS of the phase.
+ *
+ * On the RP2040 the lookup runs on the core-local INTERP0: lane 0 holds the
+ * phase and adds the increment on every pop, and the FULL result is
+ * base2 (table address) + shifted and masked phase, so each sample's table
+ * address is one register read. The software kernel does the same
+ * arithmetic and is used on the host build; both are always compiled on
+ * the device so they can be timed against each other and compared bit for
+ * bit.
+ */
+
+#ifndef SYNTH_OSC_USE_INTERP
+#define SYNTH_OSC_USE_INTERP    PICO_ON_DEVICE
+#endif
+
+/* Claims the interpolator lanes. Must be called from the core that will
+ * run the oscillator kernels.
+ */
+void synth_osc_init(void);
+
+/* Adds num_frames samples of a sine into mix and returns the advanced
+ * phase. The Q15 gain ramps linearly by gain_step per frame, so parameter
+ * changes cost one add per sample.
+ */
+uint32_t synth_osc_sine_accumulate(int32_t* mix, size_t num_frames, uint32_t phase, uint32_t increment, int32_t gain, int32_t gain_step);
+
+uint32_t synth_osc_sine_accumulate_sw(int32_t* mix, size_t num_frames, uint32_t phase, uint32_t increment, int32_t gain, int32_t gain_step);
+
+/* Driven sine: the sine is scaled by drive (Q8) into the tanh table, whose
+ * input range spans +-4, so drive 256 rounds a full-scale sine well over
+ * and 1024 squares it off. Both lookups are interpolated. The harmonics
+ * the saturator adds reach far past Nyquist.
+ *
+ * The 1x kernel folds them straight back into the audio band. The 2x kernel
+ * runs the oscillator and the waveshaper at twice the sample rate and
+ * decimates with the polyphase half-band filter from halfband_table, which
+ * only evaluates the non-zero odd taps once per output frame. Each voice
+ * keeps SYNTH_OSC_2X_HISTORY input samples of decimator state between
+ * calls, zeroed when the note starts.
+ */
+#define SYNTH_OSC_2X_HISTORY    (HALFBAND_TAPS - 1)
+
+uint32_t synth_osc_drive_accumulate(int32_t* mix, size_t num_frames, uint32_t phase, uint32_t increment, int32_t gain, int32_t gain_step, int32_t drive);
+
+uint32_t synth_osc_drive_accumulate_2x(int32_t* mix, size_t num_frames, uint32_t phase, uint32_t increment, int32_t gain, int32_t gain_step, int32_t drive, int16_t* history);
+
+#if PICO_ON_DEVICE
+uint32_t synth_osc_sine_accumulate_interp(int32_t* mix, size_t num_frames, uint32_t phase, uint32_t increment, int32_t gain, int32_t gain_step);
+#endif
+
+#endif /* SYNTH_OSC_H */
@@ -0,0 +1,71 @@
+#include "synth_presets.h"
+#include <stddef.h>
+
+/* FM patches. Operator fields: ratio (Q8), level (Q15), attack, decay,
+ * sustain (Q15), release.
+ */
+static const synth_fm_patch_t fm_piano = {
+    SYNTH_FM_ALG_4OP_PAIRS, 0, {
+        { 256,  32767, 2, 1800, 0, 300 },
+        { 256,  9000,  1, 900,  0, 300 },
+        { 256,  12000, 1, 400,  0, 200 },
+        { 3584, 5000,  1, 120,  0, 100 },   // 14x tine
+    }
+};
+
+static const synth_fm_patch_t fm_bass = {
+    SYNTH_FM_ALG_2OP, 96, {
+        { 256, 32767, 1, 400, 20000, 80 },
+        { 256, 20000, 1, 250, 6000,  80 },
+    }
+};
+
+static const synth_fm_patch_t fm_bell = {
+    SYNTH_FM_ALG_3OP_Y, 0, {
+        { 256, 32767, 1, 3000, 0, 1500 },
+        { 896, 12000, 1, 2000, 0, 1500 },   // 3.5x
+        { 1810, 4000, 1, 900,  0, 900 },    // 7.07x
+    }
+};
+
+/* String patches: loss while held, loss after release, excitation
+ * brightness, all Q15.
+ */
+static const synth_string_patch_t string_guitar = { 32700, 30000, 24000 };
+static const synth_string_patch_t string_harp   = { 32760, 32200, 12000 };
+
+static const synth_fm_patch_t fm_brass = {
+    SYNTH_FM_ALG_4OP_STACK, 64, {
+        { 256, 32767, 40, 200, 26000, 150 },
+        { 256, 14000, 60, 300, 10000, 150 },
+        { 512, 6000,  20, 200, 4000,  150 },
+        { 256, 4000,  10, 100, 2000,  150 },
+    }
+};
+
+/* Unison patches: oscillators, detune of the outermost (Q16 frequency
+ * offset), stereo spread (Q15).
+ */
+static const synth_unison_patch_t unison_supersaw = { 7, 3300, 26000 };    // +-86 cents
+static const synth_unison_patch_t unison_trio     = { 3, 800,  16000 };    // +-21 cents
+
+// Selected per part with MIDI Program Change, out of range programs are ignored
+const synth_preset_t synth_presets[] = {
+    { "Sine",         SYNTH_VOICE_SINE,   32768 / 8,  256, 0,    128, NULL, NULL, NULL },
+    { "Sine Soft",    SYNTH_VOICE_SINE,   32768 / 16, 128, 0,    128, NULL, NULL, NULL },
+    { "Sine Vibrato", SYNTH_VOICE_SINE,   32768 / 8,  768, 0,    128, NULL, NULL, NULL },
+    // Oversampling thresholds from tools/osc_bench.c: where 1x aliasing rises above -80 dB
+    { "Drive",        SYNTH_VOICE_DRIVE,  32768 / 10, 256, 256,  84,  NULL, NULL, NULL },
+    { "Fuzz",         SYNTH_VOICE_DRIVE,  32768 / 12, 256, 1024, 64,  NULL, NULL, NULL },
+    { "Keys",         SYNTH_VOICE_SAMPLE, 32768 / 8,  128, 0,    128, NULL, NULL, NULL },
+    { "FM Piano",     SYNTH_VOICE_FM,     32768 / 10, 128, 0,    128, &fm_piano, NULL, NULL },
+    { "FM Bass",      SYNTH_VOICE_FM,     32768 / 8,  0,   0,    128, &fm_bass, NULL, NULL },
+    { "FM Bell",      SYNTH_VOICE_FM,     32768 / 10, 0,   0,    128, &fm_bell, NULL, NULL },
+    { "FM Brass",     SYNTH_VOICE_FM,     32768 / 10, 512, 0,    128, &fm_brass, NULL, NULL },
+    { "Guitar",       SYNTH_VOICE_STRING, 32768 / 6,  0,   0,    128, NULL, &string_guitar, NULL },
+    { "Harp",         SYNTH_VOICE_STRING, 32768 / 6,  0,   0,    128, NULL, &string_harp, NULL },
+    { "Supersaw",     SYNTH_VOICE_UNISON, 32768 / 10, 128, 0,    128, NULL, NULL, &unison_supersaw },
+    { "Saw Trio",     SYNTH_VOICE_UNISON, 32768 / 10, 128, 0,    128, NULL, NULL, &unison_trio },
+};
+
+const uint8_t synth_preset_count = sizeof(synth_presets) / sizeof(synth_presets[0]);
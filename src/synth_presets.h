@@ -0,0 +1,33 @@
+#ifndef SYNTH_PRESETS_H
+#define SYNTH_PRESETS_H
+
+#include <stdint.h>
+#include "synth_fm.h"
+#include "synth_string.h"
+#include "synth_unison.h"
+
+typedef enum {
+    SYNTH_VOICE_SINE = 0,
+    SYNTH_VOICE_DRIVE,      // Sine through the tanh saturator
+    SYNTH_VOICE_SAMPLE,     // Streamed PCM from synth_sample_zones
+    SYNTH_VOICE_FM,         // Operators routed by the preset's FM patch
+    SYNTH_VOICE_STRING,     // Karplus-Strong plucked string
+    SYNTH_VOICE_UNISON,     // Detuned band-limited saws
+} synth_voice_type_t;
+
+typedef struct {
+    const char* name;
+    uint8_t  voice_type;    // synth_voice_type_t
+    int32_t  level;         // Q15 voice level before velocity and controllers
+    uint16_t vibrato_depth; // Pitch swing at full modulation, 1/256 semitones
+    uint16_t drive;         // Q8 gain into the saturator, SYNTH_VOICE_DRIVE only
+    uint8_t  oversample_note;   // Notes from this one up render 2x oversampled, 128 = never
+    const synth_fm_patch_t* fm; // SYNTH_VOICE_FM only
+    const synth_string_patch_t* string; // SYNTH_VOICE_STRING only
+    const synth_unison_patch_t* unison; // SYNTH_VOICE_UNISON only
+} synth_preset_t;
+
+extern const synth_preset_t synth_presets[];
+extern const uint8_t synth_preset_count;
+
+#endif /* SYNTH_PRESETS_H */
@@ -0,0 +1,28 @@
+#ifndef SYNTH_SAMPLES_H
+#define SYNTH_SAMPLES_H
+
+#include <stdint.h>
+
+/* Multisampled PCM for the sample voices, generated at build time by
+ * tools/gen_samples.py into synth_samples.c in the build directory and left
+ * in flash. Each zone covers a key and velocity range and is played pitched
+ * relative to its root note. The PCM is mono int16, word aligned, and its
+ * length and loop points are even, so it can be streamed in 32-bit words.
+ */
+typedef struct {
+    const int16_t* data;
+    uint32_t length;        // Frames
+    uint32_t loop_start;    // Playback wraps from loop_end back to loop_start
+    uint32_t loop_end;      // 0 plays the zone once
+    uint32_t sample_rate;
+    uint8_t  root_note;
+    uint8_t  key_lo;        // Inclusive key and velocity ranges
+    uint8_t  key_hi;
+    uint8_t  vel_lo;
+    uint8_t  vel_hi;
+} synth_sample_zone_t;
+
+extern const synth_sample_zone_t synth_sample_zones[];
+extern const uint8_t synth_sample_zone_count;
+
+#endif /* SYNTH_SAMPLES_H */
@@ -0,0 +1,197 @@
+#include "synth_string.h"
+#include "app_config.h"
+#include <string.h>
+
+#define SLOT_FRAMES         (1u << SYNTH_STRING_SLOT_BITS)
+#define SLOT_MASK           (SLOT_FRAMES - 1)
+
+// Q16 delay of the averager, and the least the allpass is left to supply
+#define AVERAGER_DELAY      (1 << 15)
+#define TUNE_MIN            6554        // 0.1 frame, keeps the allpass coefficient well inside the unit circle
+
+// Peak level over a period below which a string is treated as silent, about -66 dB
+#define STRING_FLOOR        16
+
+// Peak of the excitation, leaving the allpass some headroom
+#define PLUCK_LEVEL         24000
+
+typedef struct {
+    uint32_t write;         // Next frame of the line to be written
+    uint32_t length;        // Integer part of the loop delay
+    uint32_t period;        // Whole loop delay, Q16 frames
+    int32_t  tune;          // Allpass coefficient, Q15
+    int32_t  loss;          // Q15
+    int32_t  ap_x1;         // Allpass state
+    int32_t  ap_y1;
+    int32_t  peak;          // Largest output this period
+    int32_t  last_peak;     // And over the previous one
+    uint32_t count;         // Frames into this period
+    uint8_t  used;
+} string_t;
+
+static int16_t pool[SYNTH_STRING_SLOTS][SLOT_FRAMES];
+static string_t strings[SYNTH_STRING_SLOTS];
+static int16_t retune_scratch[SLOT_FRAMES];
+
+static uint32_t noise_seed = 22222;
+
+void synth_string_init(void) {
+    for (int i = 0; i < SYNTH_STRING_SLOTS; i++) {
+        strings[i].used = 0;
+    }
+}
+
+int synth_string_alloc(void) {
+    for (int i = 0; i < SYNTH_STRING_SLOTS; i++) {
+        if (!strings[i].used) {
+            strings[i].used = 1;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void synth_string_free(int slot) {
+    strings[slot].used = 0;
+}
+
+static int32_t noise(void) {
+    noise_seed = noise_seed * 1664525u + 1013904223u;
+    return (int32_t)(noise_seed >> 16) - 32768;
+}
+
+static void set_period(string_t* st, uint32_t increment) {
+    // Period in Q16 frames. Notes too low for the line sound an octave up.
+    uint64_t period = (1ull << 48) / (increment ? increment : 1);
+    while (period > ((uint64_t)(SLOT_FRAMES - 2) << 16)) {
+        period >>= 1;
+    }
+
+    // The allpass makes up the fraction the line and averager leave
+    int32_t total = (int32_t)period - AVERAGER_DELAY;
+    int32_t length = (total - TUNE_MIN) >> 16;
+    if (length < 2) length = 2;
+    int32_t frac = total - (length << 16);
+    st->length = (uint32_t)length;
+    st->period = (uint32_t)period;
+    st->tune = (int32_t)(((int64_t)(65536 - frac) << 15) / (65536 + frac));
+}
+
+void synth_string_pluck(int slot, const synth_string_patch_t* patch, uint32_t increment) {
+    string_t* st = &strings[slot];
+    int16_t* line = pool[slot];
+
+    set_period(st, increment);
+    st->loss = patch->loss;
+    int32_t length = (int32_t)st->length;
+
+    // Lowpassed noise burst over one period, with its DC removed so the
+    // string settles to zero
+    int32_t lp = 0;
+    int32_t sum = 0;
+    for (int32_t i = 0; i <= length; i++) {
+        lp += ((noise() - lp) * patch->brightness) >> 15;
+        line[i] = (int16_t)((lp * PLUCK_LEVEL) >> 15);
+        sum += line[i];
+    }
+    int32_t dc = sum / (length + 1);
+    for (int32_t i = 0; i <= length; i++) {
+        line[i] = (int16_t)(line[i] - dc);
+    }
+
+    st->write = (uint32_t)length + 1;
+    st->ap_x1 = 0;
+    st->ap_y1 = 0;
+    st->peak = 0;
+    st->last_peak = INT16_MAX;
+    st->count = 0;
+}
+
+void synth_string_tune(int slot, uint32_t increment) {
+    string_t* st = &strings[slot];
+    int16_t* line = pool[slot];
+    uint32_t old_length = st->length;
+    uint32_t old_period = st->period;
+
+    set_period(st, increment);
+    if (st->length == old_length) {
+        return;     // The allpass alone takes up the change
+    }
+
+    // Resample the last period into the new length, or the loop would keep
+    // ringing at the old period's pitch. Frame k back from the write
+    // position reads the old waveform 1 + k * old/new frames back.
+    uint32_t ratio = (uint32_t)(((uint64_t)old_period << 16) / st->period);
+    uint32_t w = st->write;
+    for (uint32_t k = 0; k <= st->length; k++) {
+        uint32_t pos = (1u << 16) + k * ratio;
+        uint32_t i = pos >> 16;
+        int32_t f = (int32_t)(pos & 0xFFFF);
+        int32_t a = line[(w - i) & SLOT_MASK];
+        int32_t b = line[(w - i - 1) & SLOT_MASK];
+        retune_scratch[k] = (int16_t)(a + (((b - a) * f) >> 16));
+    }
+    for (uint32_t k = 0; k <= st->length; k++) {
+        line[(w - 1 - k) & SLOT_MASK] = retune_scratch[k];
+    }
+    st->count = 0;
+}
+
+void synth_string_release(int slot, const synth_string_patch_t* patch) {
+    strings[slot].loss = patch->release_loss;
+}
+
+bool __not_in_flash_func(synth_string_accumulate)(int slot, int32_t* mix, size_t num_frames, int32_t gain, int32_t gain_step) {
+    string_t* st = &strings[slot];
+    int16_t* line = pool[slot];
+    uint32_t w = st->write;
+    const uint32_t len = st->length;
+    const int32_t c = st->tune;
+    const int32_t loss = st->loss;
+    int32_t x1 = st->ap_x1;
+    int32_t y1 = st->ap_y1;
+    int32_t peak = st->peak;
+    uint32_t count = st->count;
+
+    for (size_t i = 0; i < num_frames; i++) {
+        // Averager and loss, then the tuning allpass. The loss rounds toward
+        // zero: flooring would hold a decayed string at a small negative DC.
+        int32_t a = line[(w - len) & SLOT_MASK];
+        int32_t b = line[(w - len - 1) & SLOT_MASK];
+        int32_t x = (a + b) * loss;
+        x = (x + ((x >> 31) & 0xFFFF)) >> 16;
+        int32_t y = ((c * (x - y1)) >> 15) + x1;
+        if (y > INT16_MAX) y = INT16_MAX;
+        if (y < INT16_MIN) y = INT16_MIN;
+        x1 = x;
+        y1 = y;
+        line[w & SLOT_MASK] = (int16_t)y;
+        w++;
+
+        mix[i] += (y * gain) >> 15;
+        gain += gain_step;
+
+        int32_t m = (y < 0) ? -y : y;
+        if (m > peak) peak = m;
+        if (++count >= len) {
+            st->last_peak = peak;
+            peak = 0;
+            count = 0;
+        }
+    }
+
+    st->write = w;
+    st->ap_x1 = x1;
+    st->ap_y1 = y1;
+    st->peak = peak;
+    st->count = count;
+    return st->last_peak >= STRING_FLOOR || peak >= STRING_FLOOR;
+}
+
+size_t synth_string_pool_bytes(void) {
+    return sizeof(pool);
+}
+
+uint8_t synth_string_slot_count(void) {
+    return SYNTH_STRING_SLOTS;
+}
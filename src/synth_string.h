@@ -0,0 +1,54 @@
+#ifndef SYNTH_STRING_H
+#define SYNTH_STRING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "pico.h"
+
+/* Karplus-Strong plucked strings.
+ *
+ * A string is a delay line fed back through a two-tap averager, a loss
+ * gain and a first-order allpass that supplies the fractional part of the
+ * period, so the loop delay is length + 1/2 + tune and every note is in
+ * tune. A pluck fills the line with a burst of lowpassed noise; the
+ * averager then darkens and the loss decays it each trip round the loop.
+ *
+ * Delay lines come from a fixed pool of SYNTH_STRING_SLOTS, so the SRAM
+ * cost is set at build time and nothing is allocated while playing. The
+ * pool and the per-frame cost are logged by the audio task at startup.
+ */
+
+typedef struct {
+    uint16_t loss;          // Q15 gain per trip round the loop while the key is held
+    uint16_t release_loss;  // And after it is released
+    uint16_t brightness;    // Q15 coefficient of the excitation lowpass, 32767 is white noise
+} synth_string_patch_t;
+
+void synth_string_init(void);
+
+// Claims a delay line, -1 when the pool is exhausted
+int synth_string_alloc(void);
+void synth_string_free(int slot);
+
+/* Tunes the string in a slot to the note's phase increment and fills it
+ * with a fresh excitation.
+ */
+void synth_string_pluck(int slot, const synth_string_patch_t* patch, uint32_t increment);
+/* Retunes a sounding string to a new increment, after a sample rate
+ * change. When the loop length changes, the last period of the line is
+ * resampled to the new length so the note rings on at its pitch.
+ */
+void synth_string_tune(int slot, uint32_t increment);
+void synth_string_release(int slot, const synth_string_patch_t* patch);
+
+/* Adds num_frames of the string into mix with a Q15 gain ramp. Returns
+ * false once it has decayed below audibility.
+ */
+bool synth_string_accumulate(int slot, int32_t* mix, size_t num_frames, int32_t gain, int32_t gain_step);
+
+// SRAM held by the pool, and its slots
+size_t synth_string_pool_bytes(void);
+uint8_t synth_string_slot_count(void);
+
+#endif /* SYNTH_STRING_H */
@@ -0,0 +1,71 @@
+#ifndef SYNTH_TABLES_H
+#define SYNTH_TABLES_H
+
+#include <stdint.h>
+
+/* Lookup tables generated at build time by tools/gen_tables.py into a single
+ * translation unit (synth_tables.c in the build directory). The sizes are
+ * set per build with the SYNTH_*_TABLE_BITS CMake cache variables, and
+ * SYNTH_TABLE_PRECISION sets how many bits of the int16 amplitude tables
+ * are significant.
+ */
+
+#ifndef SINE_TABLE_BITS
+#define SINE_TABLE_BITS         10
+#endif
+#ifndef EXP2_TABLE_BITS
+#define EXP2_TABLE_BITS         8
+#endif
+#ifndef TANH_TABLE_BITS
+#define TANH_TABLE_BITS         9
+#endif
+#ifndef SVF_COEF_TABLE_BITS
+#define SVF_COEF_TABLE_BITS     8
+#endif
+
+#ifndef SAW_TABLE_BITS
+#define SAW_TABLE_BITS          9
+#endif
+
+#ifndef HALFBAND_PAIRS
+#define HALFBAND_PAIRS          10
+#endif
+
+#define SINE_TABLE_SIZE         (1u << SINE_TABLE_BITS)
+#define EXP2_TABLE_SIZE         (1u << EXP2_TABLE_BITS)
+#define TANH_TABLE_SIZE         (1u << TANH_TABLE_BITS)
+#define SVF_COEF_TABLE_SIZE     (1u << SVF_COEF_TABLE_BITS)
+#define SAW_TABLE_SIZE          (1u << SAW_TABLE_BITS)
+#define SAW_TABLE_LEVELS        (SAW_TABLE_BITS - 1)
+
+/* One sine cycle, amplitude 32767 */
+extern const int16_t sine_table[SINE_TABLE_SIZE];
+
+/* 2^(i / EXP2_TABLE_SIZE) over one octave, Q30 */
+extern const uint32_t exp2_table[EXP2_TABLE_SIZE];
+
+/* tanh(x) for x in [-4, 4), amplitude 32767. Index with the top
+ * TANH_TABLE_BITS of a 16-bit input offset by 0x8000.
+ */
+extern const int16_t tanh_table[TANH_TABLE_SIZE];
+
+/* SVF tuning coefficient 2*sin(pi * fc / fs) in Q14, indexed linearly by
+ * fc / fs over [0, 0.5).
+ */
+extern const uint16_t svf_coef_table[SVF_COEF_TABLE_SIZE];
+
+/* 2x decimator half-band coefficients in Q15 at odd offsets 1, 3, ...
+ * 2 * HALFBAND_PAIRS - 1 from the centre tap, which is 1/2. The other taps
+ * are zero.
+ */
+#define HALFBAND_TAPS           (4 * HALFBAND_PAIRS - 1)
+extern const int16_t halfband_table[HALFBAND_PAIRS];
+
+/* Band-limited sawtooth, one level of SAW_TABLE_SIZE per octave of pitch.
+ * Level k holds harmonics up to 2^(SAW_TABLE_BITS - 1 - k) - 1, so it is
+ * alias free for phase increments up to 2^(32 - SAW_TABLE_BITS + k). The
+ * last level is a sine. All levels share one scale.
+ */
+extern const int16_t saw_table[SAW_TABLE_LEVELS * SAW_TABLE_SIZE];
+
+#endif /* SYNTH_TABLES_H */
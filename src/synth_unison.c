@@ -0,0 +1,137 @@
+#include "synth_unison.h"
+#include "synth_tables.h"
+
+// Phase bits below the saw table index
+#define SAW_FRAC_BITS       (32 - SAW_TABLE_BITS)
+
+/* Detune of each oscillator for each count, Q15 of the outermost. The
+ * spacing follows the classic supersaw: the inner pairs sit closer to the
+ * centre, so the beating is uneven instead of one slow sweep.
+ */
+static const int16_t unison_positions[SYNTH_UNISON_MAX][SYNTH_UNISON_MAX] = {
+    { 0 },
+    { -32767, 32767 },
+    { -32767, 0, 32767 },
+    { -32767, -11470, 11470, 32767 },
+    { -32767, -14750, 0, 14750, 32767 },
+    { -32767, -18730, -5820, 5820, 18730, 32767 },
+    { -32767, -18730, -5820, 0, 5820, 18730, 32767 },
+};
+
+// 1 / sqrt(count) in Q15: detuned oscillators add up in power, not amplitude
+static const int32_t unison_norm[SYNTH_UNISON_MAX] = {
+    32768, 23170, 18919, 16384, 14654, 13377, 12385,
+};
+
+static uint32_t phase_seed = 12345;
+
+void synth_unison_note_on(synth_unison_voice_t* u, const synth_unison_patch_t* patch, bool retrigger) {
+    uint8_t count = patch->voices;
+    if (count < 1) count = 1;
+    if (count > SYNTH_UNISON_MAX) count = SYNTH_UNISON_MAX;
+    int32_t detune = (patch->detune > INT16_MAX) ? INT16_MAX : patch->detune;
+
+    const int16_t* pos = unison_positions[count - 1];
+    for (uint8_t k = 0; k < count; k++) {
+        u->detune[k] = (int16_t)((pos[k] * detune) >> 15);
+        u->side[k]   = (int16_t)((pos[k] * (int32_t)patch->spread) >> 18);
+        if (!retrigger || k >= u->count) {
+            phase_seed = phase_seed * 1664525u + 1013904223u;
+            u->phase[k] = phase_seed;
+        }
+    }
+    u->count = count;
+}
+
+// The level of saw_table whose top harmonic stays below Nyquist
+static const int16_t* saw_level(uint32_t increment) {
+    int level = (increment > 1) ? (32 - __builtin_clz(increment - 1)) - (32 - SAW_TABLE_BITS) : 0;
+    if (level < 0) level = 0;
+    if (level > (int)SAW_TABLE_LEVELS - 1) level = SAW_TABLE_LEVELS - 1;
+    return &saw_table[(uint32_t)level << SAW_TABLE_BITS];
+}
+
+static inline int32_t saw_at(const int16_t* table, uint32_t phase) {
+    uint32_t i = phase >> SAW_FRAC_BITS;
+    int32_t a = table[i];
+    int32_t b = table[(i + 1) & (SAW_TABLE_SIZE - 1)];
+    int32_t frac = (int32_t)((phase >> (SAW_FRAC_BITS - 15)) & 0x7FFF);
+    return a + (((b - a) * frac) >> 15);
+}
+
+/* Kernel building blocks. Each count keeps its oscillators in locals for
+ * the whole run and writes the phases back at the end.
+ */
+#define UN_LOAD(k) \
+    uint32_t p##k = u->phase[k]; \
+    const uint32_t i##k = increment + (uint32_t)((int32_t)(increment >> 16) * u->detune[k]); \
+    const int32_t w##k = u->side[k];
+
+#define UN_SAVE(k) \
+    u->phase[k] = p##k;
+
+// One oscillator into the frame's mid sum m and Q12 side sum d
+#define UN_OSC(k) { \
+    int32_t s = saw_at(table, p##k); \
+    m += s; \
+    d += s * w##k; \
+    p##k += i##k; \
+}
+
+// Seven full-scale oscillators sum to 18 bits, pre-shifted to fit the gain product
+#define UN_OUT_MIX \
+    mid[n]  += ((m >> 2) * gain) >> 13; \
+    side[n] += ((d >> 14) * gain) >> 13; \
+    gain += gain_step;
+
+#define UN_KERNEL(count, EACH) \
+static void __not_in_flash_func(unison_##count)(int32_t* mid, int32_t* side, size_t num_frames, synth_unison_voice_t* u, \
+                                                const int16_t* table, uint32_t increment, int32_t gain, int32_t gain_step) { \
+    EACH(UN_LOAD) \
+    for (size_t n = 0; n < num_frames; n++) { \
+        int32_t m = 0; \
+        int32_t d = 0; \
+        EACH(UN_OSC) \
+        UN_OUT_MIX \
+    } \
+    EACH(UN_SAVE) \
+}
+
+#define UN_EACH_1(X)    X(0)
+#define UN_EACH_2(X)    X(0) X(1)
+#define UN_EACH_3(X)    X(0) X(1) X(2)
+#define UN_EACH_4(X)    X(0) X(1) X(2) X(3)
+#define UN_EACH_5(X)    X(0) X(1) X(2) X(3) X(4)
+#define UN_EACH_6(X)    X(0) X(1) X(2) X(3) X(4) X(5)
+#define UN_EACH_7(X)    X(0) X(1) X(2) X(3) X(4) X(5) X(6)
+
+UN_KERNEL(1, UN_EACH_1)
+UN_KERNEL(2, UN_EACH_2)
+UN_KERNEL(3, UN_EACH_3)
+UN_KERNEL(4, UN_EACH_4)
+UN_KERNEL(5, UN_EACH_5)
+UN_KERNEL(6, UN_EACH_6)
+UN_KERNEL(7, UN_EACH_7)
+
+typedef void (*unison_kernel_t)(int32_t* mid, int32_t* side, size_t num_frames, synth_unison_voice_t* u,
+                                const int16_t* table, uint32_t increment, int32_t gain, int32_t gain_step);
+
+static const unison_kernel_t unison_kernels[SYNTH_UNISON_MAX] = {
+    unison_1,
+    unison_2,
+    unison_3,
+    unison_4,
+    unison_5,
+    unison_6,
+    unison_7,
+};
+
+void synth_unison_accumulate(int32_t* mid, int32_t* side, size_t num_frames, synth_unison_voice_t* u,
+                             uint32_t increment, int32_t gain, int32_t gain_step) {
+    // The positions ascend, so the last oscillator is the sharpest
+    uint8_t count = u->count;
+    uint32_t sharpest = increment + (uint32_t)((int32_t)(increment >> 16) * u->detune[count - 1]);
+    int32_t norm = unison_norm[count - 1];
+    unison_kernels[count - 1](mid, side, num_frames, u, saw_level(sharpest), increment,
+                              (gain * norm) >> 15, (gain_step * norm) >> 15);
+}
@@ -0,0 +1,52 @@
+#ifndef SYNTH_UNISON_H
+#define SYNTH_UNISON_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "pico.h"
+
+/* Unison voices: up to SYNTH_UNISON_MAX detuned band-limited saws per note,
+ * spread across the stereo field.
+ *
+ * The oscillators of a note run together in one pass over the block. They
+ * share one level of saw_table, picked for the sharpest of them, and one
+ * gain ramp applied to their sum, so each extra oscillator costs only its
+ * interpolated lookup. Their increments come from the note's increment
+ * and detune offsets worked out at note on, so vibrato costs no more than
+ * for a single oscillator.
+ *
+ * The output is mid and side, which the engine pans onto the stereo bus.
+ * Every unison count has its own unrolled kernel; the cost of each on the
+ * device is logged by the audio task at startup.
+ */
+
+#define SYNTH_UNISON_MAX        7
+
+typedef struct {
+    uint8_t  voices;        // Oscillators per note, 1 to SYNTH_UNISON_MAX
+    uint16_t detune;        // Q16 frequency offset of the outermost oscillators
+    uint16_t spread;        // Q15 stereo width, 0 is mono
+} synth_unison_patch_t;
+
+typedef struct {
+    uint32_t phase[SYNTH_UNISON_MAX];
+    int16_t  detune[SYNTH_UNISON_MAX];  // Q16 offset from the note's increment
+    int16_t  side[SYNTH_UNISON_MAX];    // Q12 weight in the side signal
+    uint8_t  count;
+} synth_unison_voice_t;
+
+/* Sets up the oscillators for the patch. A new note starts them at
+ * scattered phases, as free-running oscillators would be; a retriggered
+ * one keeps its phases.
+ */
+void synth_unison_note_on(synth_unison_voice_t* u, const synth_unison_patch_t* patch, bool retrigger);
+
+/* Adds num_frames of the voice at the note's increment into mid and side,
+ * with a Q15 gain ramp. The sum is scaled by 1/sqrt(count), so every count
+ * sounds about as loud.
+ */
+void synth_unison_accumulate(int32_t* mid, int32_t* side, size_t num_frames, synth_unison_voice_t* u,
+                             uint32_t increment, int32_t gain, int32_t gain_step);
+
+#endif /* SYNTH_UNISON_H */
@@ -0,0 +1,125 @@
+#include "trace.h"
+
+#if TRACE_ENABLE
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "log_task.h"
+#include <stdio.h>
+
+#define TRACE_INDEX_MASK    (TRACE_EVENTS_PER_CORE - 1)
+#define TRACE_DUMP_BURST    8   // Log messages between pauses while dumping
+
+_Static_assert((TRACE_EVENTS_PER_CORE & TRACE_INDEX_MASK) == 0, "TRACE_EVENTS_PER_CORE must be a power of two");
+
+typedef struct {
+    trace_event_t events[TRACE_EVENTS_PER_CORE];
+    uint32_t head;          // Total events written, wraps into the ring
+} trace_ring_t;
+
+static trace_ring_t rings[configNUM_CORES];
+static volatile bool frozen = false;
+static uint32_t overhead_ns = 0;
+
+static const char* const task_names[TRACE_TASK_COUNT] = {
+    "Other", "Log", "Audio", "MIDI", "USB", "Alive"
+};
+
+static const char* const isr_names[TRACE_ISR_COUNT] = {
+    "DMA I2S", "UART MIDI", "UART Log"
+};
+
+void __not_in_flash_func(trace_record)(trace_event_type_t type, uint16_t arg) {
+    if (frozen) return;
+
+    uint32_t save = save_and_disable_interrupts();
+    trace_ring_t* ring = &rings[get_core_num()];
+    trace_event_t* ev = &ring->events[ring->head & TRACE_INDEX_MASK];
+    ev->timestamp_us = timer_hw->timerawl;
+    ev->type = (uint8_t)type;
+    ev->arg = arg;
+    ring->head++;
+    restore_interrupts(save);
+}
+
+static void trace_clear(void) {
+    for (int c = 0; c < configNUM_CORES; c++) {
+        rings[c].head = 0;
+    }
+}
+
+void trace_init(void) {
+    // Time a burst of events against the microsecond timer
+    const uint32_t count = 4 * TRACE_EVENTS_PER_CORE;
+    uint32_t start = time_us_32();
+    for (uint32_t i = 0; i < count; i++) {
+        trace_record(TRACE_EV_TASK_IN, 0);
+    }
+    overhead_ns = ((time_us_32() - start) * 1000u) / count;
+
+    trace_clear();
+    frozen = false;
+}
+
+void trace_freeze(void) {
+    frozen = true;
+}
+
+bool trace_is_frozen(void) {
+    return frozen;
+}
+
+uint32_t trace_get_overhead_ns(void) {
+    return overhead_ns;
+}
+
+static void dump_pause(uint32_t* lines) {
+    if (++(*lines) % TRACE_DUMP_BURST == 0) {
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
+}
+
+/* Dump format, one record per log line:
+ *   TRACE task <number> <name>
+ *   TRACE isr <number> <name>
+ *   TRACE ev <core> <timestamp_us> <type> <arg>
+ */
+void trace_dump(void) {
+    char msg_buf[64];
+    uint32_t lines = 0;
+
+    snprintf(msg_buf, sizeof(msg_buf), "TRACE begin %lu ns/event", overhead_ns);
+    log_msg(msg_buf);
+    for (int t = 0; t < TRACE_TASK_COUNT; t++) {
+        snprintf(msg_buf, sizeof(msg_buf), "TRACE task %d %s", t, task_names[t]);
+        log_msg(msg_buf);
+        dump_pause(&lines);
+    }
+    for (int i = 0; i < TRACE_ISR_COUNT; i++) {
+        snprintf(msg_buf, sizeof(msg_buf), "TRACE isr %d %s", i, isr_names[i]);
+        log_msg(msg_buf);
+        dump_pause(&lines);
+    }
+
+    for (int c = 0; c < configNUM_CORES; c++) {
+        trace_ring_t* ring = &rings[c];
+        uint32_t count = (ring->head < TRACE_EVENTS_PER_CORE) ? ring->head : TRACE_EVENTS_PER_CORE;
+        uint32_t first = ring->head - count;
+
+        for (uint32_t i = 0; i < count; i++) {
+            const trace_event_t* ev = &ring->events[(first + i) & TRACE_INDEX_MASK];
+            snprintf(msg_buf, sizeof(msg_buf), "TRACE ev %d %lu %u %u",
+                     c, ev->timestamp_us, ev->type, ev->arg);
+            log_msg(msg_buf);
+            dump_pause(&lines);
+        }
+    }
+    log_msg("TRACE end");
+
+    trace_clear();
+    frozen = false;
+}
+
+#endif /* TRACE_ENABLE */
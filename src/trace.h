@@ -0,0 +1,98 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico.h"
+
+/* Lightweight event trace for chasing audio glitches.
+ *
+ * Each core records into its own ring of 8-byte events stamped with the
+ * microsecond timer, so recording takes no lock, only a short interrupt
+ * mask against ISRs on the same core. Context switches come from the
+ * FreeRTOS traceTASK_SWITCHED_IN hook, ISR entry/exit and the audio render
+ * from explicit markers.
+ *
+ * When the audio task sees an xrun it freezes the trace, and the Alive task
+ * dumps both rings over the log UART. tools/trace_to_json.py turns the dump
+ * into a Chrome/Perfetto timeline.
+ *
+ * This header is included from FreeRTOSConfig.h, so it must not include
+ * any FreeRTOS header.
+ */
+
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE        1
+#endif
+
+#define TRACE_EVENTS_PER_CORE   512     // Power of two
+
+typedef enum {
+    TRACE_EV_TASK_IN = 0,   // arg = trace_task_t
+    TRACE_EV_ISR_ENTER,     // arg = trace_isr_t
+    TRACE_EV_ISR_EXIT,      // arg = trace_isr_t
+    TRACE_EV_AUDIO_WAKE,    // Audio task woken by the DMA ISR's block notification
+    TRACE_EV_RENDER_BEGIN,
+    TRACE_EV_RENDER_END,
+    TRACE_EV_XRUN,          // DMA reached the block before its render finished
+} trace_event_type_t;
+
+// Task numbers, set with vTaskSetTaskNumber. Kernel tasks keep 0.
+typedef enum {
+    TRACE_TASK_OTHER = 0,
+    TRACE_TASK_LOG,
+    TRACE_TASK_AUDIO,
+    TRACE_TASK_MIDI,
+    TRACE_TASK_USB,
+    TRACE_TASK_ALIVE,
+    TRACE_TASK_COUNT
+} trace_task_t;
+
+typedef enum {
+    TRACE_ISR_DMA_I2S = 0,
+    TRACE_ISR_UART_MIDI,
+    TRACE_ISR_UART_LOG,
+    TRACE_ISR_COUNT
+} trace_isr_t;
+
+typedef struct {
+    uint32_t timestamp_us;
+    uint8_t  type;          // trace_event_type_t
+    uint8_t  reserved;
+    uint16_t arg;
+} trace_event_t;
+
+#if TRACE_ENABLE
+
+/* Measures the cost of one trace_record() call and clears the rings.
+ * Call once before the scheduler starts.
+ */
+void trace_init(void);
+void trace_record(trace_event_type_t type, uint16_t arg);
+
+// Stops recording so the events leading up to a fault are kept
+void trace_freeze(void);
+bool trace_is_frozen(void);
+
+/* Writes both rings to the log, pacing itself so the log queue is not
+ * overrun, then resumes recording. Call from a low priority task.
+ */
+void trace_dump(void);
+
+// Cost of one event in nanoseconds, measured by trace_init()
+uint32_t trace_get_overhead_ns(void);
+
+#define TRACE_RECORD(type, arg)     trace_record((type), (arg))
+
+#else
+
+#define trace_init()                do { } while (0)
+#define trace_freeze()              do { } while (0)
+#define trace_is_frozen()           false
+#define trace_dump()                do { } while (0)
+#define trace_get_overhead_ns()     0u
+#define TRACE_RECORD(type, arg)     do { } while (0)
+
+#endif /* TRACE_ENABLE */
+
+#endif /* TRACE_H */
@@ -0,0 +1,32 @@
+#ifndef TUSB_CONFIG_H
+#define TUSB_CONFIG_H
+
+/* TinyUSB configuration: a full-speed, class-compliant USB-MIDI device
+ * running under FreeRTOS.
+ */
+
+#define CFG_TUSB_RHPORT0_MODE       OPT_MODE_DEVICE
+#define CFG_TUSB_OS                 OPT_OS_FREERTOS
+
+#ifndef CFG_TUSB_MEM_SECTION
+#define CFG_TUSB_MEM_SECTION
+#endif
+
+#ifndef CFG_TUSB_MEM_ALIGN
+#define CFG_TUSB_MEM_ALIGN          __attribute__ ((aligned(4)))
+#endif
+
+#define CFG_TUD_ENDPOINT0_SIZE      64
+
+/* Device classes */
+#define CFG_TUD_CDC                 0
+#define CFG_TUD_MSC                 0
+#define CFG_TUD_HID                 0
+#define CFG_TUD_MIDI                1
+#define CFG_TUD_VENDOR              0
+
+/* MIDI FIFO sizes, in bytes (4 bytes per event packet) */
+#define CFG_TUD_MIDI_RX_BUFSIZE     256
+#define CFG_TUD_MIDI_TX_BUFSIZE     64
+
+#endif /* TUSB_CONFIG_H */
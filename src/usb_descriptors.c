@@ -0,0 +1,87 @@
+#include <string.h>
+#include "tusb.h"
+
+/* Descriptors for a single-port, class-compliant USB-MIDI device. */
+
+#define USB_VID     0xCafe  // TinyUSB test VID, replace for production
+#define USB_PID     0x4008  // TinyUSB convention: bit 3 marks a MIDI interface
+#define USB_BCD     0x0200
+
+enum {
+    ITF_NUM_MIDI = 0,
+    ITF_NUM_MIDI_STREAMING,
+    ITF_NUM_TOTAL
+};
+
+#define EPNUM_MIDI_OUT  0x01
+#define EPNUM_MIDI_IN   0x81
+
+#define CONFIG_TOTAL_LEN    (TUD_CONFIG_DESC_LEN + TUD_MIDI_DESC_LEN)
+
+static const tusb_desc_device_t desc_device = {
+    .bLength            = sizeof(tusb_desc_device_t),
+    .bDescriptorType    = TUSB_DESC_DEVICE,
+    .bcdUSB             = USB_BCD,
+    .bDeviceClass       = 0x00, // Class is defined per interface
+    .bDeviceSubClass    = 0x00,
+    .bDeviceProtocol    = 0x00,
+    .bMaxPacketSize0    = CFG_TUD_ENDPOINT0_SIZE,
+    .idVendor           = USB_VID,
+    .idProduct          = USB_PID,
+    .bcdDevice          = 0x0100,
+    .iManufacturer      = 0x01,
+    .iProduct           = 0x02,
+    .iSerialNumber      = 0x03,
+    .bNumConfigurations = 0x01
+};
+
+static const uint8_t desc_configuration[] = {
+    // Config number, interface count, string index, total length, attribute, power in mA
+    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, 0x00, 100),
+
+    // Interface number, string index, EP Out & EP In address, EP size
+    TUD_MIDI_DESCRIPTOR(ITF_NUM_MIDI, 0, EPNUM_MIDI_OUT, EPNUM_MIDI_IN, 64)
+};
+
+static const char* string_desc_arr[] = {
+    (const char[]) { 0x09, 0x04 },  // 0: supported language is English (0x0409)
+    "picosynth",                    // 1: Manufacturer
+    "picosynth MIDI",               // 2: Product
+    "000001",                       // 3: Serial
+};
+
+static uint16_t desc_str[32];
+
+const uint8_t* tud_descriptor_device_cb(void) {
+    return (const uint8_t*)&desc_device;
+}
+
+const uint8_t* tud_descriptor_configuration_cb(uint8_t index) {
+    (void)index;
+    return desc_configuration;
+}
+
+const uint16_t* tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
+    (void)langid;
+    uint8_t chr_count;
+
+    if (index == 0) {
+        memcpy(&desc_str[1], string_desc_arr[0], 2);
+        chr_count = 1;
+    } else {
+        if (index >= sizeof(string_desc_arr) / sizeof(string_desc_arr[0])) return NULL;
+
+        const char* str = string_desc_arr[index];
+        chr_count = (uint8_t)strlen(str);
+        if (chr_count > 31) chr_count = 31;
+
+        // Convert ASCII string into UTF-16
+        for (uint8_t i = 0; i < chr_count; i++) {
+            desc_str[1 + i] = str[i];
+        }
+    }
+
+    // First byte is length (including header), second byte is string type
+    desc_str[0] = (uint16_t)((TUSB_DESC_STRING << 8) | (2 * chr_count + 2));
+    return desc_str;
+}
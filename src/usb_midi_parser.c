@@ -0,0 +1,32 @@
+#include "usb_midi_parser.h"
+
+// Code Index Numbers, the low nibble of the first packet byte
+#define CIN_SYSCOMMON_2     0x2
+#define CIN_SYSCOMMON_3     0x3
+#define CIN_NOTE_OFF        0x8
+#define CIN_PITCH_BEND      0xE
+#define CIN_SINGLE_BYTE     0xF
+
+bool usb_midi_parse_packet(const uint8_t packet[4], uint32_t timestamp_us, midi_message_t* msg) {
+    uint8_t cin = packet[0] & 0x0F;
+    uint8_t status = packet[1];
+
+    if (cin >= CIN_NOTE_OFF && cin <= CIN_PITCH_BEND) {
+        // Channel voice: the CIN repeats the command nibble of the status
+        if ((status >> 4) != cin) return false;
+    } else if (cin == CIN_SYSCOMMON_2 || cin == CIN_SYSCOMMON_3) {
+        if (status != 0xF1 && status != 0xF2 && status != 0xF3) return false;
+    } else if (cin == CIN_SINGLE_BYTE) {
+        if (status < 0xF8) return false;
+    } else {
+        // SysEx (0x4 - 0x7) and reserved CINs
+        return false;
+    }
+
+    msg->timestamp_us = timestamp_us;
+    msg->source = MIDI_SOURCE_USB;
+    msg->status = status;
+    msg->data1 = packet[2] & 0x7F;
+    msg->data2 = packet[3] & 0x7F;
+    return true;
+}
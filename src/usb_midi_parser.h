@@ -0,0 +1,15 @@
+#ifndef USB_MIDI_PARSER_H
+#define USB_MIDI_PARSER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "midi_parser.h"
+
+/* Decodes one 4-byte USB-MIDI event packet (cable/CIN byte followed by up
+ * to three MIDI bytes). Each packet carries a whole message, so no state
+ * is kept between calls. Returns true and fills msg for channel voice,
+ * system common and real-time messages; SysEx packets are ignored.
+ */
+bool usb_midi_parse_packet(const uint8_t packet[4], uint32_t timestamp_us, midi_message_t* msg);
+
+#endif /* USB_MIDI_PARSER_H */
@@ -0,0 +1,41 @@
+#include "FreeRTOS.h"
+#include "task.h"
+#include "usb_task.h"
+#include "tusb.h"
+#include "pico/stdlib.h"
+#include "log_task.h"
+#include "midi_task.h"
+#include "usb_midi_parser.h"
+#include "app_config.h"
+
+/* Called by TinyUSB from tud_task() when MIDI event packets arrive. Whole
+ * 4-byte packets are decoded and handed to the MIDI task for merging with
+ * the DIN input.
+ */
+void tud_midi_rx_cb(uint8_t itf) {
+    (void)itf;
+    uint8_t packet[4];
+
+    while (tud_midi_packet_read(packet)) {
+        midi_message_t msg;
+        if (usb_midi_parse_packet(packet, time_us_32(), &msg)) {
+            vMidiTaskPostMessage(&msg);
+        }
+    }
+}
+
+void vUsbTaskInit(void)
+{
+    tusb_init();
+}
+
+void vUsbTask(void *pvParameters)
+{
+    log_msg("USB Task Initialized");
+
+	for( ;; )
+    {
+        // Blocks on the TinyUSB event queue, returns once it is drained
+        tud_task();
+    }
+}
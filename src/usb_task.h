@@ -0,0 +1,10 @@
+#ifndef USB_TASK_H
+#define USB_TASK_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+void vUsbTaskInit(void);
+void vUsbTask(void *pvParameters);
+
+#endif // USB_TASK_H
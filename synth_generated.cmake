@@ -0,0 +1,56 @@
+# Rules for the generated sources the engine links against: the lookup
+# tables from tools/gen_tables.py and the demo sample bank from
+# tools/gen_samples.py. Sets SYNTH_TABLES_C, SYNTH_SAMPLES_C and the
+# SYNTH_TABLE_DEFINITIONS every target compiling the engine needs.
+#
+# Included by the firmware build and by bench/CMakeLists.txt, so both
+# always run the same tables.
+
+# Lookup table sizes and precision. Larger tables cost flash but reduce the
+# lookup error; gen_tables.py reports both for each configuration.
+set(SYNTH_SINE_TABLE_BITS 10 CACHE STRING "log2 of the sine table length")
+set(SYNTH_EXP2_TABLE_BITS 8 CACHE STRING "log2 of the pitch exponent table length")
+set(SYNTH_TANH_TABLE_BITS 9 CACHE STRING "log2 of the tanh saturation table length")
+set(SYNTH_SVF_COEF_TABLE_BITS 8 CACHE STRING "log2 of the filter coefficient table length")
+set(SYNTH_SAW_TABLE_BITS 9 CACHE STRING "log2 of the length of each band-limited saw level")
+set(SYNTH_HALFBAND_PAIRS 10 CACHE STRING "Coefficient pairs of the 2x oversampling decimator")
+set(SYNTH_TABLE_PRECISION 16 CACHE STRING "Significant bits in the int16 amplitude tables")
+
+find_package(Python3 REQUIRED COMPONENTS Interpreter)
+
+set(SYNTH_TABLES_C ${CMAKE_CURRENT_BINARY_DIR}/generated/synth_tables.c)
+add_custom_command(
+        OUTPUT ${SYNTH_TABLES_C}
+        COMMAND ${CMAKE_COMMAND} -E make_directory ${CMAKE_CURRENT_BINARY_DIR}/generated
+        COMMAND Python3::Interpreter ${CMAKE_CURRENT_LIST_DIR}/tools/gen_tables.py
+                --out ${SYNTH_TABLES_C}
+                --sine-bits ${SYNTH_SINE_TABLE_BITS}
+                --exp2-bits ${SYNTH_EXP2_TABLE_BITS}
+                --tanh-bits ${SYNTH_TANH_TABLE_BITS}
+                --svf-bits ${SYNTH_SVF_COEF_TABLE_BITS}
+                --saw-bits ${SYNTH_SAW_TABLE_BITS}
+                --halfband-pairs ${SYNTH_HALFBAND_PAIRS}
+                --precision ${SYNTH_TABLE_PRECISION}
+        DEPENDS ${CMAKE_CURRENT_LIST_DIR}/tools/gen_tables.py
+        COMMENT "Generating synth lookup tables"
+        VERBATIM)
+
+# Demo PCM for the sample voices, streamed from flash at runtime
+set(SYNTH_SAMPLES_C ${CMAKE_CURRENT_BINARY_DIR}/generated/synth_samples.c)
+add_custom_command(
+        OUTPUT ${SYNTH_SAMPLES_C}
+        COMMAND ${CMAKE_COMMAND} -E make_directory ${CMAKE_CURRENT_BINARY_DIR}/generated
+        COMMAND Python3::Interpreter ${CMAKE_CURRENT_LIST_DIR}/tools/gen_samples.py
+                --out ${SYNTH_SAMPLES_C}
+        DEPENDS ${CMAKE_CURRENT_LIST_DIR}/tools/gen_samples.py
+        COMMENT "Generating sample bank"
+        VERBATIM)
+
+set(SYNTH_TABLE_DEFINITIONS
+        SINE_TABLE_BITS=${SYNTH_SINE_TABLE_BITS}
+        EXP2_TABLE_BITS=${SYNTH_EXP2_TABLE_BITS}
+        TANH_TABLE_BITS=${SYNTH_TANH_TABLE_BITS}
+        SVF_COEF_TABLE_BITS=${SYNTH_SVF_COEF_TABLE_BITS}
+        HALFBAND_PAIRS=${SYNTH_HALFBAND_PAIRS}
+        SAW_TABLE_BITS=${SYNTH_SAW_TABLE_BITS}
+        )
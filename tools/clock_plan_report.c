@@ -0,0 +1,53 @@
+/* Host report of the clock plans the firmware would choose.
+ *
+ * Runs clock_plan_search for the common sample rates with the I2S
+ * parameters of i2s_config_default and the system clock window from
+ * app_config.h, and prints the PLL setting, PIO dividers, rate error and
+ * divider jitter of each.
+ *
+ * Build and run from the repository root:
+ *
+ *   cc -O2 -Isrc -Itools/host tools/clock_plan_report.c src/clock_plan.c -o /tmp/clock_plan_report
+ *   /tmp/clock_plan_report [sys_min_khz sys_max_khz]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "clock_plan.h"
+
+// Mirrors i2s_config_default, i2s.pio and app_config.h
+#define SCK_MULT        256
+#define BIT_DEPTH       16
+#define PIO_MULT        2
+#define SYS_MIN_KHZ     100000
+#define SYS_MAX_KHZ     133000
+
+int main(int argc, char** argv) {
+    static const uint32_t rates[] = { 22050, 32000, 44100, 48000, 88200, 96000 };
+    uint32_t sys_min_khz = (argc > 2) ? (uint32_t)strtoul(argv[1], NULL, 10) : SYS_MIN_KHZ;
+    uint32_t sys_max_khz = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 10) : SYS_MAX_KHZ;
+
+    printf("clk_sys %u-%u kHz\n", (unsigned)sys_min_khz, (unsigned)sys_max_khz);
+    printf("%8s %10s %5s %5s %12s %12s %14s %10s %10s\n",
+           "fs", "sys kHz", "fbdiv", "post", "SCK div", "BCK div", "attained Hz", "error ppb", "jitter ps");
+
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        clock_plan_request_t req = {
+            rates[i], SCK_MULT, BIT_DEPTH, PIO_MULT, PIO_MULT, sys_min_khz * 1000u, sys_max_khz * 1000u
+        };
+        clock_plan_t plan;
+        if (!clock_plan_search(&req, &plan)) {
+            printf("%8u  no plan\n", (unsigned)rates[i]);
+            failures++;
+            continue;
+        }
+        printf("%8u %10u %5u %3u/%u %8u+%3u %8u+%3u %10u.%03u %10d %10u\n",
+               (unsigned)rates[i], (unsigned)(plan.sys_hz / 1000), plan.fbdiv, plan.postdiv1, plan.postdiv2,
+               (unsigned)(plan.sck_div_q8 >> 8), (unsigned)(plan.sck_div_q8 & 0xFF),
+               (unsigned)(plan.bck_div_q8 >> 8), (unsigned)(plan.bck_div_q8 & 0xFF),
+               (unsigned)(plan.fs_mhz / 1000), (unsigned)(plan.fs_mhz % 1000),
+               (int)plan.error_ppb, (unsigned)plan.jitter_ps);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+/* Host checks of the clock plans the firmware chooses for the rates the
+ * control port's sample rate parameter and the boot configuration use.
+ *
+ * For each rate the plan's PLL setting and dividers are checked against
+ * the hardware limits and against each other, the attained rate is worked
+ * out again from them, and the error is held to the rate's bound: 48 and
+ * 96 kHz must be exact, the 44.1 kHz family within a few ppm of what the
+ * clk_sys window allows.
+ *
+ * Build and run from the repository root, exits non-zero on a failure:
+ *
+ *   cc -O2 -Isrc -Itools/host tools/clock_plan_test.c src/clock_plan.c -o /tmp/clock_plan_test
+ *   /tmp/clock_plan_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "clock_plan.h"
+
+// Mirrors i2s_config_default, i2s.pio and app_config.h
+#define SCK_MULT        256
+#define BIT_DEPTH       16
+#define PIO_MULT        2
+#define SYS_MIN_HZ      100000000u
+#define SYS_MAX_HZ      133000000u
+
+typedef struct {
+    uint32_t fs;
+    uint32_t max_error_ppb;
+} rate_case_t;
+
+static const rate_case_t cases[] = {
+    { 44100, 2000 },
+    { 48000, 0 },
+    { 88200, 50000 },
+    { 96000, 0 },
+};
+
+static int failures = 0;
+
+static void check(bool ok, uint32_t fs, const char* what) {
+    if (!ok) {
+        printf("FAIL %u Hz: %s\n", (unsigned)fs, what);
+        failures++;
+    }
+}
+
+static void check_rate(const rate_case_t* c) {
+    clock_plan_request_t req = { c->fs, SCK_MULT, BIT_DEPTH, PIO_MULT, PIO_MULT, SYS_MIN_HZ, SYS_MAX_HZ };
+    clock_plan_t plan;
+    if (!clock_plan_search(&req, &plan)) {
+        check(false, c->fs, "no plan");
+        return;
+    }
+
+    // The PLL setting is one the hardware can run and gives sys_hz
+    uint64_t vco = (uint64_t)CLOCK_PLAN_XOSC_HZ * plan.fbdiv;
+    check(vco == plan.vco_hz, c->fs, "VCO is not the crystal times fbdiv");
+    check(vco >= CLOCK_PLAN_VCO_MIN_HZ && vco <= CLOCK_PLAN_VCO_MAX_HZ, c->fs, "VCO out of range");
+    check(plan.postdiv1 >= 1 && plan.postdiv1 <= 7 && plan.postdiv2 >= 1 && plan.postdiv2 <= plan.postdiv1,
+          c->fs, "post dividers out of range");
+    check(vco % ((uint32_t)plan.postdiv1 * plan.postdiv2) == 0 &&
+          vco / ((uint32_t)plan.postdiv1 * plan.postdiv2) == plan.sys_hz, c->fs, "sys_hz is not VCO / post dividers");
+    check(plan.sys_hz >= SYS_MIN_HZ && plan.sys_hz <= SYS_MAX_HZ, c->fs, "sys_hz outside the window");
+
+    // PIO dividers in range, BCK an exact multiple of SCK
+    check(plan.sck_div_q8 >= 0x100 && plan.sck_div_q8 <= 0xFFFFFF, c->fs, "SCK divider out of range");
+    check((uint64_t)plan.bck_div_q8 * BIT_DEPTH * 2 == (uint64_t)plan.sck_div_q8 * SCK_MULT,
+          c->fs, "BCK is not a whole number of SCK periods");
+
+    // The rate the dividers attain, in milli-Hz, and its error
+    uint64_t attained_mhz = ((uint64_t)plan.sys_hz * 256 * 1000 + plan.bck_div_q8 * BIT_DEPTH * PIO_MULT) /
+                            ((uint64_t)plan.bck_div_q8 * BIT_DEPTH * 2 * PIO_MULT);
+    int64_t diff_mhz = (int64_t)attained_mhz - (int64_t)plan.fs_mhz;
+    check(diff_mhz >= -1 && diff_mhz <= 1, c->fs, "attained rate does not match the dividers");
+    int64_t error_ppb = ((int64_t)attained_mhz - (int64_t)c->fs * 1000) * 1000000 / c->fs;
+    int64_t error_diff = error_ppb - plan.error_ppb;
+    check(error_diff >= -25 && error_diff <= 25, c->fs, "error_ppb does not match the attained rate");
+    check(llabs(plan.error_ppb) <= (long long)c->max_error_ppb, c->fs, "rate error over its bound");
+    if (c->max_error_ppb == 0) {
+        check(plan.fs_mhz == c->fs * 1000u, c->fs, "rate is not exact");
+    }
+    check((plan.jitter_ps == 0) == ((plan.sck_div_q8 & 0xFF) == 0 && (plan.bck_div_q8 & 0xFF) == 0),
+          c->fs, "jitter does not follow the fractional dividers");
+
+    printf("%6u Hz: sys %u kHz, %d ppb, bound %u\n", (unsigned)c->fs, (unsigned)(plan.sys_hz / 1000),
+           (int)plan.error_ppb, (unsigned)c->max_error_ppb);
+}
+
+int main(void) {
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        check_rate(&cases[i]);
+    }
+
+    // A window no PLL setting falls in has no plan
+    clock_plan_request_t req = { 48000, SCK_MULT, BIT_DEPTH, PIO_MULT, PIO_MULT, 1000000, 1000001 };
+    clock_plan_t plan;
+    check(!clock_plan_search(&req, &plan), 48000, "plan found in an empty window");
+
+    printf("%s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
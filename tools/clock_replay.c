@@ -0,0 +1,289 @@
+/* Host replay of a MIDI clock stream through the tempo tracker and the
+ * arpeggiator, as midi_task and the audio task run them.
+ *
+ * A recording is text, one Real-Time message per line:
+ *
+ *   <us> f8|fa|fb|fc                  Timing Clock, Start, Continue, Stop
+ *   # comment
+ *
+ * Clock messages reach the arpeggiator at the next block boundary, blocks
+ * of AUDIO_BUFFER_FRAMES at REPLAY_RATE. The replay reports the tracked
+ * tempo against a least-squares fit of the tick times, in ppm, and when
+ * each arpeggiator step lands against the last step tick received before
+ * it: mean latency, jitter (standard deviation), drift over the run, and
+ * steps skipped when the arpeggiator fell a tick behind.
+ *
+ * Instead of a recording, -g generates a stream: a master at bpm whose
+ * crystal is off by drift_ppm, each tick displaced by up to jitter_us.
+ * Without arguments it generates 120 BPM with 1 ms jitter and 100 ppm
+ * drift and checks the figures, exiting non-zero when one is out of bounds.
+ *
+ * Build and run from the repository root:
+ *
+ *   cc -O2 -Isrc -Itools/host -Ibench/include tools/clock_replay.c src/midi_clock.c src/synth_arp.c -lm -o /tmp/clock_replay
+ *   /tmp/clock_replay [recording.txt | -g bpm jitter_us seconds [drift_ppm]]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "app_config.h"
+#include "midi_clock.h"
+#include "synth_arp.h"
+
+#define REPLAY_RATE         48000
+#define MAX_MESSAGES        200000
+#define MAX_EVENTS          16
+
+// Bounds for the built-in check
+#define CHECK_TEMPO_PPM     200.0
+#define CHECK_JITTER_US     2000.0
+#define CHECK_DRIFT_US      500.0
+
+typedef struct {
+    uint32_t timestamp_us;
+    uint8_t  status;
+} clock_msg_t;
+
+typedef struct {
+    double   tempo_ppm;     // Tracked period against the fitted one, at the end
+    double   worst_ppm;     // Largest tracking error after the first bar
+    double   latency_us;    // Mean step time after its tick
+    double   jitter_us;     // Standard deviation of the latency
+    double   drift_us;      // Latency change over the run, from a linear fit
+    uint32_t steps;
+    uint32_t skipped;       // Step ticks received that played no step
+} replay_result_t;
+
+static clock_msg_t messages[MAX_MESSAGES];
+static size_t message_count = 0;
+
+// Tick arrival times since the last Start, every TICKS_PER_STEP-th is a step tick
+static double tick_us[MAX_MESSAGES];
+static size_t tick_count = 0;
+
+#define TICKS_PER_STEP      6
+
+static bool add_message(uint32_t us, uint8_t status) {
+    if (message_count == MAX_MESSAGES) {
+        fprintf(stderr, "more than %d messages\n", MAX_MESSAGES);
+        return false;
+    }
+    messages[message_count].timestamp_us = us;
+    messages[message_count].status = status;
+    message_count++;
+    return true;
+}
+
+static bool load(FILE* f) {
+    char line[128];
+    unsigned lineno = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        lineno++;
+        char* p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\0' || *p == '\n' || *p == '#') continue;
+
+        unsigned long us;
+        unsigned status;
+        if (sscanf(p, "%lu %x", &us, &status) != 2 ||
+            (status != 0xF8 && status != 0xFA && status != 0xFB && status != 0xFC)) {
+            fprintf(stderr, "line %u: expected <us> f8|fa|fb|fc\n", lineno);
+            return false;
+        }
+        if (!add_message((uint32_t)us, (uint8_t)status)) return false;
+    }
+    return true;
+}
+
+static bool generate(double bpm, double jitter_us, double seconds, double drift_ppm) {
+    double period = 60e6 / (bpm * MIDI_CLOCK_PPQN) * (1.0 + drift_ppm * 1e-6);
+    uint32_t ticks = (uint32_t)(seconds * 1e6 / period);
+    double start = 1000.0;
+
+    srand(1);
+    if (!add_message((uint32_t)start, 0xFA)) return false;
+    for (uint32_t i = 1; i <= ticks; i++) {
+        double offset = jitter_us * (2.0 * rand() / RAND_MAX - 1.0);
+        if (!add_message((uint32_t)(start + i * period + offset), 0xF8)) return false;
+    }
+    return add_message((uint32_t)(start + (ticks + 1) * period), 0xFC);
+}
+
+// Slope of y against x by least squares
+static double fit_slope(const double* x, const double* y, size_t n) {
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (size_t i = 0; i < n; i++) {
+        sx += x[i];
+        sy += y[i];
+        sxx += x[i] * x[i];
+        sxy += x[i] * y[i];
+    }
+    double d = n * sxx - sx * sx;
+    return (d != 0.0) ? (n * sxy - sx * sy) / d : 0.0;
+}
+
+static void replay(bool verbose, replay_result_t* result) {
+    static double step_x[MAX_MESSAGES / TICKS_PER_STEP + 1];
+    static double step_latency[MAX_MESSAGES / TICKS_PER_STEP + 1];
+    static double tracked_period[MAX_MESSAGES];
+    synth_arp_event_t events[MAX_EVENTS];
+    const double block_us = 1e6 * AUDIO_BUFFER_FRAMES / REPLAY_RATE;
+
+    midi_clock_init();
+    synth_arp_init(REPLAY_RATE);
+    synth_arp_set_part(0);
+    synth_arp_set_ticks_per_step(TICKS_PER_STEP);
+    synth_arp_note_on(60, 100);
+    synth_arp_note_on(64, 100);
+    synth_arp_note_on(67, 100);
+
+    memset(result, 0, sizeof(*result));
+    if (message_count == 0) return;
+
+    // Block times are kept in 64 bits from the first message, recorded
+    // timestamps may wrap
+    uint32_t origin = messages[0].timestamp_us;
+    double last_us = 0.0;
+    size_t next = 0;
+    size_t step_tick = 0;       // Last step tick matched, counted from 1
+    bool running = false;
+    tick_count = 0;
+
+    for (uint64_t block = 0; next < message_count || running; block++) {
+        double block_start = block * block_us;
+
+        while (next < message_count) {
+            double us = last_us + (double)(uint32_t)(messages[next].timestamp_us - origin - (uint32_t)last_us);
+            if (us > block_start) break;
+            last_us = us;
+
+            midi_clock_stats_t stats;
+            switch (messages[next].status) {
+            case 0xF8:
+                midi_clock_tick(messages[next].timestamp_us);
+                midi_clock_get_stats(&stats);
+                synth_arp_clock_tick(stats.locked ? stats.period_us_q8 : 0);
+                if (running && tick_count < MAX_MESSAGES) {
+                    tracked_period[tick_count] = stats.period_us_q8 / 256.0;
+                    tick_us[tick_count++] = us;
+                }
+                break;
+            case 0xFA:
+                midi_clock_start(messages[next].timestamp_us);
+                synth_arp_clock_start();
+                running = true;
+                tick_count = 0;
+                step_tick = 0;
+                break;
+            case 0xFB:
+                midi_clock_continue(messages[next].timestamp_us);
+                synth_arp_clock_continue();
+                running = true;
+                break;
+            case 0xFC:
+                midi_clock_stop();
+                synth_arp_clock_stop();
+                running = false;
+                break;
+            }
+            next++;
+        }
+        if (!running && next == message_count) break;
+
+        size_t count = synth_arp_render(AUDIO_BUFFER_FRAMES, events, MAX_EVENTS);
+        for (size_t e = 0; e < count; e++) {
+            if (!events[e].note_on) continue;
+            double at = block_start + 1e6 * events[e].offset / REPLAY_RATE;
+            // The step on Start has no tick to measure against
+            size_t k = step_tick;
+            while ((k + 1) * TICKS_PER_STEP <= tick_count && tick_us[(k + 1) * TICKS_PER_STEP - 1] <= at) k++;
+            if (k == step_tick) continue;
+            result->skipped += (uint32_t)(k - step_tick - 1);
+            step_tick = k;
+
+            double tick_at = tick_us[k * TICKS_PER_STEP - 1];
+            step_x[result->steps] = tick_at;
+            step_latency[result->steps] = at - tick_at;
+            if (verbose) printf("step %5zu at %12.0f us, %+8.0f us after its tick\n", k, at, at - tick_at);
+            result->steps++;
+        }
+    }
+
+    if (tick_count > 1) {
+        double index[MAX_MESSAGES];
+        for (size_t i = 0; i < tick_count; i++) index[i] = (double)i;
+        double fitted = fit_slope(index, tick_us, tick_count);
+        result->tempo_ppm = (tracked_period[tick_count - 1] - fitted) / fitted * 1e6;
+        for (size_t i = 4 * MIDI_CLOCK_PPQN; i < tick_count; i++) {
+            double ppm = fabs(tracked_period[i] - fitted) / fitted * 1e6;
+            if (ppm > result->worst_ppm) result->worst_ppm = ppm;
+        }
+        printf("%zu ticks, fitted %.3f BPM, tracked %.3f BPM\n", tick_count,
+               60e6 / (fitted * MIDI_CLOCK_PPQN), 60e6 / (tracked_period[tick_count - 1] * MIDI_CLOCK_PPQN));
+    }
+    if (result->steps > 1) {
+        double sum = 0, sum2 = 0;
+        for (uint32_t i = 0; i < result->steps; i++) {
+            sum += step_latency[i];
+            sum2 += step_latency[i] * step_latency[i];
+        }
+        result->latency_us = sum / result->steps;
+        result->jitter_us = sqrt(fmax(0.0, sum2 / result->steps - result->latency_us * result->latency_us));
+        result->drift_us = fit_slope(step_x, step_latency, result->steps) *
+                           (step_x[result->steps - 1] - step_x[0]);
+    }
+    printf("tempo %+.1f ppm at the end, %.1f ppm worst after the first bar\n", result->tempo_ppm, result->worst_ppm);
+    printf("%u steps, %u skipped, latency %.0f us, jitter %.0f us, drift %+.0f us over the run\n",
+           result->steps, result->skipped, result->latency_us, result->jitter_us, result->drift_us);
+}
+
+int main(int argc, char** argv) {
+    replay_result_t result;
+
+    if (argc < 2) {
+        if (!generate(120.0, 1000.0, 60.0, 100.0)) return 1;
+        replay(false, &result);
+        int failures = 0;
+        if (fabs(result.tempo_ppm) > CHECK_TEMPO_PPM) {
+            printf("FAIL tempo error %.1f ppm, bound %.0f\n", result.tempo_ppm, CHECK_TEMPO_PPM);
+            failures++;
+        }
+        if (result.jitter_us > CHECK_JITTER_US) {
+            printf("FAIL step jitter %.0f us, bound %.0f\n", result.jitter_us, CHECK_JITTER_US);
+            failures++;
+        }
+        if (fabs(result.drift_us) > CHECK_DRIFT_US) {
+            printf("FAIL steps drift %.0f us, bound %.0f\n", result.drift_us, CHECK_DRIFT_US);
+            failures++;
+        }
+        if (result.steps < 400 || result.skipped > result.steps / 100) {
+            printf("FAIL %u steps played, %u skipped\n", result.steps, result.skipped);
+            failures++;
+        }
+        printf("%s\n", failures ? "FAILED" : "ok");
+        return failures ? 1 : 0;
+    }
+
+    if (strcmp(argv[1], "-g") == 0) {
+        if (argc < 5) {
+            fprintf(stderr, "usage: %s -g bpm jitter_us seconds [drift_ppm]\n", argv[0]);
+            return 1;
+        }
+        if (!generate(atof(argv[2]), atof(argv[3]), atof(argv[4]), (argc > 5) ? atof(argv[5]) : 0.0)) return 1;
+        replay(false, &result);
+        return 0;
+    }
+
+    FILE* f = fopen(argv[1], "r");
+    if (f == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    bool ok = load(f);
+    fclose(f);
+    if (!ok) return 1;
+    replay(true, &result);
+    return 0;
+}
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""Send control frames to the synth over the log UART.
+
+Speaks the binary protocol of src/control_proto.h on the same serial port
+the log is read from. Log text keeps arriving between replies and is
+printed to stderr; replies are picked out by their sync byte and CRC.
+
+  control_client.py /dev/ttyUSB0 hello
+  control_client.py /dev/ttyUSB0 state
+  control_client.py /dev/ttyUSB0 set 1:preset=6 1:pan=32 2:gain=16384 1:cc74=90
+  control_client.py /dev/ttyUSB0 set rate=44100 tap=1
+
+Parts are numbered from 1 like MIDI channels. Device settings take no part. All the settings of one
+"set" go in a single frame, so the synth applies them on the same block.
+Needs pyserial.
+"""
+
+import argparse
+import struct
+import sys
+import time
+
+SYNC = 0xA5
+REPLY = 0x80
+CMD_HELLO, CMD_SET, CMD_STATE = 0x00, 0x01, 0x02
+PARAMS = {"preset": 0x00, "voices": 0x01, "priority": 0x02, "pan": 0x03, "gain": 0x04, "output": 0x05}
+PARAM_CC = 0x80
+# Device parameters: code and the wire value of a setting
+DEVICE_PARAMS = {"rate": (0x40, lambda hz: hz // 100), "slave": (0x41, int), "tap": (0x42, int)}
+MAX_PAYLOAD = 512
+STATUS = ["ok", "bad length", "bad part", "bad param", "bad value", "unknown command"]
+
+
+def crc16(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def encode(seq, cmd, payload=b""):
+    body = struct.pack("<HBB", len(payload), seq, cmd) + payload
+    return bytes([SYNC]) + body + struct.pack("<H", crc16(body))
+
+
+def parse_setting(text):
+    """'1:cc74=90' -> (part, param, value), 'rate=48000' -> (0, param, 480)"""
+    if ":" not in text and text.split("=", 1)[0] in DEVICE_PARAMS:
+        name, value = text.split("=", 1)
+        param, wire = DEVICE_PARAMS[name]
+        try:
+            return 0, param, wire(int(value, 0))
+        except ValueError:
+            raise argparse.ArgumentTypeError("expected %s=value, not %r" % (name, text))
+    try:
+        part, rest = text.split(":", 1)
+        name, value = rest.split("=", 1)
+        part, value = int(part) - 1, int(value, 0)
+    except ValueError:
+        raise argparse.ArgumentTypeError("expected part:param=value or device=value, not %r" % text)
+    if name.startswith("cc"):
+        return part, PARAM_CC | int(name[2:]), value
+    if name not in PARAMS:
+        raise argparse.ArgumentTypeError("unknown parameter %r, one of %s or ccN" % (name, ", ".join(PARAMS)))
+    return part, PARAMS[name], value
+
+
+class Port:
+    def __init__(self, path, baud):
+        import serial
+        self.ser = serial.Serial(path, baud, timeout=0.05)
+        self.buf = bytearray()
+        self.seq = 0
+
+    def request(self, cmd, payload=b"", timeout=1.0):
+        self.seq = (self.seq + 1) & 0xFF
+        self.ser.write(encode(self.seq, cmd, payload))
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            self.buf += self.ser.read(256)
+            reply = self._take_frame()
+            if reply and reply[0] == self.seq and reply[1] == (cmd | REPLY):
+                return reply[2]
+        sys.exit("no reply to command 0x%02x" % cmd)
+
+    def _take_frame(self):
+        while True:
+            start = self.buf.find(SYNC)
+            if start < 0:
+                self._log(self.buf)
+                self.buf.clear()
+                return None
+            self._log(self.buf[:start])
+            del self.buf[:start]
+            if len(self.buf) < 5:
+                return None
+            length, seq, cmd = struct.unpack_from("<HBB", self.buf, 1)
+            if length > MAX_PAYLOAD:
+                del self.buf[:1]
+                continue
+            if len(self.buf) < 7 + length:
+                return None
+            body = bytes(self.buf[1:5 + length])
+            (crc,) = struct.unpack_from("<H", self.buf, 5 + length)
+            if crc == crc16(body):
+                del self.buf[:7 + length]
+                return seq, cmd, body[4:]
+            del self.buf[:1]    # Not a frame, resync after this byte
+
+    @staticmethod
+    def _log(data):
+        if data:
+            sys.stderr.write(data.decode("ascii", "replace"))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("port")
+    ap.add_argument("--baud", type=int, default=115200)
+    sub = ap.add_subparsers(dest="cmd", required=True)
+    sub.add_parser("hello")
+    sub.add_parser("state")
+    s = sub.add_parser("set")
+    s.add_argument("settings", nargs="+", type=parse_setting)
+    args = ap.parse_args()
+
+    port = Port(args.port, args.baud)
+    if args.cmd == "hello":
+        status, version, parts, presets, voices = port.request(CMD_HELLO)
+        print("protocol %d: %d parts, %d presets, %d voices" % (version, parts, presets, voices))
+    elif args.cmd == "state":
+        reply = port.request(CMD_STATE)
+        print("%d voices active" % reply[1])
+        for part in range((len(reply) - 2) // 9):
+            preset, limit, priority, pan, gain, output = struct.unpack_from("<BBBBiB", reply, 2 + part * 9)
+            print("part %2d: preset %2d, %2d voices, priority %d, pan %3d, gain %d, output %d"
+                  % (part + 1, preset, limit, priority, pan, gain, output))
+    else:
+        payload = b"".join(struct.pack("<BBH", *s) for s in args.settings)
+        status, index = struct.unpack("<BH", port.request(CMD_SET, payload))
+        if status != 0:
+            sys.exit("setting %d rejected: %s" % (index + 1, STATUS[status] if status < len(STATUS) else status))
+        print("applied %d settings" % index)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,84 @@
+/* Host report of the engine's render throughput in frames/s per voice.
+ *
+ * Plays a chord on each preset and times whole AUDIO_BUFFER_FRAMES blocks
+ * through synth_engine_process, the part mix and I2S interleave included.
+ * Frames/s per voice is voice-frames rendered over the time spent, the
+ * figure the audio task logs once a second on the device.
+ *
+ * Build and run from the repository root:
+ *
+ *   python3 tools/gen_tables.py --out /tmp/synth_tables.c
+ *   python3 tools/gen_samples.py --out /tmp/synth_samples.c
+ *   cc -O2 -Isrc -Itools/host -Ibench/include tools/engine_bench.c src/synth_engine.c src/synth_osc.c \
+ *      src/synth_fm.c src/synth_string.c src/synth_unison.c src/synth_presets.c src/sample_stream.c \
+ *      /tmp/synth_tables.c /tmp/synth_samples.c -lm -o /tmp/engine_bench
+ *   /tmp/engine_bench [voices]
+ *
+ * As with osc_bench, host figures only show relative cost.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "app_config.h"
+#include "synth_engine.h"
+#include "synth_presets.h"
+#include "sample_stream.h"
+
+#define BENCH_RATE      48000
+#define BENCH_SECONDS   10
+#define WARMUP_BLOCKS   4
+
+static int32_t output_buffer[SYNTH_OUTPUT_BUSES][AUDIO_BUFFER_FRAMES * 2];
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char** argv) {
+    int voices = (argc > 1) ? atoi(argv[1]) : 8;
+    int32_t* outputs[SYNTH_OUTPUT_BUSES];
+    for (int bus = 0; bus < SYNTH_OUTPUT_BUSES; bus++) {
+        outputs[bus] = output_buffer[bus];
+    }
+    if (voices < 1 || voices > SYNTH_MAX_VOICES) {
+        fprintf(stderr, "voices must be 1-%d\n", SYNTH_MAX_VOICES);
+        return 1;
+    }
+
+    printf("%d voices, %d frame blocks at %d Hz\n", voices, AUDIO_BUFFER_FRAMES, BENCH_RATE);
+    printf("%-16s %14s %10s\n", "preset", "frames/s/voice", "x realtime");
+    for (uint8_t preset = 0; preset < synth_preset_count; preset++) {
+        synth_engine_init();
+        sample_stream_init();
+        synth_engine_set_sample_rate(BENCH_RATE);
+        synth_engine_program_change(0, preset);
+        for (int v = 0; v < voices; v++) {
+            synth_engine_note_on(0, (uint8_t)(36 + v * 3), 100);
+        }
+        for (int b = 0; b < WARMUP_BLOCKS; b++) {
+            synth_engine_process(outputs, AUDIO_BUFFER_FRAMES);
+        }
+
+        // The engine counts the voice-frames it rendered, so voices that die
+        // out during the run (plucks, one-shots) stop counting
+        synth_engine_stats_t stats;
+        synth_engine_take_stats(&stats);
+        uint32_t blocks = BENCH_SECONDS * BENCH_RATE / AUDIO_BUFFER_FRAMES;
+        double start = now_s();
+        for (uint32_t b = 0; b < blocks; b++) {
+            synth_engine_process(outputs, AUDIO_BUFFER_FRAMES);
+        }
+        double elapsed = now_s() - start;
+        synth_engine_take_stats(&stats);
+
+        double frames = (double)blocks * AUDIO_BUFFER_FRAMES;
+        printf("%-16s %14.0f %10.1f\n", synth_presets[preset].name,
+               stats.voice_frames / elapsed, frames / BENCH_RATE / elapsed);
+    }
+    return 0;
+}
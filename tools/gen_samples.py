@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""Generate the demo sample bank played by the sample voices.
+
+Emits a single C translation unit holding the PCM and the zone table
+declared in src/synth_samples.h. The instrument is a small electric-piano
+like tone, one root note per octave in a soft and a hard velocity layer.
+Each zone is a bright attack whose partials settle into a sustain spectrum,
+followed by a loop holding a whole number of cycles, so the loop from the
+end of the attack to the end of the zone is seamless. Lengths and loop
+points are even, and the PCM is word aligned, because the firmware streams
+it out of flash in 32-bit words.
+"""
+
+import argparse
+import math
+
+ROOTS = (36, 48, 60, 72, 84, 96)
+
+# Velocity range and relative partial amplitudes at the start of the attack
+# and in the sustain.
+LAYERS = (
+    ((0, 79), (1.0, 0.5, 0.25, 0.12, 0.06, 0.03), (1.0, 0.15, 0.04, 0.01, 0.0, 0.0)),
+    ((80, 127), (1.0, 0.8, 0.6, 0.45, 0.3, 0.2), (1.0, 0.3, 0.12, 0.05, 0.02, 0.0)),
+)
+
+ATTACK_SECONDS = 0.1
+LOOP_SECONDS = 0.05
+PEAK = 30000
+
+
+def note_hz(note):
+    return 440.0 * 2.0 ** ((note - 69) / 12.0)
+
+
+def even(n):
+    return n + (n & 1)
+
+
+def zone_pcm(root, attack_amps, sustain_amps, rate):
+    # Retune the root slightly so the loop holds whole cycles in whole
+    # samples; the error is reported in cents.
+    f = note_hz(root)
+    cycles = max(1, int(round(LOOP_SECONDS * f)))
+    loop_len = even(int(round(cycles * rate / f)))
+    f = cycles * rate / loop_len
+    loop_start = even(int(ATTACK_SECONDS * rate))
+    length = loop_start + loop_len
+
+    norm = sum(max(a, s) for a, s in zip(attack_amps, sustain_amps))
+    pcm = []
+    for n in range(length):
+        # Partials ease from the attack to the sustain level by loop_start,
+        # after which the signal repeats every loop_len samples.
+        ease = (1.0 - min(1.0, n / loop_start)) ** 3
+        v = 0.0
+        for h, (a, s) in enumerate(zip(attack_amps, sustain_amps), 1):
+            if h * f >= rate / 2.0:
+                break
+            v += (s + (a - s) * ease) * math.sin(2.0 * math.pi * h * f * n / rate)
+        pcm.append(max(-32768, min(32767, int(round(PEAK * v / norm)))))
+    cents = 1200.0 * math.log2(f / note_hz(root))
+    return pcm, loop_start, cents
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--out", required=True)
+    parser.add_argument("--rate", type=int, default=48000, help="sample rate of the PCM")
+    args = parser.parse_args()
+
+    body = []
+    zones = []
+    total = 0
+    worst_cents = 0.0
+    for i, root in enumerate(ROOTS):
+        # Each root covers the keys nearest to it; the outer zones extend to
+        # the ends of the keyboard.
+        key_lo = 0 if i == 0 else root - 6
+        key_hi = 127 if i == len(ROOTS) - 1 else root + 5
+        for layer, (vel, attack_amps, sustain_amps) in enumerate(LAYERS):
+            pcm, loop_start, cents = zone_pcm(root, attack_amps, sustain_amps, args.rate)
+            name = "pcm_%d_%d" % (root, layer)
+            body.append("// Root %d, velocity %d-%d, loop %d-%d, tuned %+.2f cents" % (
+                root, vel[0], vel[1], loop_start, len(pcm), cents))
+            body.append("static const int16_t __attribute__((aligned(4))) %s[%d] = {" % (name, len(pcm)))
+            for j in range(0, len(pcm), 16):
+                body.append("    %s," % ", ".join(str(s) for s in pcm[j:j + 16]))
+            body.append("};")
+            body.append("")
+            zones.append("    { %s, %d, %d, %d, %d, %d, %d, %d, %d, %d }," % (
+                name, len(pcm), loop_start, len(pcm), args.rate, root, key_lo, key_hi, vel[0], vel[1]))
+            total += 2 * len(pcm)
+            worst_cents = max(worst_cents, abs(cents))
+
+    report = "%d zones, %d bytes of flash, worst tuning %.2f cents" % (len(zones), total, worst_cents)
+    out = [
+        "/* synth_samples.c",
+        " *",
+        " * GENERATED by tools/gen_samples.py - do not edit.",
+        " * " + report,
+        " */",
+        "",
+        '#include "synth_samples.h"',
+        "",
+    ]
+    out += body
+    out.append("const synth_sample_zone_t synth_sample_zones[] = {")
+    out += zones
+    out.append("};")
+    out.append("")
+    out.append("const uint8_t synth_sample_zone_count = sizeof(synth_sample_zones) / sizeof(synth_sample_zones[0]);")
+    out.append("")
+
+    with open(args.out, "w") as f:
+        f.write("\n".join(out))
+
+    print("gen_samples: " + report)
+
+
+if __name__ == "__main__":
+    main()
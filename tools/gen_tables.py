@@ -0,0 +1,229 @@
+#!/usr/bin/env python3
+"""Generate the synth engine lookup tables.
+
+Emits a single C translation unit holding every table declared in
+src/synth_tables.h. Sizes and amplitude precision come from the command line
+(normally forwarded from the SYNTH_*_TABLE_BITS CMake cache variables), so a
+build can trade flash for accuracy. The flash footprint and worst-case error
+of each table are printed and recorded in the generated file's header.
+"""
+
+import argparse
+import math
+import sys
+
+
+def quantize(value, precision):
+    # Round to a 16-bit sample, then drop the low (16 - precision) bits.
+    step = 1 << (16 - precision)
+    q = int(round(value / step)) * step
+    return max(-32768, min(32767, q))
+
+
+def sine_table(bits, precision):
+    size = 1 << bits
+    return [quantize(32767.0 * math.sin(2.0 * math.pi * i / size), precision) for i in range(size)]
+
+
+def sine_error(table):
+    # Worst error of truncated-index lookup against the true sine, sampled
+    # between table points the way a 32-bit phase accumulator would hit them.
+    size = len(table)
+    worst = 0.0
+    for i in range(size):
+        for sub in range(4):
+            x = (i + sub / 4.0) / size
+            worst = max(worst, abs(32767.0 * math.sin(2.0 * math.pi * x) - table[i]))
+    return worst
+
+
+def exp2_table(bits):
+    # 2^(i/N) for one octave in Q30, used to turn fractional pitch into a
+    # phase increment multiplier.
+    size = 1 << bits
+    return [int(round((2.0 ** (i / size)) * (1 << 30))) for i in range(size)]
+
+
+def exp2_error_cents(bits):
+    # The engine interpolates linearly between entries, so the error is the
+    # curvature of 2^x over one step: h^2/8 * ln(2)^2 relative, in cents.
+    h = 1.0 / (1 << bits)
+    return 1200.0 * math.log2(1.0 + (h * math.log(2.0)) ** 2 / 8.0)
+
+
+TANH_RANGE = 4.0
+
+
+def tanh_table(bits, precision):
+    # Saturation curve over [-TANH_RANGE, TANH_RANGE), indexed by the top
+    # bits of a signed 16-bit input offset to unsigned.
+    size = 1 << bits
+    return [quantize(32767.0 * math.tanh(TANH_RANGE * (2.0 * i / size - 1.0)), precision) for i in range(size)]
+
+
+def tanh_error(table):
+    size = len(table)
+    worst = 0.0
+    for i in range(size):
+        x = TANH_RANGE * (2.0 * (i + 0.5) / size - 1.0)
+        worst = max(worst, abs(32767.0 * math.tanh(x) - table[i]))
+    return worst
+
+
+def svf_table(bits):
+    # Chamberlin state-variable filter tuning coefficient f = 2 sin(pi fc / fs)
+    # in Q14, indexed linearly by normalised cutoff fc / fs over [0, 0.5).
+    # Being rate independent, it survives sample rate changes.
+    size = 1 << bits
+    return [min(65535, int(round(2.0 * math.sin(math.pi * 0.5 * i / size) * (1 << 14)))) for i in range(size)]
+
+
+# 2x oversampling half-band decimator, normalised to the 2x rate. Content
+# above HALFBAND_STOP folds below HALFBAND_PASS at the output rate, so the
+# stopband attenuation is the alias rejection of the oversampled voices.
+HALFBAND_PASS = 0.1875      # 18 kHz at 96 kHz
+HALFBAND_STOP = 0.3125      # 30 kHz at 96 kHz
+HALFBAND_BETA = 7.0
+
+
+def bessel_i0(x):
+    total, term, k = 1.0, 1.0, 1
+    while term > 1e-12 * total:
+        term *= (x / (2.0 * k)) ** 2
+        total += term
+        k += 1
+    return total
+
+
+def halfband_table(pairs):
+    # Kaiser-windowed half-band lowpass with 4 * pairs - 1 taps. Every even
+    # offset from the centre tap is zero and the centre is exactly 1/2, so
+    # only the odd offsets 1, 3, ... 2 * pairs - 1 are stored, in Q15.
+    centre = 2 * pairs - 1
+    coefs = []
+    for k in range(1, pairs + 1):
+        d = 2 * k - 1
+        ideal = math.sin(math.pi * d / 2.0) / (math.pi * d)
+        window = bessel_i0(HALFBAND_BETA * math.sqrt(1.0 - (d / centre) ** 2)) / bessel_i0(HALFBAND_BETA)
+        coefs.append(int(round(ideal * window * 32768)))
+    return coefs
+
+
+def saw_levels(bits):
+    # One band-limited sawtooth per octave of pitch. Level k holds harmonics
+    # up to 2^(bits - 1 - k) - 1, so it stays below Nyquist for increments
+    # up to 2^(32 - bits + k); the last level is a plain sine.
+    return bits - 1
+
+
+def saw_table(bits, precision):
+    size = 1 << bits
+    levels = []
+    for k in range(saw_levels(bits)):
+        top = (1 << (bits - 1 - k)) - 1
+        levels.append([sum(math.sin(2.0 * math.pi * h * i / size) / h for h in range(1, top + 1))
+                       for i in range(size)])
+    # One scale for every level, so the fundamental keeps its level across them
+    peak = max(abs(v) for level in levels for v in level)
+    return [quantize(32767.0 * v / peak, precision) for level in levels for v in level]
+
+
+def halfband_response(coefs, f):
+    r = 0.5
+    for k, c in enumerate(coefs, 1):
+        r += 2.0 * c / 32768.0 * math.cos(2.0 * math.pi * f * (2 * k - 1))
+    return abs(r)
+
+
+def halfband_report(coefs):
+    points = 512
+    stop = max(halfband_response(coefs, HALFBAND_STOP + i * (0.5 - HALFBAND_STOP) / points) for i in range(points + 1))
+    ripple = max(abs(halfband_response(coefs, i * HALFBAND_PASS / points) - 1.0) for i in range(points + 1))
+    return 20.0 * math.log10(stop), 20.0 * math.log10(1.0 + ripple)
+
+
+def emit_array(out, ctype, name, size_macro, values, per_line):
+    out.append("const %s %s[%s] = {" % (ctype, name, size_macro))
+    width = max(len(str(v)) for v in values)
+    for i in range(0, len(values), per_line):
+        row = ", ".join(str(v).rjust(width) for v in values[i:i + per_line])
+        out.append("    %s," % row)
+    out.append("};")
+    out.append("")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--out", required=True)
+    parser.add_argument("--sine-bits", type=int, default=10)
+    parser.add_argument("--exp2-bits", type=int, default=8)
+    parser.add_argument("--tanh-bits", type=int, default=9)
+    parser.add_argument("--svf-bits", type=int, default=8)
+    parser.add_argument("--saw-bits", type=int, default=9)
+    parser.add_argument("--halfband-pairs", type=int, default=10,
+                        help="non-zero coefficient pairs of the 2x decimator")
+    parser.add_argument("--precision", type=int, default=16,
+                        help="significant bits kept in the int16 amplitude tables")
+    args = parser.parse_args()
+
+    if not 1 <= args.precision <= 16:
+        sys.exit("gen_tables: --precision must be between 1 and 16")
+
+    sine = sine_table(args.sine_bits, args.precision)
+    exp2 = exp2_table(args.exp2_bits)
+    tanh = tanh_table(args.tanh_bits, args.precision)
+    svf = svf_table(args.svf_bits)
+    halfband = halfband_table(args.halfband_pairs)
+    saw = saw_table(args.saw_bits, args.precision)
+    stop_db, ripple_db = halfband_report(halfband)
+
+    report = [
+        "sine_table     %5d entries %6d bytes  max error %.1f LSB" % (len(sine), 2 * len(sine), sine_error(sine)),
+        "exp2_table     %5d entries %6d bytes  interpolated error %.4f cents" % (len(exp2), 4 * len(exp2), exp2_error_cents(args.exp2_bits)),
+        "tanh_table     %5d entries %6d bytes  max error %.1f LSB" % (len(tanh), 2 * len(tanh), tanh_error(tanh)),
+        "svf_coef_table %5d entries %6d bytes" % (len(svf), 2 * len(svf)),
+        "halfband_table %5d entries %6d bytes  %d taps, alias rejection %.1f dB, ripple %.3f dB" % (
+            len(halfband), 2 * len(halfband), 4 * len(halfband) - 1, -stop_db, ripple_db),
+        "saw_table      %5d entries %6d bytes  %d levels, %d harmonics at most" % (
+            len(saw), 2 * len(saw), saw_levels(args.saw_bits), (1 << (args.saw_bits - 1)) - 1),
+        "total %d bytes of flash" % (2 * len(sine) + 4 * len(exp2) + 2 * len(tanh) + 2 * len(svf) + 2 * len(halfband) +
+                                     2 * len(saw)),
+    ]
+
+    out = [
+        "/* synth_tables.c",
+        " *",
+        " * GENERATED by tools/gen_tables.py - do not edit.",
+        " * Amplitude precision: %d bits" % args.precision,
+        " *",
+    ]
+    out += [" * " + line for line in report]
+    out += [
+        " */",
+        "",
+        '#include "synth_tables.h"',
+        "",
+        "_Static_assert(SINE_TABLE_BITS == %d, \"sine table generated for a different size\");" % args.sine_bits,
+        "_Static_assert(EXP2_TABLE_BITS == %d, \"exp2 table generated for a different size\");" % args.exp2_bits,
+        "_Static_assert(TANH_TABLE_BITS == %d, \"tanh table generated for a different size\");" % args.tanh_bits,
+        "_Static_assert(SVF_COEF_TABLE_BITS == %d, \"svf table generated for a different size\");" % args.svf_bits,
+        "_Static_assert(HALFBAND_PAIRS == %d, \"halfband table generated for a different size\");" % args.halfband_pairs,
+        "_Static_assert(SAW_TABLE_BITS == %d, \"saw table generated for a different size\");" % args.saw_bits,
+        "",
+    ]
+    emit_array(out, "int16_t", "sine_table", "SINE_TABLE_SIZE", sine, 16)
+    emit_array(out, "uint32_t", "exp2_table", "EXP2_TABLE_SIZE", exp2, 8)
+    emit_array(out, "int16_t", "tanh_table", "TANH_TABLE_SIZE", tanh, 16)
+    emit_array(out, "uint16_t", "svf_coef_table", "SVF_COEF_TABLE_SIZE", svf, 16)
+    emit_array(out, "int16_t", "halfband_table", "HALFBAND_PAIRS", halfband, 10)
+    emit_array(out, "int16_t", "saw_table", "SAW_TABLE_LEVELS * SAW_TABLE_SIZE", saw, 16)
+
+    with open(args.out, "w") as f:
+        f.write("\n".join(out))
+
+    for line in report:
+        print("gen_tables: " + line)
+
+
+if __name__ == "__main__":
+    main()
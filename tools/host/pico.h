@@ -0,0 +1,15 @@
+/* Minimal stand-in for the pico-sdk's pico.h, so host tools can compile
+ * the engine's portable kernels. Only what those sources use is defined.
+ */
+#ifndef HOST_PICO_H
+#define HOST_PICO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define PICO_ON_DEVICE              0
+#define __not_in_flash_func(x)      x
+#define __time_critical_func(x)     x
+
+#endif /* HOST_PICO_H */
@@ -0,0 +1,277 @@
+/* Host replay of recorded MIDI input through the USB-MIDI packet parser,
+ * the DIN byte parser and the merge queue, as midi_task runs them.
+ *
+ * A recording is text, one event per line:
+ *
+ *   <us> usb <cin> <b1> <b2> <b3>     one 4-byte USB-MIDI event packet, hex
+ *   <us> din <byte> ...               DIN bytes, hex, 320 us apart (31250 baud)
+ *   wake                              midi_task wakes and drains the merge
+ *   # comment
+ *
+ * Each wake prints the merged messages in delivery order, then the replay
+ * reports messages delivered out of timestamp order. Within a wake the
+ * merge orders the sources; across wakes it cannot (see midi_merge.h), so
+ * those are counted apart.
+ *
+ * Without a file it replays a built-in recording and checks every
+ * delivered message, exiting non-zero on a mismatch.
+ *
+ * Build and run from the repository root:
+ *
+ *   cc -O2 -Isrc -Itools/host tools/midi_replay.c src/usb_midi_parser.c src/midi_parser.c src/midi_merge.c -o /tmp/midi_replay
+ *   /tmp/midi_replay [recording.txt]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "midi_parser.h"
+#include "midi_merge.h"
+#include "usb_midi_parser.h"
+
+#define DIN_BYTE_US     320
+#define MAX_DELIVERED   256
+
+static const char* const builtin_recording =
+    "# Across the timer wrap the earlier message still comes first\n"
+    "4294967000 din 93 10 20\n"
+    "40 usb 09 93 11 21\n"
+    "wake\n"
+    "# Chord on USB while a DIN keyboard plays, one wake\n"
+    "1000 usb 09 90 3c 64\n"
+    "1000 usb 09 90 40 64\n"
+    "1000 usb 09 90 43 64\n"
+    "900 din 91 30 50\n"
+    "1500 usb 0f f8 00 00\n"
+    "wake\n"
+    "# Note off as CIN 8 and as note on with velocity 0, pitch bend, CC\n"
+    "2000 usb 08 80 3c 00\n"
+    "2010 usb 09 90 40 00\n"
+    "2020 usb 0e e0 00 50\n"
+    "2030 usb 0b b0 01 7f\n"
+    "wake\n"
+    "# Ignored: SysEx, a CIN that does not match the status, reserved CINs\n"
+    "3000 usb 04 f0 7e 7f\n"
+    "3000 usb 07 06 01 f7\n"
+    "3010 usb 09 80 3c 00\n"
+    "3020 usb 01 90 3c 64\n"
+    "# Cable 1 is accepted like cable 0, data bytes are masked to 7 bits\n"
+    "3030 usb 19 90 bc e4\n"
+    "# DIN running status, a clock byte inside the message\n"
+    "3100 din 92 24 f8 70 26 71\n"
+    "wake\n"
+    "# A DIN message that arrived before the last wake's but is pushed late\n"
+    "5000 usb 09 94 12 22\n"
+    "wake\n"
+    "4950 din 94 13 23\n"
+    "wake\n";
+
+typedef struct {
+    uint32_t timestamp_us;
+    uint8_t  source;
+    uint8_t  status;
+    uint8_t  data1;
+    uint8_t  data2;
+} expected_t;
+
+static const expected_t builtin_expected[] = {
+    { 4294967000u, MIDI_SOURCE_DIN, 0x93, 0x10, 0x20 },
+    { 40,   MIDI_SOURCE_USB, 0x93, 0x11, 0x21 },
+    { 900,  MIDI_SOURCE_DIN, 0x91, 0x30, 0x50 },
+    { 1000, MIDI_SOURCE_USB, 0x90, 0x3C, 0x64 },
+    { 1000, MIDI_SOURCE_USB, 0x90, 0x40, 0x64 },
+    { 1000, MIDI_SOURCE_USB, 0x90, 0x43, 0x64 },
+    { 1500, MIDI_SOURCE_USB, 0xF8, 0x00, 0x00 },
+    { 2000, MIDI_SOURCE_USB, 0x80, 0x3C, 0x00 },
+    { 2010, MIDI_SOURCE_USB, 0x90, 0x40, 0x00 },
+    { 2020, MIDI_SOURCE_USB, 0xE0, 0x00, 0x50 },
+    { 2030, MIDI_SOURCE_USB, 0xB0, 0x01, 0x7F },
+    { 3030, MIDI_SOURCE_USB, 0x90, 0x3C, 0x64 },
+    { 3100 + 2 * DIN_BYTE_US, MIDI_SOURCE_DIN, 0xF8, 0x00, 0x00 },
+    { 3100, MIDI_SOURCE_DIN, 0x92, 0x24, 0x70 },
+    { 3100 + 4 * DIN_BYTE_US, MIDI_SOURCE_DIN, 0x92, 0x26, 0x71 },
+    { 5000, MIDI_SOURCE_USB, 0x94, 0x12, 0x22 },
+    { 4950, MIDI_SOURCE_DIN, 0x94, 0x13, 0x23 },
+};
+
+// Messages delivered out of order within one wake, and across wakes
+#define BUILTIN_UNORDERED_IN_WAKE   1   // The clock byte overtakes its message, see midi_parser.c
+#define BUILTIN_UNORDERED_ACROSS    1
+
+static midi_message_t delivered[MAX_DELIVERED];
+static size_t delivered_count = 0;
+static uint32_t unordered_in_wake = 0;
+static uint32_t unordered_across = 0;
+static bool have_last = false;
+static uint32_t last_us = 0;
+
+static void wake(bool verbose) {
+    midi_message_t msg;
+    bool first = true;
+    while (midi_merge_pop(&msg)) {
+        if (have_last && (int32_t)(msg.timestamp_us - last_us) < 0) {
+            if (first) {
+                unordered_across++;
+            } else {
+                unordered_in_wake++;
+            }
+        }
+        have_last = true;
+        first = false;
+        last_us = msg.timestamp_us;
+        if (delivered_count < MAX_DELIVERED) {
+            delivered[delivered_count++] = msg;
+        }
+        if (verbose) {
+            printf("%10lu %s %02x %02x %02x\n", (unsigned long)msg.timestamp_us,
+                   (msg.source == MIDI_SOURCE_USB) ? "usb" : "din", msg.status, msg.data1, msg.data2);
+        }
+    }
+    if (verbose) printf("-- wake\n");
+}
+
+static bool replay_line(char* line, bool verbose, unsigned lineno) {
+    char* p = line;
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '\0' || *p == '\n' || *p == '#') return true;
+    if (strncmp(p, "wake", 4) == 0) {
+        wake(verbose);
+        return true;
+    }
+
+    char* end;
+    uint32_t us = (uint32_t)strtoul(p, &end, 10);
+    char kind[4] = { 0 };
+    int used = 0;
+    if (end == p || sscanf(end, " %3s%n", kind, &used) != 1) {
+        fprintf(stderr, "line %u: expected <us> usb|din <bytes>\n", lineno);
+        return false;
+    }
+    p = end + used;
+
+    uint8_t bytes[64];
+    size_t n = 0;
+    for (;;) {
+        unsigned long b = strtoul(p, &end, 16);
+        if (end == p) break;
+        if (n == sizeof(bytes) || b > 0xFF) {
+            fprintf(stderr, "line %u: bad byte\n", lineno);
+            return false;
+        }
+        bytes[n++] = (uint8_t)b;
+        p = end;
+    }
+
+    midi_message_t msg;
+    if (strcmp(kind, "usb") == 0) {
+        if (n != 4) {
+            fprintf(stderr, "line %u: a USB-MIDI packet is 4 bytes\n", lineno);
+            return false;
+        }
+        if (usb_midi_parse_packet(bytes, us, &msg)) {
+            midi_merge_push(&msg);
+        }
+    } else if (strcmp(kind, "din") == 0) {
+        for (size_t i = 0; i < n; i++) {
+            if (midi_parser_process_byte(bytes[i], us + (uint32_t)i * DIN_BYTE_US, &msg)) {
+                midi_merge_push(&msg);
+            }
+        }
+    } else {
+        fprintf(stderr, "line %u: unknown source %s\n", lineno, kind);
+        return false;
+    }
+    return true;
+}
+
+static bool replay(FILE* f, const char* text, bool verbose) {
+    static const midi_parser_callbacks_t callbacks = { 0 };
+    char line[256];
+    unsigned lineno = 0;
+
+    midi_parser_init(&callbacks);
+    midi_merge_init();
+    for (;;) {
+        if (f != NULL) {
+            if (fgets(line, sizeof(line), f) == NULL) break;
+        } else {
+            if (*text == '\0') break;
+            size_t len = strcspn(text, "\n");
+            if (len >= sizeof(line)) len = sizeof(line) - 1;
+            memcpy(line, text, len);
+            line[len] = '\0';
+            text += len + (text[len] == '\n');
+        }
+        if (!replay_line(line, verbose, ++lineno)) return false;
+    }
+    wake(verbose);
+    return true;
+}
+
+static int check_builtin(void) {
+    int failures = 0;
+    size_t expected = sizeof(builtin_expected) / sizeof(builtin_expected[0]);
+
+    if (!replay(NULL, builtin_recording, false)) return 1;
+    if (delivered_count != expected) {
+        printf("FAIL delivered %zu messages, expected %zu\n", delivered_count, expected);
+        failures++;
+    }
+    for (size_t i = 0; i < delivered_count && i < expected; i++) {
+        const midi_message_t* m = &delivered[i];
+        const expected_t* e = &builtin_expected[i];
+        if (m->timestamp_us != e->timestamp_us || m->source != e->source || m->status != e->status ||
+            m->data1 != e->data1 || m->data2 != e->data2) {
+            printf("FAIL message %zu: %lu %u %02x %02x %02x, expected %lu %u %02x %02x %02x\n", i,
+                   (unsigned long)m->timestamp_us, m->source, m->status, m->data1, m->data2,
+                   (unsigned long)e->timestamp_us, e->source, e->status, e->data1, e->data2);
+            failures++;
+        }
+    }
+    if (unordered_in_wake != BUILTIN_UNORDERED_IN_WAKE || unordered_across != BUILTIN_UNORDERED_ACROSS) {
+        printf("FAIL %lu out of order within wakes, %lu across, expected %d and %d\n",
+               (unsigned long)unordered_in_wake, (unsigned long)unordered_across,
+               BUILTIN_UNORDERED_IN_WAKE, BUILTIN_UNORDERED_ACROSS);
+        failures++;
+    }
+    if (midi_merge_get_dropped() != 0) {
+        printf("FAIL %lu messages dropped\n", (unsigned long)midi_merge_get_dropped());
+        failures++;
+    }
+
+    // One source overflowing its FIFO in a single wake drops the excess
+    midi_merge_init();
+    midi_message_t msg = { 0, MIDI_SOURCE_USB, 0x90, 60, 100 };
+    for (uint32_t i = 0; i < MIDI_MERGE_DEPTH + 3; i++) {
+        msg.timestamp_us = i;
+        midi_merge_push(&msg);
+    }
+    uint32_t popped = 0;
+    while (midi_merge_pop(&msg)) popped++;
+    if (popped != MIDI_MERGE_DEPTH || midi_merge_get_dropped() != 3) {
+        printf("FAIL overflow: %lu delivered, %lu dropped\n", (unsigned long)popped,
+               (unsigned long)midi_merge_get_dropped());
+        failures++;
+    }
+
+    printf("%s: %zu messages replayed\n", failures ? "FAILED" : "ok", delivered_count);
+    return failures ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        return check_builtin();
+    }
+
+    FILE* f = fopen(argv[1], "r");
+    if (f == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    bool ok = replay(f, NULL, true);
+    fclose(f);
+    printf("%zu messages, %lu out of order within wakes, %lu across wakes, %lu dropped\n",
+           delivered_count, (unsigned long)unordered_in_wake, (unsigned long)unordered_across,
+           (unsigned long)midi_merge_get_dropped());
+    return ok ? 0 : 1;
+}
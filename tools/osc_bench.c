@@ -0,0 +1,228 @@
+/* Host benchmark for the oscillator kernels.
+ *
+ * Times the 1x and 2x oversampled paths of synth_osc_drive_accumulate
+ * against the plain sine kernel, and measures how much aliasing each
+ * leaves in the audio band: the driven sine is rendered, windowed and
+ * transformed, and everything below 18 kHz that is not a harmonic of the
+ * note is counted as alias. The FM algorithms are timed against the same
+ * sine kernel.
+ *
+ * Build and run from the repository root:
+ *
+ *   python3 tools/gen_tables.py --out /tmp/synth_tables.c
+ *   cc -O2 -Isrc -Itools/host tools/osc_bench.c src/synth_osc.c src/synth_fm.c /tmp/synth_tables.c -lm -o /tmp/osc_bench
+ *   /tmp/osc_bench
+ *
+ * Host timings only show the relative cost; the device figures come from
+ * the render statistics the audio task logs, and for FM from the cycle
+ * counts it logs at startup.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "synth_osc.h"
+#include "synth_fm.h"
+
+#define SAMPLE_RATE     48000
+#define BLOCK_FRAMES    32          // Matches SYNTH_SUBBLOCK_FRAMES
+#define BENCH_FRAMES    (SAMPLE_RATE * 20)
+#define FFT_SIZE        16384
+#define AUDIO_BAND_HZ   18000.0
+#define HARMONIC_BINS   6           // Window main lobe either side of a harmonic
+
+typedef enum { PATH_SINE, PATH_DRIVE_1X, PATH_DRIVE_2X } path_t;
+
+static const char* const path_names[] = { "sine", "drive 1x", "drive 2x" };
+
+static int32_t mix[FFT_SIZE];
+static double re[FFT_SIZE], im[FFT_SIZE];
+
+static uint32_t note_increment(int note) {
+    double hz = 440.0 * pow(2.0, (note - 69) / 12.0);
+    return (uint32_t)(hz / SAMPLE_RATE * 4294967296.0);
+}
+
+static uint32_t render(path_t path, int32_t* out, size_t frames, uint32_t phase, uint32_t increment,
+                       int32_t drive, int16_t* history) {
+    for (size_t pos = 0; pos < frames; pos += BLOCK_FRAMES) {
+        size_t n = (frames - pos < BLOCK_FRAMES) ? frames - pos : BLOCK_FRAMES;
+        switch (path) {
+        case PATH_SINE:
+            phase = synth_osc_sine_accumulate_sw(&out[pos], n, phase, increment, 32767, 0);
+            break;
+        case PATH_DRIVE_1X:
+            phase = synth_osc_drive_accumulate(&out[pos], n, phase, increment, 32767, 0, drive);
+            break;
+        case PATH_DRIVE_2X:
+            phase = synth_osc_drive_accumulate_2x(&out[pos], n, phase, increment, 32767, 0, drive, history);
+            break;
+        }
+    }
+    return phase;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double time_path(path_t path, uint32_t increment, int32_t drive) {
+    static int32_t block[BLOCK_FRAMES * 8];
+    int16_t history[SYNTH_OSC_2X_HISTORY] = { 0 };
+    uint32_t phase = 0;
+
+    double start = now_ns();
+    for (size_t done = 0; done < BENCH_FRAMES; done += BLOCK_FRAMES * 8) {
+        memset(block, 0, sizeof(block));
+        phase = render(path, block, BLOCK_FRAMES * 8, phase, increment, drive, history);
+    }
+    double elapsed = now_ns() - start;
+
+    // Keep the result live
+    volatile int32_t sink = block[0] + (int32_t)phase;
+    (void)sink;
+    return elapsed / BENCH_FRAMES;
+}
+
+static double time_fm(uint8_t algorithm, uint32_t increment) {
+    static int32_t block[BLOCK_FRAMES * 8];
+    synth_fm_patch_t patch;
+    synth_fm_voice_t fm;
+
+    memset(&patch, 0, sizeof(patch));
+    patch.algorithm = algorithm;
+    patch.feedback = 128;
+    for (int k = 0; k < SYNTH_FM_OPS; k++) {
+        patch.op[k].ratio = (uint16_t)(256 * (k + 1));
+    }
+    synth_fm_note_on(&fm, &patch, false);
+    synth_fm_set_pitch(&fm, &patch, increment);
+    for (int k = 0; k < SYNTH_FM_OPS; k++) {
+        fm.level[k] = 32767;
+    }
+
+    double start = now_ns();
+    for (size_t done = 0; done < BENCH_FRAMES; done += BLOCK_FRAMES * 8) {
+        memset(block, 0, sizeof(block));
+        for (size_t pos = 0; pos < BLOCK_FRAMES * 8; pos += BLOCK_FRAMES) {
+            synth_fm_accumulate(&block[pos], BLOCK_FRAMES, &fm, algorithm, 32767, 0);
+        }
+    }
+    double elapsed = now_ns() - start;
+
+    volatile int32_t sink = block[0] + (int32_t)fm.phase[0];
+    (void)sink;
+    return elapsed / BENCH_FRAMES;
+}
+
+static void fft(double* xr, double* xi, size_t n) {
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            double t = xr[i]; xr[i] = xr[j]; xr[j] = t;
+            t = xi[i]; xi[i] = xi[j]; xi[j] = t;
+        }
+    }
+    for (size_t len = 2; len <= n; len <<= 1) {
+        double ang = -2.0 * M_PI / (double)len;
+        for (size_t i = 0; i < n; i += len) {
+            for (size_t k = 0; k < len / 2; k++) {
+                double wr = cos(ang * k), wi = sin(ang * k);
+                double ur = xr[i + k], ui = xi[i + k];
+                double vr = xr[i + k + len / 2] * wr - xi[i + k + len / 2] * wi;
+                double vi = xr[i + k + len / 2] * wi + xi[i + k + len / 2] * wr;
+                xr[i + k] = ur + vr;
+                xi[i + k] = ui + vi;
+                xr[i + k + len / 2] = ur - vr;
+                xi[i + k + len / 2] = ui - vi;
+            }
+        }
+    }
+}
+
+/* Returns the alias power below AUDIO_BAND_HZ relative to the total
+ * harmonic power, and the strongest single alias relative to the
+ * fundamental, both in dB.
+ */
+static void measure_alias(path_t path, uint32_t increment, int32_t drive, double* total_db, double* worst_db) {
+    int16_t history[SYNTH_OSC_2X_HISTORY] = { 0 };
+    memset(mix, 0, sizeof(mix));
+    // Settle the decimator, then render the analysed stretch
+    uint32_t phase = render(path, mix, FFT_SIZE, 0, increment, drive, history);
+    memset(mix, 0, sizeof(mix));
+    render(path, mix, FFT_SIZE, phase, increment, drive, history);
+
+    for (size_t i = 0; i < FFT_SIZE; i++) {
+        // Blackman-Harris, side lobes under -92 dB
+        double a = 2.0 * M_PI * i / FFT_SIZE;
+        double w = 0.35875 - 0.48829 * cos(a) + 0.14128 * cos(2 * a) - 0.01168 * cos(3 * a);
+        re[i] = mix[i] * w;
+        im[i] = 0.0;
+    }
+    fft(re, im, FFT_SIZE);
+
+    double f0 = increment / 4294967296.0 * SAMPLE_RATE;
+    double bin_hz = (double)SAMPLE_RATE / FFT_SIZE;
+    double harmonic = 0.0, alias = 0.0, worst = 0.0, fundamental = 0.0;
+
+    for (size_t b = HARMONIC_BINS + 1; b < FFT_SIZE / 2 && b * bin_hz < AUDIO_BAND_HZ; b++) {
+        double power = re[b] * re[b] + im[b] * im[b];
+        double f = b * bin_hz;
+        double k = round(f / f0);
+        if (k >= 1 && fabs(f - k * f0) <= HARMONIC_BINS * bin_hz) {
+            harmonic += power;
+            if (k == 1 && power > fundamental) fundamental = power;
+        } else {
+            alias += power;
+            if (power > worst) worst = power;
+        }
+    }
+
+    *total_db = 10.0 * log10((alias + 1e-30) / harmonic);
+    *worst_db = 10.0 * log10((worst + 1e-30) / fundamental);
+}
+
+int main(void) {
+    static const int notes[] = { 48, 60, 72, 84, 96, 108 };
+    static const int32_t drives[] = { 64, 256, 1024 };
+
+    printf("Cost per frame, host ns (ratio to the sine kernel)\n");
+    for (size_t d = 0; d < sizeof(drives) / sizeof(drives[0]); d++) {
+        uint32_t inc = note_increment(84);
+        double sine = time_path(PATH_SINE, inc, drives[d]);
+        double x1 = time_path(PATH_DRIVE_1X, inc, drives[d]);
+        double x2 = time_path(PATH_DRIVE_2X, inc, drives[d]);
+        printf("  drive %3ld: sine %.2f, 1x %.2f (%.1fx), 2x %.2f (%.1fx), 2x/1x %.1fx\n",
+               (long)drives[d], sine, x1, x1 / sine, x2, x2 / sine, x2 / x1);
+    }
+
+    printf("\nFM cost per frame, host ns (ratio to the sine kernel)\n");
+    {
+        uint32_t inc = note_increment(60);
+        double sine = time_path(PATH_SINE, inc, 0);
+        for (uint8_t a = 0; a < SYNTH_FM_ALG_COUNT; a++) {
+            double t = time_fm(a, inc);
+            printf("  algorithm %u, %u ops: %.2f (%.1fx)\n", a, synth_fm_op_count(a), t, t / sine);
+        }
+    }
+
+    printf("\nAliasing below %.0f Hz: total alias/harmonic power, worst spur/fundamental (dB)\n", AUDIO_BAND_HZ);
+    for (size_t d = 0; d < sizeof(drives) / sizeof(drives[0]); d++) {
+        for (size_t n = 0; n < sizeof(notes) / sizeof(notes[0]); n++) {
+            uint32_t inc = note_increment(notes[n]);
+            printf("  drive %3ld note %3d:", (long)drives[d], notes[n]);
+            for (path_t p = PATH_DRIVE_1X; p <= PATH_DRIVE_2X; p++) {
+                double total, worst;
+                measure_alias(p, inc, drives[d], &total, &worst);
+                printf("  %s %6.1f / %6.1f", path_names[p], total, worst);
+            }
+            printf("\n");
+        }
+    }
+    return 0;
+}
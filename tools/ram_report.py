@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""Summarise SRAM use from a GNU ld map file.
+
+Walks the RAM output sections of the map (.data, .bss, scratch banks and
+the like), adds up the input sections per object file and lists the largest
+individual objects, so the effect of a change on RAM can be seen without
+reading the map by hand. The build runs it on synth.elf.map after linking.
+"""
+
+import argparse
+import collections
+import os
+import re
+import sys
+
+RAM_SECTIONS = (
+    ".ram_vector_table",
+    ".data",
+    ".uninitialized_data",
+    ".bss",
+    ".heap",
+    ".scratch_x",
+    ".scratch_y",
+    ".stack_dummy",
+    ".stack1_dummy",
+)
+
+OUTPUT_RE = re.compile(r"^(\.\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)")
+INPUT_RE = re.compile(r"^ (\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)")
+INPUT_NAME_RE = re.compile(r"^ (\S+)$")
+INPUT_CONT_RE = re.compile(r"^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S+)")
+
+
+def object_name(path):
+    # CMakeFiles/synth.dir/src/synth_engine.c.obj -> synth_engine.c
+    # libfoo.a(bar.o) -> libfoo.a(bar.o)
+    name = os.path.basename(path)
+    if name.endswith(".obj"):
+        name = name[:-4]
+    return name
+
+
+def parse(lines):
+    sections = collections.OrderedDict()
+    objects = collections.Counter()
+    symbols = []
+    current = None
+    pending = None
+    in_map = False
+
+    for line in lines:
+        line = line.rstrip("\n")
+        if line.startswith("Linker script and memory map"):
+            in_map = True
+            continue
+        if not in_map:
+            continue
+
+        m = OUTPUT_RE.match(line)
+        if m:
+            current = m.group(1) if m.group(1) in RAM_SECTIONS else None
+            if current:
+                sections[current] = int(m.group(3), 16)
+            pending = None
+            continue
+        if line and not line[0].isspace():
+            current = None
+            continue
+        if current is None:
+            continue
+
+        m = INPUT_RE.match(line)
+        if m:
+            name, size, obj = m.group(1), int(m.group(3), 16), m.group(4)
+        else:
+            m = INPUT_NAME_RE.match(line)
+            if m:
+                pending = m.group(1)
+                continue
+            m = INPUT_CONT_RE.match(line)
+            if not m or pending is None:
+                continue
+            name, size, obj = pending, int(m.group(2), 16), m.group(3)
+            pending = None
+
+        if size == 0 or name.startswith("*"):
+            continue
+        objects[object_name(obj)] += size
+        symbols.append((size, name, object_name(obj)))
+
+    return sections, objects, symbols
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("map", help="linker map file")
+    parser.add_argument("--top", type=int, default=15, help="entries per list")
+    args = parser.parse_args()
+
+    with open(args.map) as f:
+        sections, objects, symbols = parse(f)
+
+    if not sections:
+        print("ram_report: no RAM sections found in %s" % args.map, file=sys.stderr)
+        return 1
+
+    total = sum(sections.values())
+    print("RAM by section (%d bytes total):" % total)
+    for name, size in sections.items():
+        print("  %-22s %8d" % (name, size))
+
+    print("RAM by object:")
+    for name, size in objects.most_common(args.top):
+        print("  %-40s %8d" % (name, size))
+
+    print("Largest RAM objects:")
+    for size, name, obj in sorted(symbols, reverse=True)[:args.top]:
+        print("  %-40s %8d  %s" % (name, size, obj))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Rebuild WAV files from the audio tap stream.
+
+The firmware streams each rendered block on PIN_AUDIO_TAP once the control
+port turns it on, "control_client.py <log port> set tap=1" (see
+src/audio_tap.h). Point this at the serial adapter on that pin, or at a
+raw capture of it:
+
+  tap_to_wav.py /dev/ttyUSB1 out.wav --seconds 10
+  tap_to_wav.py capture.bin out.wav
+
+Dropped blocks show up as gaps in the block sequence numbers. They are
+listed on stderr and filled with silence, so the WAV keeps the timing of
+the output. A change of sample rate starts a new file, out-1.wav and so
+on. Reading a serial port needs pyserial.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import time
+import wave
+
+MAGIC = b"TAP1"
+HEADER = struct.Struct("<4sIIHH")   # Magic, seq, sample rate, frames, channels
+TRAILER = struct.Struct("<I")       # seq again
+MAX_FRAMES = 4096
+
+
+class Reassembler:
+    def __init__(self, path):
+        self.root, self.ext = os.path.splitext(path)
+        self.buf = bytearray()
+        self.wav = None
+        self.segment = 0
+        self.rate = None
+        self.next_seq = None
+        self.blocks = 0
+        self.dropped = []           # (first seq, count)
+        self.corrupt = 0
+
+    def feed(self, data):
+        self.buf += data
+        while True:
+            start = self.buf.find(MAGIC)
+            if start < 0:
+                # Keep a tail that may be the start of the magic
+                del self.buf[:max(0, len(self.buf) - len(MAGIC) + 1)]
+                return
+            del self.buf[:start]
+            if len(self.buf) < HEADER.size:
+                return
+            _, seq, rate, frames, channels = HEADER.unpack_from(self.buf)
+            if not 0 < frames <= MAX_FRAMES or channels not in (1, 2):
+                self._resync()
+                continue
+            data_bytes = frames * channels * 2
+            size = HEADER.size + data_bytes + TRAILER.size
+            if len(self.buf) < size:
+                return
+            (check,) = TRAILER.unpack_from(self.buf, HEADER.size + data_bytes)
+            if check != seq:
+                # Cut short: the next header (or noise) is where the end should be
+                self._resync()
+                continue
+            self._block(seq, rate, channels, bytes(self.buf[HEADER.size:HEADER.size + data_bytes]))
+            del self.buf[:size]
+
+    def _resync(self):
+        self.corrupt += 1
+        del self.buf[:1]
+
+    def _block(self, seq, rate, channels, pcm):
+        if self.wav is None or rate != self.rate or channels != self.wav.getnchannels():
+            self._open(rate, channels)
+        elif seq != self.next_seq:
+            missing = (seq - self.next_seq) & 0xFFFFFFFF
+            self.dropped.append((self.next_seq, missing))
+            self.wav.writeframes(bytes(len(pcm)) * missing)
+        self.wav.writeframes(pcm)
+        self.next_seq = (seq + 1) & 0xFFFFFFFF
+        self.blocks += 1
+
+    def _open(self, rate, channels):
+        self.close()
+        path = self.root + ("-%d" % self.segment if self.segment else "") + self.ext
+        self.segment += 1
+        self.wav = wave.open(path, "wb")
+        self.wav.setnchannels(channels)
+        self.wav.setsampwidth(2)
+        self.wav.setframerate(rate)
+        self.rate = rate
+        print("%s: %d Hz, %d channels" % (path, rate, channels), file=sys.stderr)
+
+    def close(self):
+        if self.wav is not None:
+            self.wav.close()
+            self.wav = None
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("source", help="serial port or raw capture file")
+    ap.add_argument("output", help="WAV file to write")
+    ap.add_argument("--baud", type=int, default=3000000, help="AUDIO_TAP_BAUD of the firmware")
+    ap.add_argument("--seconds", type=float, help="stop reading the port after this long")
+    args = ap.parse_args()
+
+    tap = Reassembler(args.output)
+    if os.path.isfile(args.source):
+        with open(args.source, "rb") as f:
+            tap.feed(f.read())
+    else:
+        import serial
+        ser = serial.Serial(args.source, args.baud, timeout=0.1)
+        deadline = time.monotonic() + args.seconds if args.seconds else None
+        try:
+            while deadline is None or time.monotonic() < deadline:
+                tap.feed(ser.read(65536))
+        except KeyboardInterrupt:
+            pass
+    tap.close()
+
+    lost = sum(n for _, n in tap.dropped)
+    for first, n in tap.dropped:
+        print("dropped %d block%s from seq %d" % (n, "s" if n > 1 else "", first), file=sys.stderr)
+    print("%d blocks, %d dropped, %d resyncs" % (tap.blocks, lost, tap.corrupt), file=sys.stderr)
+    sys.exit(1 if lost or tap.corrupt else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+"""Convert a trace dump from the log UART into Chrome trace JSON.
+
+The firmware dumps its trace rings as "TRACE ..." log lines after an xrun
+(see src/trace.h). This script reads a captured log, picks out the dump and
+writes a JSON file that chrome://tracing or ui.perfetto.dev can open. Each
+core is a process with one track for tasks, one for ISRs and one for the
+audio render. DMA-to-wake latency and render time are summarised on stderr.
+"""
+
+import argparse
+import json
+import re
+import sys
+
+EV_TASK_IN, EV_ISR_ENTER, EV_ISR_EXIT, EV_AUDIO_WAKE, EV_RENDER_BEGIN, EV_RENDER_END, EV_XRUN = range(7)
+ISR_DMA_I2S = 0
+
+TID_TASKS, TID_ISR, TID_RENDER = 1, 2, 3
+
+TRACE_RE = re.compile(r"TRACE (.*)$")
+
+
+def parse(lines):
+    tasks, isrs, events = {}, {}, {}
+    overhead = None
+    for line in lines:
+        m = TRACE_RE.search(line.rstrip())
+        if not m:
+            continue
+        f = m.group(1).split()
+        if f[0] == "begin":
+            # A new dump replaces an earlier one in the same log
+            tasks, isrs, events = {}, {}, {}
+            overhead = int(f[1])
+        elif f[0] == "task":
+            tasks[int(f[1])] = " ".join(f[2:])
+        elif f[0] == "isr":
+            isrs[int(f[1])] = " ".join(f[2:])
+        elif f[0] == "ev":
+            core, ts, typ, arg = (int(x) for x in f[1:5])
+            events.setdefault(core, []).append((ts, typ, arg))
+    return overhead, tasks, isrs, events
+
+
+def unwrap(stream):
+    # The microsecond timer wraps every 71 minutes
+    out, offset, last = [], 0, None
+    for ts, typ, arg in stream:
+        if last is not None and ts < last and last - ts > (1 << 31):
+            offset += 1 << 32
+        last = ts
+        out.append((ts + offset, typ, arg))
+    return out
+
+
+def convert(tasks, isrs, events):
+    trace = []
+    origin = min(s[0][0] for s in events.values() if s)
+    wake_latency, render_time = [], []
+
+    for core, stream in sorted(events.items()):
+        stream = [(ts - origin, typ, arg) for ts, typ, arg in unwrap(stream)]
+        trace.append({"ph": "M", "name": "process_name", "pid": core, "args": {"name": "Core %d" % core}})
+        for tid, name in ((TID_TASKS, "Tasks"), (TID_ISR, "ISRs"), (TID_RENDER, "Render")):
+            trace.append({"ph": "M", "name": "thread_name", "pid": core, "tid": tid, "args": {"name": name}})
+
+        task, task_start = None, None
+        isr_start = {}
+        render_start = None
+        last_dma = None
+        for ts, typ, arg in stream:
+            if typ == EV_TASK_IN:
+                if task is not None:
+                    trace.append({"ph": "X", "pid": core, "tid": TID_TASKS, "ts": task_start,
+                                  "dur": ts - task_start, "name": tasks.get(task, "Task %d" % task)})
+                task, task_start = arg, ts
+            elif typ == EV_ISR_ENTER:
+                isr_start[arg] = ts
+                if arg == ISR_DMA_I2S:
+                    last_dma = ts
+            elif typ == EV_ISR_EXIT and arg in isr_start:
+                start = isr_start.pop(arg)
+                trace.append({"ph": "X", "pid": core, "tid": TID_ISR, "ts": start,
+                              "dur": ts - start, "name": isrs.get(arg, "ISR %d" % arg)})
+            elif typ == EV_AUDIO_WAKE:
+                trace.append({"ph": "i", "s": "t", "pid": core, "tid": TID_RENDER, "ts": ts, "name": "Wake"})
+                if last_dma is not None:
+                    wake_latency.append(ts - last_dma)
+                    last_dma = None
+            elif typ == EV_RENDER_BEGIN:
+                render_start = ts
+            elif typ == EV_RENDER_END and render_start is not None:
+                trace.append({"ph": "X", "pid": core, "tid": TID_RENDER, "ts": render_start,
+                              "dur": ts - render_start, "name": "Render"})
+                render_time.append(ts - render_start)
+                render_start = None
+            elif typ == EV_XRUN:
+                trace.append({"ph": "i", "s": "g", "pid": core, "tid": TID_RENDER, "ts": ts, "name": "XRUN"})
+
+    return trace, wake_latency, render_time
+
+
+def summary(name, values):
+    if values:
+        print("%s: n=%d mean=%.1f us max=%d us" % (name, len(values), sum(values) / len(values), max(values)),
+              file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", help="captured log UART output")
+    parser.add_argument("output", help="JSON file to write")
+    args = parser.parse_args()
+
+    with open(args.log, errors="replace") as f:
+        overhead, tasks, isrs, events = parse(f)
+    if not events:
+        print("trace_to_json: no trace dump found in %s" % args.log, file=sys.stderr)
+        return 1
+
+    trace, wake_latency, render_time = convert(tasks, isrs, events)
+    with open(args.output, "w") as f:
+        json.dump({"traceEvents": trace, "displayTimeUnit": "ns"}, f)
+
+    if overhead is not None:
+        print("Trace overhead: %d ns/event" % overhead, file=sys.stderr)
+    summary("DMA to audio wake", wake_latency)
+    summary("Render", render_time)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())